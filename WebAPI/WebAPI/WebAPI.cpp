@@ -1,38 +1,143 @@
 ﻿#include <iostream>
-#include <httplib.h>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include "webapi_server.h"
 #include <nlohmann/json.hpp>
 
 using namespace std;
 using json = nlohmann::json;
 
 
-int main()
+static void print_usage( const char* program )
 {
-	// HTTP
-	httplib::Server svr;
+	cout << "Usage: " << program << " [options]" << endl
+		<< "  --config <file>              JSON file with any of the options below" << endl
+		<< "  --host <address>             listen address (default 0.0.0.0)" << endl
+		<< "  --port <port>                listen port (default 8888)" << endl
+		<< "  --threads <n>                worker threads" << endl
+		<< "  --keep-alive-max-count <n>   requests per keep-alive connection" << endl
+		<< "  --keep-alive-timeout <sec>   idle keep-alive timeout" << endl
+		<< "  --read-timeout <sec>         socket read timeout" << endl
+		<< "  --write-timeout <sec>        socket write timeout" << endl
+		<< "  --max-body-size <bytes>      largest accepted request body" << endl
+		<< "  --echo-memory <bytes>        /echo bodies above this are spooled to disk" << endl
+		<< "  --quiet                      disable per-request console logging" << endl;
+}
+
+
+static void load_config_file( const string& path, ServerOptions& options )
+{
+	ifstream file( path );
+	if ( !file ) {
+		throw runtime_error( "cannot open config file: " + path );
+	}
+
+	json config = json::parse( file );
+	options.host = config.value( "host", options.host );
+	options.port = config.value( "port", options.port );
+	options.threads = config.value( "threads", options.threads );
+	options.keep_alive_max_count = config.value( "keep_alive_max_count", options.keep_alive_max_count );
+	options.keep_alive_timeout_sec = config.value( "keep_alive_timeout_sec", options.keep_alive_timeout_sec );
+	options.read_timeout_sec = config.value( "read_timeout_sec", options.read_timeout_sec );
+	options.write_timeout_sec = config.value( "write_timeout_sec", options.write_timeout_sec );
+	options.log_requests = config.value( "log_requests", options.log_requests );
+	options.max_body_bytes = config.value( "max_body_bytes", options.max_body_bytes );
+	options.echo_memory_bytes = config.value( "echo_memory_bytes", options.echo_memory_bytes );
+}
 
-	svr.Get( "/weather", []( const httplib::Request&, httplib::Response& res ) {
-		cout << "GET /weather request." << endl;
 
-		json j;
-		j["locale"] = "Tokyo";
-		j["temperature"] = 23.1;
+// Returns false when the program should exit (help requested)
+static bool parse_options( int argc, char* argv[], ServerOptions& options )
+{
+	// The config file is applied first so that command-line flags override it
+	for ( int i = 1; i + 1 < argc; i++ ) {
+		if ( string_view( argv[i] ) == "--config" ) {
+			load_config_file( argv[i + 1], options );
+		}
+	}
+
+	for ( int i = 1; i < argc; i++ ) {
+		string_view arg = argv[i];
+		if ( arg == "--help" || arg == "-h" ) {
+			print_usage( argv[0] );
+			return false;
+		}
+		if ( arg == "--quiet" ) {
+			options.log_requests = false;
+			continue;
+		}
+		if ( i + 1 >= argc ) {
+			throw invalid_argument( "missing value for " + string( arg ) );
+		}
+
+		string value = argv[++i];
+		if ( arg == "--config" ) {
+			// already loaded
+		} else if ( arg == "--host" ) {
+			options.host = value;
+		} else if ( arg == "--port" ) {
+			options.port = stoi( value );
+		} else if ( arg == "--threads" ) {
+			options.threads = stoul( value );
+		} else if ( arg == "--keep-alive-max-count" ) {
+			options.keep_alive_max_count = stoul( value );
+		} else if ( arg == "--keep-alive-timeout" ) {
+			options.keep_alive_timeout_sec = stol( value );
+		} else if ( arg == "--read-timeout" ) {
+			options.read_timeout_sec = stol( value );
+		} else if ( arg == "--write-timeout" ) {
+			options.write_timeout_sec = stol( value );
+		} else if ( arg == "--max-body-size" ) {
+			options.max_body_bytes = stoull( value );
+		} else if ( arg == "--echo-memory" ) {
+			options.echo_memory_bytes = stoull( value );
+		} else {
+			throw invalid_argument( "unknown option " + string( arg ) );
+		}
+	}
+
+	if ( options.threads == 0 ) {
+		throw invalid_argument( "--threads must be at least 1" );
+	}
+	return true;
+}
 
-		res.set_content( j.dump(), "application/json" );
-	} );
 
+int main( int argc, char* argv[] )
+{
+	ServerOptions options;
+	try {
+		if ( !parse_options( argc, argv, options ) ) {
+			return 0;
+		}
+	}
+	catch ( const exception& e ) {
+		cerr << "Invalid options: " << e.what() << endl;
+		print_usage( argv[0] );
+		return 1;
+	}
 
-	svr.Post( "/echo", []( const httplib::Request& req, httplib::Response& res ) {
-		cout << "POST /echo request." << endl;
+	// HTTP
+	httplib::Server svr;
+	configure_server( svr, options );
 
-		json data = json::parse( req.body );
-		cout << data.dump( 2 ) << endl;
+	if ( !svr.bind_to_port( options.host, options.port ) ) {
+		cerr << "Cannot listen on " << options.host << ":" << options.port << endl;
+		return 1;
+	}
 
-		res.set_content( req.body, "application/json" );
-	} );
+	cout << "Listening on " << options.host << ":" << options.port
+		<< " (threads=" << options.threads
+		<< ", keep-alive=" << options.keep_alive_max_count << "/" << options.keep_alive_timeout_sec << "s"
+		<< ", read/write timeout=" << options.read_timeout_sec << "s/" << options.write_timeout_sec << "s"
+		<< ", max body=" << options.max_body_bytes
+		<< ", logging=" << ( options.log_requests ? "on" : "off" ) << ")" << endl;
 
+	if ( !svr.listen_after_bind() ) {
+		cerr << "Server stopped with an error" << endl;
+		return 1;
+	}
 
-	svr.listen( "0.0.0.0", 8888 );
-	
 	return 0;
 }
@@ -0,0 +1,290 @@
+﻿#include "webapi_server.h"
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+
+namespace
+{
+
+constexpr size_t ECHO_CHUNK_BYTES = 64 * 1024;
+
+
+// fseek takes a long, which is 32 bits on Windows and on 32-bit targets
+int seek_to( FILE* file, size_t offset )
+{
+#ifdef _WIN32
+	return _fseeki64( file, static_cast<__int64>( offset ), SEEK_SET );
+#else
+	return fseeko( file, static_cast<off_t>( offset ), SEEK_SET );
+#endif
+}
+
+
+// SAX handler that accepts every token and only records the first error
+class ValidatingSax : public nlohmann::json_sax<json>
+{
+public:
+	std::string error_message;
+
+	bool null() override { return true; }
+	bool boolean( bool ) override { return true; }
+	bool number_integer( number_integer_t ) override { return true; }
+	bool number_unsigned( number_unsigned_t ) override { return true; }
+	bool number_float( number_float_t, const string_t& ) override { return true; }
+	bool string( string_t& ) override { return true; }
+	bool binary( binary_t& ) override { return true; }
+	bool start_object( size_t ) override { return true; }
+	bool key( string_t& ) override { return true; }
+	bool end_object() override { return true; }
+	bool start_array( size_t ) override { return true; }
+	bool end_array() override { return true; }
+
+	bool parse_error( size_t, const std::string&, const nlohmann::detail::exception& ex ) override
+	{
+		error_message = ex.what();
+		return false;
+	}
+};
+
+
+// Strong ETag from a 64-bit FNV-1a hash of the body
+string make_etag( string_view body )
+{
+	uint64_t hash = 14695981039346656037ull;
+	for ( unsigned char c : body ) {
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+
+	char buffer[24];
+	snprintf( buffer, sizeof( buffer ), "\"%016llx\"", static_cast<unsigned long long>( hash ) );
+	return buffer;
+}
+
+
+// Serve a cached body, or 304 when the client already holds the same version
+void send_cached( const CachedResponse& cached, const httplib::Request& req, httplib::Response& res )
+{
+	res.set_header( "ETag", cached.etag );
+	res.set_header( "Cache-Control", "no-cache" );
+
+	if ( req.has_header( "If-None-Match" ) &&
+		etag_matches( req.get_header_value( "If-None-Match" ), cached.etag ) ) {
+		res.status = 304;
+		return;
+	}
+	res.set_content( cached.body, "application/json" );
+}
+
+
+void send_error( httplib::Response& res, int status, const string& message, const string& detail = "" )
+{
+	json error;
+	error["error"] = message;
+	if ( !detail.empty() ) {
+		error["detail"] = detail;
+	}
+	res.status = status;
+	res.set_content( error.dump(), "application/json" );
+}
+
+
+// Stream the body in, validate it without a DOM, and stream it back in chunks
+void handle_echo( const ServerOptions& options, httplib::Response& res,
+	const httplib::ContentReader& content_reader )
+{
+	auto spool = make_shared<BodySpool>( options.echo_memory_bytes );
+	bool too_large = false;
+	bool spool_failed = false;
+
+	content_reader( [&]( const char* data, size_t length ) {
+		if ( spool->size() + length > options.max_body_bytes ) {
+			too_large = true;
+			return false;
+		}
+		if ( !spool->append( data, length ) ) {
+			spool_failed = true;
+			return false;
+		}
+		return true;
+	} );
+
+	if ( too_large ) {
+		send_error( res, 413, "Request body too large",
+			"limit is " + to_string( options.max_body_bytes ) + " bytes" );
+		return;
+	}
+	if ( spool_failed ) {
+		send_error( res, 500, "Failed to buffer request body" );
+		return;
+	}
+
+	if ( options.log_requests ) {
+		cout << "POST /echo request (" << spool->size() << " bytes)." << endl;
+	}
+
+	string error;
+	if ( !spool->validate_json( error ) ) {
+		send_error( res, 400, "Invalid JSON", error );
+		return;
+	}
+
+	if ( spool->in_memory() ) {
+		res.set_content( std::move( spool->memory() ), "application/json" );
+		return;
+	}
+
+	res.set_content_provider( spool->size(), "application/json",
+		[spool]( size_t offset, size_t length, httplib::DataSink& sink ) {
+			char buffer[ECHO_CHUNK_BYTES];
+			size_t copied = spool->read( offset, buffer, min( length, sizeof( buffer ) ) );
+			return copied > 0 && sink.write( buffer, copied );
+		} );
+}
+
+}  // namespace
+
+
+// BodySpool implementation
+
+BodySpool::BodySpool( size_t memory_limit )
+	: memory_limit_( memory_limit )
+{
+}
+
+BodySpool::~BodySpool()
+{
+	if ( file_ ) {
+		fclose( file_ );
+	}
+}
+
+bool BodySpool::append( const char* data, size_t length )
+{
+	if ( !file_ && memory_.size() + length > memory_limit_ ) {
+		// Move what we have so far to disk; memory stays bounded from here on
+		file_ = tmpfile();
+		if ( !file_ ) {
+			return false;
+		}
+		if ( fwrite( memory_.data(), 1, memory_.size(), file_ ) != memory_.size() ) {
+			return false;
+		}
+		string().swap( memory_ );
+	}
+
+	if ( file_ ) {
+		if ( fwrite( data, 1, length, file_ ) != length ) {
+			return false;
+		}
+	} else {
+		memory_.append( data, length );
+	}
+	size_ += length;
+	return true;
+}
+
+bool BodySpool::validate_json( string& error )
+{
+	ValidatingSax sax;
+	bool valid;
+	if ( file_ ) {
+		fflush( file_ );
+		rewind( file_ );
+		valid = json::sax_parse( file_, &sax );
+	} else {
+		valid = json::sax_parse( memory_, &sax );
+	}
+	if ( !valid ) {
+		error = sax.error_message.empty() ? "parse error" : sax.error_message;
+	}
+	return valid;
+}
+
+size_t BodySpool::read( size_t offset, char* out, size_t length )
+{
+	if ( offset >= size_ ) {
+		return 0;
+	}
+	length = min( length, size_ - offset );
+
+	if ( !file_ ) {
+		memory_.copy( out, length, offset );
+		return length;
+	}
+	if ( seek_to( file_, offset ) != 0 ) {
+		return 0;
+	}
+	return fread( out, 1, length, file_ );
+}
+
+
+CachedResponse make_cached_response( string body )
+{
+	CachedResponse cached;
+	cached.etag = make_etag( body );
+	cached.body = std::move( body );
+	return cached;
+}
+
+
+bool etag_matches( string_view if_none_match, string_view etag )
+{
+	while ( !if_none_match.empty() ) {
+		size_t comma = if_none_match.find( ',' );
+		string_view tag = if_none_match.substr( 0, comma );
+		if_none_match = ( comma == string_view::npos ) ? string_view() : if_none_match.substr( comma + 1 );
+
+		while ( !tag.empty() && tag.front() == ' ' ) tag.remove_prefix( 1 );
+		while ( !tag.empty() && tag.back() == ' ' ) tag.remove_suffix( 1 );
+		if ( tag == "*" ) {
+			return true;
+		}
+		if ( tag.substr( 0, 2 ) == "W/" ) {
+			tag.remove_prefix( 2 );
+		}
+		if ( tag == etag ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void configure_server( httplib::Server& svr, const ServerOptions& options )
+{
+	const size_t threads = options.threads;
+	svr.new_task_queue = [threads] { return new httplib::ThreadPool( threads ); };
+	svr.set_keep_alive_max_count( options.keep_alive_max_count );
+	svr.set_keep_alive_timeout( options.keep_alive_timeout_sec );
+	svr.set_read_timeout( options.read_timeout_sec, 0 );
+	svr.set_write_timeout( options.write_timeout_sec, 0 );
+	svr.set_payload_max_length( options.max_body_bytes );
+
+	// Built once; rebuild (and re-hash) only when the data changes
+	json weather;
+	weather["locale"] = "Tokyo";
+	weather["temperature"] = 23.1;
+	auto weather_response = make_shared<const CachedResponse>( make_cached_response( weather.dump() ) );
+
+	const bool log_requests = options.log_requests;
+
+	svr.Get( "/weather", [weather_response, log_requests]( const httplib::Request& req, httplib::Response& res ) {
+		if ( log_requests ) {
+			cout << "GET /weather request." << endl;
+		}
+
+		send_cached( *weather_response, req, res );
+	} );
+
+
+	svr.Post( "/echo", [options]( const httplib::Request&, httplib::Response& res,
+		const httplib::ContentReader& content_reader ) {
+		handle_echo( options, res, content_reader );
+	} );
+}
@@ -0,0 +1,76 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <httplib.h>
+
+
+// Server settings (defaults < --config file < command line)
+struct ServerOptions
+{
+	std::string host = "0.0.0.0";
+	int port = 8888;
+	size_t threads = ( std::max )( 8u, std::thread::hardware_concurrency() );
+	size_t keep_alive_max_count = 100;
+	time_t keep_alive_timeout_sec = 5;
+	time_t read_timeout_sec = 5;
+	time_t write_timeout_sec = 5;
+	bool log_requests = true;
+
+	// Larger request bodies are answered with 413
+	size_t max_body_bytes = 64 * 1024 * 1024;
+	// /echo bodies above this size are spooled to a temporary file
+	size_t echo_memory_bytes = 1024 * 1024;
+};
+
+
+// Pre-serialized response body with its entity tag
+struct CachedResponse
+{
+	std::string body;
+	std::string etag;
+};
+
+
+// Request body held in memory up to a limit, then spooled to a temporary file
+class BodySpool
+{
+public:
+	explicit BodySpool( size_t memory_limit );
+	~BodySpool();
+
+	BodySpool( const BodySpool& ) = delete;
+	BodySpool& operator=( const BodySpool& ) = delete;
+
+	// Returns false when the temporary file cannot be created or written
+	bool append( const char* data, size_t length );
+
+	// Validate-only SAX parse; no DOM is built. On failure, error describes the problem
+	bool validate_json( std::string& error );
+
+	// Copy up to length bytes starting at offset; returns the number of bytes copied
+	size_t read( size_t offset, char* out, size_t length );
+
+	size_t size() const { return size_; }
+	bool in_memory() const { return file_ == nullptr; }
+	std::string& memory() { return memory_; }
+
+private:
+	size_t memory_limit_;
+	std::string memory_;
+	std::FILE* file_ = nullptr;
+	size_t size_ = 0;
+};
+
+
+CachedResponse make_cached_response( std::string body );
+
+// If-None-Match holds "*" or a comma-separated list of (possibly weak) tags
+bool etag_matches( std::string_view if_none_match, std::string_view etag );
+
+// Apply thread pool, keep-alive, timeout and body limits, and register the routes
+void configure_server( httplib::Server& svr, const ServerOptions& options );
@@ -0,0 +1,161 @@
+﻿// POST /echo cost and peak heap for payloads from 1 KB to 64 MB
+// peak_heap_bytes is the largest heap growth seen during a single request;
+// for the streaming path it should stay flat once bodies exceed the spool limit.
+#include "heap_counter.h"
+#include "../WebAPI/webapi_server.h"
+#include <benchmark/benchmark.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace std;
+using json = nlohmann::json;
+
+
+namespace
+{
+
+constexpr size_t MAX_PAYLOAD_BYTES = 64 * 1024 * 1024;
+
+
+// {"items":["xxx...", ...]} of about the requested size
+string make_payload( size_t bytes )
+{
+	const string item = "\"" + string( 62, 'x' ) + "\"";
+	string payload = "{\"items\":[";
+	payload.reserve( bytes + item.size() + 2 );
+	while ( payload.size() + item.size() + 3 < bytes ) {
+		if ( payload.back() != '[' ) {
+			payload += ',';
+		}
+		payload += item;
+	}
+	payload += "]}";
+	return payload;
+}
+
+
+// One server for the whole run on an ephemeral loopback port
+class EchoServer
+{
+public:
+	EchoServer()
+	{
+		ServerOptions options;
+		options.log_requests = false;
+		options.max_body_bytes = MAX_PAYLOAD_BYTES + 1024;
+		options.read_timeout_sec = 60;
+		options.write_timeout_sec = 60;
+		configure_server( svr_, options );
+
+		port_ = svr_.bind_to_any_port( "127.0.0.1" );
+		thread_ = thread( [this] { svr_.listen_after_bind(); } );
+		while ( !svr_.is_running() ) {
+			this_thread::sleep_for( chrono::milliseconds( 1 ) );
+		}
+	}
+
+	~EchoServer()
+	{
+		svr_.stop();
+		thread_.join();
+	}
+
+	int port() const { return port_; }
+
+private:
+	httplib::Server svr_;
+	int port_ = 0;
+	thread thread_;
+};
+
+EchoServer& echo_server()
+{
+	static EchoServer server;
+	return server;
+}
+
+
+template <typename Op>
+void run_measured( benchmark::State& state, size_t payload_bytes, Op&& op )
+{
+	uint64_t peak = 0;
+	for ( auto _ : state ) {
+		uint64_t baseline = heap_snapshot().live_bytes;
+		heap_reset_peak();
+		if ( !op() ) {
+			state.SkipWithError( "request failed" );
+			break;
+		}
+		peak = max( peak, heap_snapshot().peak_bytes - baseline );
+	}
+	state.SetBytesProcessed( static_cast<int64_t>( state.iterations() * payload_bytes ) );
+	state.counters["peak_heap_bytes"] = static_cast<double>( peak );
+}
+
+
+// Previous handler: full DOM parse plus a pretty-printed copy
+void BM_EchoParse_Dom( benchmark::State& state )
+{
+	const string payload = make_payload( static_cast<size_t>( state.range( 0 ) ) );
+	run_measured( state, payload.size(), [&] {
+		json data = json::parse( payload );
+		string pretty = data.dump( 2 );
+		benchmark::DoNotOptimize( pretty.data() );
+		return true;
+	} );
+}
+
+// Current handler body path: spool in 64 KB chunks and validate with SAX
+void BM_EchoParse_Spool( benchmark::State& state )
+{
+	const string payload = make_payload( static_cast<size_t>( state.range( 0 ) ) );
+	const ServerOptions options;
+	run_measured( state, payload.size(), [&] {
+		BodySpool spool( options.echo_memory_bytes );
+		for ( size_t offset = 0; offset < payload.size(); offset += 64 * 1024 ) {
+			if ( !spool.append( payload.data() + offset, min<size_t>( 64 * 1024, payload.size() - offset ) ) ) {
+				return false;
+			}
+		}
+		string error;
+		return spool.validate_json( error );
+	} );
+}
+
+// Full round trip over loopback; the response body is discarded as it arrives
+void BM_EchoRoundTrip( benchmark::State& state )
+{
+	httplib::Client cli( "127.0.0.1", echo_server().port() );
+	cli.set_keep_alive( true );
+	cli.set_read_timeout( 60, 0 );
+	cli.set_write_timeout( 60, 0 );
+
+	httplib::Request req;
+	req.method = "POST";
+	req.path = "/echo";
+	req.body = make_payload( static_cast<size_t>( state.range( 0 ) ) );
+	req.set_header( "Content-Type", "application/json" );
+
+	size_t received = 0;
+	req.content_receiver = [&]( const char*, size_t length, uint64_t, uint64_t ) {
+		received += length;
+		return true;
+	};
+
+	const size_t payload_bytes = req.body.size();
+	run_measured( state, payload_bytes, [&] {
+		received = 0;
+		auto result = cli.send( req );
+		return result && result->status == 200 && received == payload_bytes;
+	} );
+}
+
+}  // namespace
+
+
+BENCHMARK( BM_EchoParse_Dom )->RangeMultiplier( 8 )->Range( 1 << 10, MAX_PAYLOAD_BYTES )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_EchoParse_Spool )->RangeMultiplier( 8 )->Range( 1 << 10, MAX_PAYLOAD_BYTES )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_EchoRoundTrip )->RangeMultiplier( 8 )->Range( 1 << 10, MAX_PAYLOAD_BYTES )->Unit( benchmark::kMillisecond )->UseRealTime();
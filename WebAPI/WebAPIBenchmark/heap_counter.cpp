@@ -0,0 +1,67 @@
+﻿#include "heap_counter.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+std::atomic<uint64_t> g_live_bytes{ 0 };
+std::atomic<uint64_t> g_peak_bytes{ 0 };
+
+// Each block carries its size in front so delete can account for it
+constexpr size_t HEADER_BYTES = alignof( std::max_align_t );
+
+void add_live( uint64_t bytes )
+{
+	uint64_t live = g_live_bytes.fetch_add( bytes, std::memory_order_relaxed ) + bytes;
+	uint64_t peak = g_peak_bytes.load( std::memory_order_relaxed );
+	while ( live > peak && !g_peak_bytes.compare_exchange_weak( peak, live, std::memory_order_relaxed ) ) {
+	}
+}
+
+}  // namespace
+
+
+HeapSnapshot heap_snapshot()
+{
+	return HeapSnapshot{
+		g_live_bytes.load( std::memory_order_relaxed ),
+		g_peak_bytes.load( std::memory_order_relaxed )
+	};
+}
+
+void heap_reset_peak()
+{
+	g_peak_bytes.store( g_live_bytes.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+}
+
+
+// Replacement global allocation functions (array and nothrow forms forward here)
+
+void* operator new( std::size_t size )
+{
+	auto* block = static_cast<unsigned char*>( std::malloc( HEADER_BYTES + size ) );
+	if ( !block ) {
+		throw std::bad_alloc();
+	}
+	*reinterpret_cast<std::size_t*>( block ) = size;
+	add_live( size );
+	return block + HEADER_BYTES;
+}
+
+void operator delete( void* ptr ) noexcept
+{
+	if ( !ptr ) {
+		return;
+	}
+	auto* block = static_cast<unsigned char*>( ptr ) - HEADER_BYTES;
+	g_live_bytes.fetch_sub( *reinterpret_cast<std::size_t*>( block ), std::memory_order_relaxed );
+	std::free( block );
+}
+
+void operator delete( void* ptr, std::size_t ) noexcept
+{
+	operator delete( ptr );
+}
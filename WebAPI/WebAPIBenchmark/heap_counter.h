@@ -0,0 +1,17 @@
+﻿#pragma once
+
+#include <cstdint>
+
+
+// Process-wide live heap bytes, maintained by the operator new/delete replacements
+// in heap_counter.cpp. peak is the high-water mark since the last reset.
+struct HeapSnapshot
+{
+	uint64_t live_bytes;
+	uint64_t peak_bytes;
+};
+
+HeapSnapshot heap_snapshot();
+
+// Restart peak tracking from the current live size
+void heap_reset_peak();
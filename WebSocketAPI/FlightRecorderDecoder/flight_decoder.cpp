@@ -0,0 +1,171 @@
+﻿#include "flight_recorder.h"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * Renders a flight recorder dump as text, one record per line, in time order
+ * across all threads.
+ *
+ * Usage: FlightRecorderDecoder [flight_recorder.bin]
+ */
+
+namespace {
+
+struct DecodedRecord {
+    uint32_t thread_index;
+    FlightRecord record;
+};
+
+const char* event_name(uint16_t kind) {
+    switch (static_cast<FlightEvent>(kind)) {
+        case FlightEvent::publish: return "publish";
+        case FlightEvent::dequeue: return "dequeue";
+        case FlightEvent::send: return "send";
+        case FlightEvent::error: return "error";
+        case FlightEvent::close: return "close";
+        case FlightEvent::accept: return "accept";
+        case FlightEvent::reject: return "reject";
+        case FlightEvent::spill: return "spill";
+        case FlightEvent::expire: return "expire";
+    }
+    return "unknown";
+}
+
+const char* error_source_name(uint16_t source) {
+    switch (static_cast<FlightErrorSource>(source)) {
+        case FlightErrorSource::accept: return "accept";
+        case FlightErrorSource::handshake: return "handshake";
+        case FlightErrorSource::read: return "read";
+        case FlightErrorSource::write: return "write";
+        case FlightErrorSource::ping: return "ping";
+    }
+    return "unknown";
+}
+
+const char* priority_name(uint16_t priority) {
+    static const char* names[] = {"high", "normal", "low"};
+    return priority < 3 ? names[priority] : "unknown";
+}
+
+// Wall-clock "YYYY-MM-DD HH:MM:SS.nnnnnnnnn" for a steady_clock timestamp
+std::string format_time(uint64_t timestamp_ns, const FlightDumpHeader& header) {
+    int64_t offset = static_cast<int64_t>(header.steady_now_ns - timestamp_ns);
+    uint64_t system_ns = header.system_now_ns - offset;
+    std::time_t seconds = static_cast<std::time_t>(system_ns / 1000000000ULL);
+    std::tm tm_value{};
+#if defined(_WIN32)
+    localtime_s(&tm_value, &seconds);
+#else
+    localtime_r(&seconds, &tm_value);
+#endif
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm_value);
+    char full[48];
+    std::snprintf(full, sizeof(full), "%s.%09llu", date,
+                  static_cast<unsigned long long>(system_ns % 1000000000ULL));
+    return full;
+}
+
+std::string describe(const FlightRecord& record) {
+    std::string text = event_name(record.kind);
+    auto session = " session=" + std::to_string(record.session_id);
+    switch (static_cast<FlightEvent>(record.kind)) {
+        case FlightEvent::publish:
+            text += " sequence=" + std::to_string(record.session_id) +
+                    " priority=" + priority_name(record.detail) +
+                    " bytes=" + std::to_string(record.value);
+            break;
+        case FlightEvent::reject:
+        case FlightEvent::spill:
+            text += std::string(" priority=") + priority_name(record.detail) +
+                    " bytes=" + std::to_string(record.value);
+            break;
+        case FlightEvent::dequeue:
+            text += std::string(" priority=") + priority_name(record.detail) +
+                    " queue_latency_us=" + std::to_string(record.value);
+            break;
+        case FlightEvent::expire:
+            text += " sequence=" + std::to_string(record.session_id) +
+                    " priority=" + priority_name(record.detail) +
+                    " queue_latency_us=" + std::to_string(record.value);
+            break;
+        case FlightEvent::send:
+            text += session + " bytes=" + std::to_string(record.value);
+            break;
+        case FlightEvent::error:
+            text += session + " source=" + error_source_name(record.detail) +
+                    " code=" + std::to_string(record.value);
+            break;
+        case FlightEvent::close:
+        case FlightEvent::accept:
+            text += session;
+            break;
+        default:
+            text += session + " value=" + std::to_string(record.value) +
+                    " detail=" + std::to_string(record.detail);
+            break;
+    }
+    return text;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string path = argc > 1 ? argv[1] : "flight_recorder.bin";
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return 1;
+    }
+
+    FlightDumpHeader header{};
+    if (!input.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != FLIGHT_DUMP_MAGIC) {
+        std::cerr << path << " is not a flight recorder dump" << std::endl;
+        return 1;
+    }
+    if (header.version != FLIGHT_DUMP_VERSION || header.record_size != sizeof(FlightRecord)) {
+        std::cerr << "Unsupported dump version " << header.version
+                  << " (record size " << header.record_size << ")" << std::endl;
+        return 1;
+    }
+
+    std::vector<DecodedRecord> records;
+    for (uint32_t i = 0; i < header.ring_count; i++) {
+        FlightRingHeader ring{};
+        if (!input.read(reinterpret_cast<char*>(&ring), sizeof(ring))) {
+            std::cerr << "Truncated dump at ring " << i << std::endl;
+            break;
+        }
+        std::cout << "# thread " << ring.thread_index << ": " << ring.count << " records kept, "
+                  << ring.total_recorded << " recorded" << std::endl;
+        for (uint32_t n = 0; n < ring.count; n++) {
+            DecodedRecord decoded{ring.thread_index, {}};
+            if (!input.read(reinterpret_cast<char*>(&decoded.record), sizeof(FlightRecord))) {
+                std::cerr << "Truncated dump in thread " << ring.thread_index << std::endl;
+                break;
+            }
+            records.push_back(decoded);
+        }
+    }
+
+    std::stable_sort(records.begin(), records.end(),
+        [](const DecodedRecord& a, const DecodedRecord& b) {
+            return a.record.timestamp_ns < b.record.timestamp_ns;
+        });
+
+    if (header.signal != 0) {
+        std::cout << "# dumped on signal " << header.signal << std::endl;
+    }
+    for (const auto& decoded : records) {
+        std::cout << format_time(decoded.record.timestamp_ns, header)
+                  << " T" << decoded.thread_index << " "
+                  << describe(decoded.record) << std::endl;
+    }
+    return 0;
+}
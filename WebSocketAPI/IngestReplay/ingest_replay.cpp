@@ -0,0 +1,249 @@
+﻿#include "asio_config.h"
+#include "ingest_capture.h"
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Replays an ingest capture against a running server: every captured event
+ * is POSTed to /api/event again, at the captured pace divided by the speed
+ * factor, or back to back with --speed max.
+ *
+ * Events are handed out in arrival order to a pool of connections, each
+ * waiting for its event's due time, so events that arrived together are
+ * sent together as long as enough connections are free. Schedule lag shows
+ * how far sends fell behind that pace.
+ *
+ * Usage: IngestReplay [ingest_capture.bin] [--host 127.0.0.1] [--port 8080]
+ *                     [--speed 1|N|max] [--connections 16]
+ */
+
+namespace {
+
+using boost::asio::ip::tcp;
+
+struct CapturedEvent {
+    uint64_t arrival_ns;
+    std::string type;
+    std::string request;  // Complete HTTP request, built before the replay starts
+};
+
+struct Options {
+    std::string path = "ingest_capture.bin";
+    std::string host = "127.0.0.1";
+    std::string port = "8080";
+    double speed = 1.0;  // 0: as fast as possible
+    size_t connections = 16;
+};
+
+struct ReplayStats {
+    uint64_t sent = 0;
+    uint64_t errors = 0;
+    uint64_t lag_total_us = 0;
+    uint64_t lag_max_us = 0;
+    std::map<int, uint64_t> statuses;
+
+    void merge(const ReplayStats& other) {
+        sent += other.sent;
+        errors += other.errors;
+        lag_total_us += other.lag_total_us;
+        lag_max_us = std::max(lag_max_us, other.lag_max_us);
+        for (const auto& [status, count] : other.statuses) {
+            statuses[status] += count;
+        }
+    }
+};
+
+bool parse_options(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--host" && has_value) {
+            options.host = argv[++i];
+        } else if (arg == "--port" && has_value) {
+            options.port = argv[++i];
+        } else if (arg == "--speed" && has_value) {
+            std::string speed = argv[++i];
+            options.speed = speed == "max" ? 0.0 : std::atof(speed.c_str());
+            if (speed != "max" && options.speed <= 0.0) {
+                return false;
+            }
+        } else if (arg == "--connections" && has_value) {
+            options.connections = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg.rfind("--", 0) != 0) {
+            options.path = arg;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string build_request(const Options& options, const std::string& body) {
+    std::string request = "POST /api/event HTTP/1.1\r\nHost: " + options.host + ":" + options.port +
+                          "\r\nContent-Type: application/json\r\nContent-Length: " +
+                          std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+    request += body;
+    return request;
+}
+
+// Events of a capture file sorted by arrival; false if the file is unusable
+bool load_capture(const Options& options, std::vector<CapturedEvent>& out_events) {
+    std::ifstream input(options.path, std::ios::binary);
+    if (!input) {
+        std::cerr << "Cannot open " << options.path << std::endl;
+        return false;
+    }
+    IngestCaptureHeader header{};
+    if (!input.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != INGEST_CAPTURE_MAGIC) {
+        std::cerr << options.path << " is not an ingest capture" << std::endl;
+        return false;
+    }
+    if (header.version != INGEST_CAPTURE_VERSION || header.record_size != sizeof(IngestCaptureRecord)) {
+        std::cerr << "Unsupported capture version " << header.version
+                  << " (record size " << header.record_size << ")" << std::endl;
+        return false;
+    }
+
+    IngestCaptureRecord record{};
+    std::string body;
+    while (input.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        CapturedEvent event{record.arrival_ns, std::string(record.type_size, '\0'), {}};
+        body.resize(record.body_size);
+        if (!input.read(event.type.data(), record.type_size) ||
+            !input.read(body.data(), record.body_size)) {
+            std::cerr << "Truncated record after " << out_events.size() << " events" << std::endl;
+            break;
+        }
+        event.request = build_request(options, body);
+        out_events.push_back(std::move(event));
+    }
+
+    // Written in completion order; replay in arrival order
+    std::stable_sort(out_events.begin(), out_events.end(),
+        [](const CapturedEvent& a, const CapturedEvent& b) { return a.arrival_ns < b.arrival_ns; });
+    return true;
+}
+
+// Send one request on a new connection and return the response status
+int post(boost::asio::io_context& io_context, const tcp::resolver::results_type& endpoints,
+         const std::string& request) {
+    tcp::socket socket(io_context);
+    boost::asio::connect(socket, endpoints);
+    boost::asio::write(socket, boost::asio::buffer(request));
+
+    // The server closes the connection after its response
+    std::string response;
+    boost::system::error_code ec;
+    boost::asio::read(socket, boost::asio::dynamic_buffer(response), ec);
+    if (ec && ec != boost::asio::error::eof) {
+        throw boost::system::system_error(ec);
+    }
+    size_t space = response.find(' ');
+    return space == std::string::npos ? 0 : std::atoi(response.c_str() + space + 1);
+}
+
+void replay(const Options& options, const std::vector<CapturedEvent>& events,
+            std::chrono::steady_clock::time_point start, std::atomic<size_t>& next,
+            ReplayStats& stats) {
+    boost::asio::io_context io_context;
+    tcp::resolver resolver(io_context);
+    auto endpoints = resolver.resolve(options.host, options.port);
+    uint64_t first_ns = events.front().arrival_ns;
+
+    std::this_thread::sleep_until(start);
+    for (size_t i = next++; i < events.size(); i = next++) {
+        const auto& event = events[i];
+        if (options.speed > 0.0) {
+            auto due = start + std::chrono::nanoseconds(static_cast<int64_t>(
+                static_cast<double>(event.arrival_ns - first_ns) / options.speed));
+            std::this_thread::sleep_until(due);
+            auto lag_us = static_cast<uint64_t>(std::max<int64_t>(0,
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - due).count()));
+            stats.lag_total_us += lag_us;
+            stats.lag_max_us = std::max(stats.lag_max_us, lag_us);
+        }
+        try {
+            stats.statuses[post(io_context, endpoints, event.request)]++;
+        } catch (const std::exception&) {
+            stats.errors++;
+        }
+        stats.sent++;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "Usage: IngestReplay [ingest_capture.bin] [--host 127.0.0.1] [--port 8080]"
+                     " [--speed 1|N|max] [--connections 16]" << std::endl;
+        return 1;
+    }
+
+    std::vector<CapturedEvent> events;
+    if (!load_capture(options, events)) {
+        return 1;
+    }
+    if (events.empty()) {
+        std::cout << "Capture is empty" << std::endl;
+        return 0;
+    }
+
+    std::map<std::string, uint64_t> types;
+    for (const auto& event : events) {
+        types[event.type]++;
+    }
+    double captured_s = static_cast<double>(events.back().arrival_ns - events.front().arrival_ns) / 1e9;
+    std::cout << "Capture: " << events.size() << " events over " << captured_s << " s, "
+              << types.size() << " types" << std::endl;
+    for (const auto& [type, count] : types) {
+        std::cout << "  " << type << ": " << count << std::endl;
+    }
+
+    std::vector<ReplayStats> worker_stats(options.connections);
+    std::vector<std::thread> workers;
+    std::atomic<size_t> next{0};
+    // A short lead so that every connection is waiting when the first event is due
+    auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    for (size_t i = 0; i < options.connections; i++) {
+        workers.emplace_back([&, i]() { replay(options, events, start, next, worker_stats[i]); });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double replay_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ReplayStats total;
+    for (const auto& stats : worker_stats) {
+        total.merge(stats);
+    }
+    std::cout << "Replayed: " << total.sent << " events in " << replay_s << " s ("
+              << (replay_s > 0 ? static_cast<double>(total.sent) / replay_s : 0.0) << " events/s, speed ";
+    if (options.speed > 0.0) {
+        std::cout << options.speed << "x)" << std::endl;
+    } else {
+        std::cout << "max)" << std::endl;
+    }
+    std::cout << "Responses:";
+    for (const auto& [status, count] : total.statuses) {
+        std::cout << " " << status << "=" << count;
+    }
+    std::cout << " errors=" << total.errors << std::endl;
+    if (options.speed > 0.0) {
+        std::cout << "Schedule lag: avg_us=" << (total.sent ? total.lag_total_us / total.sent : 0)
+                  << " max_us=" << total.lag_max_us << std::endl;
+    }
+    return total.errors == 0 ? 0 : 2;
+}
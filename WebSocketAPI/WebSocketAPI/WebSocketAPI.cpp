@@ -1,35 +1,68 @@
 ﻿#include "common.h"
+#include "connection_limiter.h"
+#include "delta_encoder.h"
 #include "event_manager.h"
+#include "flight_recorder.h"
+#include "hot_restart.h"
+#include "idempotency.h"
+#include "ingest_capture.h"
+#include "rate_limiter.h"
 #include "rest_api_server.h"
+#include "server_config.h"
+#include "state_store.h"
+#include "subscriber_hub.h"
 #include "websocket_server.h"
 #include <boost/asio.hpp>
 #include <iostream>
 #include <thread>
 #include <atomic>
 #include <chrono>
+#include <functional>
 
 using boost::asio::ip::tcp;
 
-// Configuration
-constexpr unsigned short REST_API_PORT = 8080;
-constexpr unsigned short WEBSOCKET_PORT = 8081;
+// Configuration file; reloaded on SIGHUP or the 'r' console command.
+// Ports, backlog and acceptor counts (SO_REUSEPORT, Linux only) need a restart;
+// limits, queue budget, buffer size, intervals and log level apply immediately.
+constexpr const char* SERVER_CONFIG_FILE = "server_config.json";
+
+// Flight recorder dump, written on SIGUSR1, the 'd' console command or a crash;
+// render it with FlightRecorderDecoder
+constexpr const char* FLIGHT_RECORDER_FILE = "flight_recorder.bin";
+
+ServerConfig server_config;
 
 std::atomic<bool> should_exit(false);
 
 /**
  * REST API server thread function
  */
-void run_rest_api_server() {
+void run_rest_api_server(ServerConfig config) {
     try {
-        boost::asio::io_context io_context;
-        RestApiServer server(io_context, REST_API_PORT);
-        log_info("REST API server started on port " + std::to_string(REST_API_PORT));
+        boost::asio::io_context io_context(1);
+        RestApiServer server(io_context, config.rest_api_port, config.rest_api_listener);
+        log_info("REST API server started on port " + std::to_string(config.rest_api_port));
+        get_hot_restart().attach_rest_api(&server);
 
-        while (!should_exit) {
-            io_context.run_one();
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        }
+        // Handlers run as soon as they are ready, like the IoThreadPool contexts;
+        // a timer notices shutdown without a request arriving
+        boost::asio::steady_timer shutdown_timer(io_context);
+        std::function<void(const boost::system::error_code&)> check_shutdown =
+            [&](const boost::system::error_code& ec) {
+                if (ec) {
+                    return;
+                }
+                if (should_exit) {
+                    io_context.stop();
+                    return;
+                }
+                shutdown_timer.expires_after(std::chrono::milliseconds(100));
+                shutdown_timer.async_wait(check_shutdown);
+            };
+        check_shutdown({});
+        io_context.run();
 
+        get_hot_restart().attach_rest_api(nullptr);
         log_info("REST API server shutdown");
     } catch (const std::exception& e) {
         log_error("REST API server error: " + std::string(e.what()));
@@ -39,45 +72,206 @@ void run_rest_api_server() {
 /**
  * WebSocket server thread function
  */
-void run_websocket_server() {
+void run_websocket_server(ServerConfig config) {
     try {
         boost::asio::io_context io_context;
-        auto server = std::make_shared<WebSocketServer>(io_context, WEBSOCKET_PORT);
+        auto server = std::make_shared<WebSocketServer>(io_context, config.websocket_port,
+                                                        config.websocket_listener);
         server->start();  // Start accepting connections
-        log_info("WebSocket server started on port " + std::to_string(WEBSOCKET_PORT));
+        log_info("WebSocket server started on port " + std::to_string(config.websocket_port));
+        get_hot_restart().attach_websocket(server);
+
+        // Reload configuration on SIGHUP and dump the flight recorder on SIGUSR1,
+        // handled on this thread's io_context
+        boost::asio::signal_set signals(io_context);
+#if defined(SIGHUP)
+        signals.add(SIGHUP);
+#endif
+#if defined(SIGUSR1)
+        signals.add(SIGUSR1);
+#endif
+        std::function<void(const boost::system::error_code&, int)> on_signal =
+            [&](const boost::system::error_code& ec, int signal_number) {
+                if (ec) {
+                    return;
+                }
+#if defined(SIGUSR1)
+                if (signal_number == SIGUSR1) {
+                    log_info("SIGUSR1 received, dumping flight recorder to " +
+                             std::string(FLIGHT_RECORDER_FILE));
+                    dump_flight_recorder(signal_number);
+                    signals.async_wait(on_signal);
+                    return;
+                }
+#endif
+                log_info("SIGHUP received, reloading " + std::string(SERVER_CONFIG_FILE));
+                reload_server_config(SERVER_CONFIG_FILE, server_config);
+                signals.async_wait(on_signal);
+            };
+        signals.async_wait(on_signal);
 
         // KeepAlive check timer
         auto last_keepalive_check = std::chrono::steady_clock::now();
         auto last_broadcast_check = std::chrono::steady_clock::now();
+        auto last_log_summary = std::chrono::steady_clock::now();
 
         while (!should_exit) {
             // Run Asio operations (with timeout)
             io_context.run_one_for(std::chrono::milliseconds(10));
 
-            // Check KeepAlive timeouts (every 2 seconds)
+            // Check KeepAlive timeouts (every second)
             auto now = std::chrono::steady_clock::now();
             auto elapsed_keepalive = std::chrono::duration_cast<std::chrono::seconds>(
                 now - last_keepalive_check);
-            if (elapsed_keepalive.count() >= 2) {
-                // KeepAlive checks are done per-client in async callbacks
+            if (elapsed_keepalive.count() >= 1) {
+                server->check_keepalives();
                 last_keepalive_check = now;
             }
 
             // Broadcast pending events (frequently)
             auto elapsed_broadcast = std::chrono::duration_cast<std::chrono::milliseconds>(
                 now - last_broadcast_check);
-            if (elapsed_broadcast.count() >= 50) {  // Every 50ms
+            if (elapsed_broadcast >= get_runtime_tunables().broadcast_interval()) {
                 server->broadcast_pending_events();
                 last_broadcast_check = now;
             }
+
+            // Aggregate activity line in place of per-event and per-client lines
+            auto summary_interval = get_runtime_tunables().log_summary_interval();
+            if (summary_interval.count() > 0 && now - last_log_summary >= summary_interval) {
+                log_summary(now - last_log_summary);
+                last_log_summary = now;
+            }
         }
 
+        get_hot_restart().attach_websocket(nullptr);
+        signals.cancel();
+        server->stop();
         log_info("WebSocket server shutdown");
     } catch (const std::exception& e) {
         log_error("WebSocket server error: " + std::string(e.what()));
     }
 }
 
+/**
+ * Console commands, until 'q' or the end of input
+ */
+void run_console() {
+    std::string input;
+    while (std::getline(std::cin, input)) {
+        if (input == "q" || input == "Q") {
+            log_info("Shutdown signal received");
+            should_exit = true;
+            break;
+        } else if (input == "reload" || input == "r") {
+            reload_server_config(SERVER_CONFIG_FILE, server_config);
+        } else if (input == "dump" || input == "d") {
+            if (dump_flight_recorder()) {
+                log_info("Flight recorder dumped to " + std::string(FLIGHT_RECORDER_FILE));
+            } else {
+                log_error("Failed to write flight recorder dump " + std::string(FLIGHT_RECORDER_FILE));
+            }
+        } else if (input == "status" || input == "s") {
+            // Print current status
+            auto& event_manager = get_event_manager();
+            std::cout << "\n=== System Status ===" << std::endl;
+            std::cout << "Pending events: " << (event_manager.has_events() ? "Yes" : "No")
+                      << std::endl;
+            auto queue_stats = event_manager.get_stats();
+            std::cout << "Event queue: events=" << queue_stats.queued_events
+                      << ", bytes=" << queue_stats.queued_bytes
+                      << "/" << queue_stats.memory_budget_bytes
+                      << ", peak_bytes=" << queue_stats.peak_bytes
+                      << ", overflowing=" << (queue_stats.overflowing ? "yes" : "no")
+                      << std::endl;
+            for (size_t lane = 0; lane < EVENT_PRIORITY_COUNT; lane++) {
+                const auto& queued = queue_stats.queue_latency[lane];
+                const auto& delivered = queue_stats.delivery_latency[lane];
+                std::cout << "  [" << event_priority_name(static_cast<EventPriority>(lane)) << "]"
+                          << " queued=" << queue_stats.lane_events[lane]
+                          << ", dequeued=" << queued.count
+                          << ", queue_latency_us avg=" << queued.average_us()
+                          << " max=" << queued.max_us
+                          << ", delivery_latency_us avg=" << delivered.average_us()
+                          << " max=" << delivered.max_us
+                          << std::endl;
+            }
+            std::cout << "Overflow: spilled_pending=" << queue_stats.spilled_pending
+                      << ", spilled_total=" << queue_stats.spilled_total
+                      << ", rejected_total=" << queue_stats.rejected_total
+                      << std::endl;
+            std::cout << "Expired: queued=" << queue_stats.expired_queued
+                      << ", outbound=" << queue_stats.expired_outbound
+                      << std::endl;
+            auto delta_stats = get_delta_encoder().get_stats();
+            std::cout << "Delta encoding: full=" << delta_stats.full_frames
+                      << ", patch=" << delta_stats.patch_frames
+                      << ", bytes_saved=" << delta_stats.bytes_saved
+                      << ", tracked_keys=" << delta_stats.tracked_keys
+                      << std::endl;
+            auto state_stats = get_state_store().get_stats();
+            std::cout << "State store: version=" << state_stats.version
+                      << ", types=" << state_stats.types
+                      << ", entries=" << state_stats.entries
+                      << ", updates=" << state_stats.updates
+                      << ", dropped=" << state_stats.dropped
+                      << std::endl;
+            auto limiter_stats = get_rate_limiter().get_stats();
+            std::cout << "Rate limiter: allowed=" << limiter_stats.allowed
+                      << ", rejected_global=" << limiter_stats.rejected_global
+                      << ", rejected_client=" << limiter_stats.rejected_client
+                      << ", untracked=" << limiter_stats.untracked
+                      << ", tracked_clients=" << limiter_stats.tracked_clients
+                      << std::endl;
+            auto idempotency_stats = get_idempotency_index().get_stats();
+            std::cout << "Idempotency: hits=" << idempotency_stats.hits
+                      << ", misses=" << idempotency_stats.misses
+                      << ", hit_rate=" << idempotency_stats.hit_rate()
+                      << ", in_progress=" << idempotency_stats.in_progress
+                      << ", entries=" << idempotency_stats.entries
+                      << ", bytes=" << idempotency_stats.memory_bytes
+                      << "/" << idempotency_stats.memory_budget_bytes
+                      << ", evicted=" << idempotency_stats.evicted
+                      << ", expired=" << idempotency_stats.expired
+                      << std::endl;
+            auto capture_stats = get_ingest_capture().get_stats();
+            std::cout << "Ingest capture: active=" << (capture_stats.active ? "yes" : "no")
+                      << ", records=" << capture_stats.records
+                      << ", bytes=" << capture_stats.bytes
+                      << ", buffered_bytes=" << capture_stats.buffered_bytes
+                      << ", dropped=" << capture_stats.dropped
+                      << std::endl;
+            auto connection_stats = get_connection_limiter().get_stats();
+            std::cout << "Connections: active=" << connection_stats.active
+                      << ", pending_handshakes=" << connection_stats.pending_handshakes
+                      << ", addresses=" << connection_stats.tracked_addresses
+                      << ", admitted=" << connection_stats.admitted
+                      << ", open_fds=" << connection_stats.open_fds
+                      << "/" << connection_stats.fd_limit
+                      << std::endl;
+            std::cout << "Connection rejections: max_connections=" << connection_stats.rejected_total
+                      << ", per_ip=" << connection_stats.rejected_per_ip
+                      << ", pending_handshakes=" << connection_stats.rejected_handshakes
+                      << ", handshake_timeouts=" << connection_stats.handshake_timeouts
+                      << ", accept_pauses=" << connection_stats.accept_pauses
+                      << std::endl;
+            std::cout << "SSE streams: active=" << get_subscriber_hub().size() << std::endl;
+            auto session_memory = get_session_memory_stats();
+            std::cout << "WebSocket memory: sessions=" << session_memory.sessions
+                      << ", session_bytes=" << session_memory.session_bytes
+                      << ", read_buffer_bytes=" << session_memory.read_buffer_bytes
+                      << ", idle_reads=" << session_memory.idle_reads
+                      << ", outbound_queues=" << session_memory.outbound_queues
+                      << ", queued_frame_bytes=" << session_memory.queued_frame_bytes
+                      << std::endl;
+            std::cout << "Commands: 's' for status, 'r' to reload config, 'd' to dump flight recorder, 'q' to quit" << std::endl;
+            std::cout << "==================\n" << std::endl;
+        } else if (!input.empty()) {
+            log_info("Unknown command: " + input);
+        }
+    }
+}
+
 /**
  * Main function - Starts servers and monitors system
  */
@@ -87,40 +281,45 @@ int main() {
         init_logger("logging_config.json");
         
         log_info("=== WebSocket API Server Starting ===");
-        log_info("REST API: http://localhost:" + std::to_string(REST_API_PORT));
-        log_info("WebSocket: ws://localhost:" + std::to_string(WEBSOCKET_PORT));
+        log_info(std::string("I/O backend: ") + asio_backend_name());
+
+        set_flight_recorder_file(FLIGHT_RECORDER_FILE);
+        install_flight_recorder_crash_handlers();
+
+        server_config = load_server_config(SERVER_CONFIG_FILE);
+        apply_server_config(server_config);
+        log_info("REST API: http://localhost:" + std::to_string(server_config.rest_api_port));
+        log_info("WebSocket: ws://localhost:" + std::to_string(server_config.websocket_port));
+
+        // Inherit the listening sockets, queued events and state of a running instance
+        auto& hot_restart = get_hot_restart();
+        hot_restart.configure(server_config.hot_restart);
+        hot_restart.take_over(server_config.rest_api_listener, server_config.websocket_listener);
 
         // Start REST API server thread
-        std::thread rest_thread(run_rest_api_server);
+        std::thread rest_thread(run_rest_api_server, server_config);
 
         // Start WebSocket server thread
-        std::thread ws_thread(run_websocket_server);
+        std::thread ws_thread(run_websocket_server, server_config);
 
         // Main thread - monitor and handle shutdown
         log_info("Servers running. Press 'q' to quit...");
-        std::string input;
-        while (std::getline(std::cin, input)) {
-            if (input == "q" || input == "Q") {
-                log_info("Shutdown signal received");
-                should_exit = true;
-                break;
-            } else if (input == "status" || input == "s") {
-                // Print current status
-                auto& event_manager = get_event_manager();
-                std::cout << "\n=== System Status ===" << std::endl;
-                std::cout << "Pending events: " << (event_manager.has_events() ? "Yes" : "No")
-                          << std::endl;
-                std::cout << "Commands: 's' for status, 'q' to quit" << std::endl;
-                std::cout << "==================\n" << std::endl;
-            } else if (!input.empty()) {
-                log_info("Unknown command: " + input);
-            }
+        hot_restart.listen([]() { should_exit = true; });
+
+        // Console on its own thread, so that a hot restart handoff can end the process
+        std::thread(run_console).detach();
+        while (!should_exit) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            // Off the acceptor threads: counting descriptors is O(open descriptors)
+            get_connection_limiter().sample_descriptors();
         }
 
         // Wait for threads to finish
         log_info("Waiting for servers to shutdown...");
         rest_thread.join();
         ws_thread.join();
+        hot_restart.stop();
+        get_ingest_capture().stop();
 
         log_info("=== WebSocket API Server Stopped ===");
         return 0;
@@ -0,0 +1,50 @@
+﻿#pragma once
+
+/**
+ * Boost.Asio build configuration, included before any Asio or Beast header
+ *
+ * Linux io_uring backend: configure CMake with -DWEBSOCKETAPI_IO_URING=ON
+ * (Boost 1.78 or later and liburing). Socket, timer and file operations then
+ * go through io_uring instead of the epoll reactor, and the logger's file sink
+ * writes through io_uring as well. The build defines the Asio macros for every
+ * translation unit; the defaults below only cover builds that set
+ * WEBSOCKETAPI_IO_URING alone.
+ */
+
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0601
+#endif
+
+#if defined(WEBSOCKETAPI_IO_URING)
+#if !defined(__linux__)
+#error "WEBSOCKETAPI_IO_URING is only supported on Linux"
+#endif
+#ifndef BOOST_ASIO_HAS_IO_URING
+#define BOOST_ASIO_HAS_IO_URING 1
+#endif
+#ifndef BOOST_ASIO_DISABLE_EPOLL
+#define BOOST_ASIO_DISABLE_EPOLL 1
+#endif
+#endif
+
+#include <boost/version.hpp>
+#include <utility>  // Boost 1.74's awaitable.hpp uses std::exchange without including it
+
+#if defined(WEBSOCKETAPI_IO_URING) && BOOST_VERSION < 107800
+#error "WEBSOCKETAPI_IO_URING requires Boost 1.78 or later"
+#endif
+
+/**
+ * I/O backend compiled in (for logs and benchmark labels)
+ */
+constexpr const char* asio_backend_name() {
+#if defined(WEBSOCKETAPI_IO_URING)
+    return "io_uring";
+#elif defined(_WIN32)
+    return "iocp";
+#elif defined(__linux__)
+    return "epoll";
+#else
+    return "reactor";
+#endif
+}
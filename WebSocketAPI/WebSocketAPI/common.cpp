@@ -1,17 +1,96 @@
 ﻿#include "common.h"
+#include <cstdio>
 #include <ctime>
+#include <ostream>
+#include <streambuf>
 
 // Event implementation
 json Event::to_json() const {
     return json{
         {"type", type},
         {"timestamp", timestamp},
-        {"payload", payload}
+        {"payload", payload},
+        {"sequence", sequence}
     };
 }
 
+// Append a JSON string literal (quotes and escapes) to out
+static void append_json_string(std::string& out, const std::string& value) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    for (unsigned char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    out += "\\u00";
+                    out += hex[c >> 4];
+                    out += hex[c & 0x0f];
+                } else {
+                    out += static_cast<char>(c);
+                }
+                break;
+        }
+    }
+    out += '"';
+}
+
+namespace {
+
+// Stream buffer that appends to a string, so its capacity outlives each write
+class StringAppendBuffer : public std::streambuf {
+public:
+    explicit StringAppendBuffer(std::string& out) : out_(out) {}
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            out_ += traits_type::to_char_type(ch);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char* data, std::streamsize count) override {
+        out_.append(data, static_cast<size_t>(count));
+        return count;
+    }
+
+private:
+    std::string& out_;
+};
+
+}  // namespace
+
 std::string Event::to_string() const {
-    return to_json().dump();
+    // Same text as to_json().dump() (keys in sorted order), but without
+    // deep-copying the payload into a temporary DOM. The payload goes
+    // through json's operator<< into a per-thread scratch string that keeps
+    // its capacity (json::dump grows a fresh string every call).
+    thread_local std::string scratch;
+    thread_local StringAppendBuffer scratch_buffer(scratch);
+    thread_local std::ostream scratch_stream(&scratch_buffer);
+    scratch.clear();
+    scratch_stream.clear();  // A failed earlier write must not mute this one
+    scratch_stream << payload;
+
+    std::string out;
+    out.reserve(scratch.size() + type.size() + timestamp.size() + 64);
+    out += "{\"payload\":";
+    out += scratch;
+    out += ",\"sequence\":";
+    out += std::to_string(sequence);
+    out += ",\"timestamp\":";
+    append_json_string(out, timestamp);
+    out += ",\"type\":";
+    append_json_string(out, type);
+    out += '}';
+    return out;
 }
 
 std::string get_iso8601_timestamp() {
@@ -20,10 +99,115 @@ std::string get_iso8601_timestamp() {
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
         now.time_since_epoch()) % 1000;
     
-    char buffer[32];
+    // UTC to match the "Z" suffix
     std::tm tm_info;
-    localtime_s(&tm_info, &time);
-    strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &tm_info);
-    
-    return std::string(buffer) + "." + std::to_string(ms.count()).substr(0, 3) + "Z";
+#if defined(_WIN32)
+    gmtime_s(&tm_info, &time);
+#else
+    gmtime_r(&time, &tm_info);
+#endif
+    char buffer[32];
+    size_t length = strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &tm_info);
+    std::snprintf(buffer + length, sizeof(buffer) - length, ".%03dZ", static_cast<int>(ms.count()));
+    return std::string(buffer);
+}
+
+// Heap bytes behind a std::string (zero while it fits the small-string buffer)
+static size_t string_heap_bytes(const std::string& str) {
+    static const size_t inline_capacity = std::string().capacity();
+    return str.capacity() > inline_capacity ? str.capacity() + 1 : 0;
+}
+
+size_t estimate_json_memory(const json& value) {
+    size_t bytes = sizeof(json);
+    switch (value.type()) {
+        case json::value_t::string: {
+            const auto& str = value.get_ref<const json::string_t&>();
+            bytes += sizeof(json::string_t) + string_heap_bytes(str);
+            break;
+        }
+        case json::value_t::binary: {
+            const auto& bin = value.get_ref<const json::binary_t&>();
+            bytes += sizeof(json::binary_t) + bin.capacity();
+            break;
+        }
+        case json::value_t::array: {
+            // Elements are stored inline in the vector; count unused capacity too
+            const auto& arr = value.get_ref<const json::array_t&>();
+            bytes += sizeof(json::array_t) + (arr.capacity() - arr.size()) * sizeof(json);
+            for (const auto& element : arr) {
+                bytes += estimate_json_memory(element);
+            }
+            break;
+        }
+        case json::value_t::object: {
+            // std::map node: colour + three links, then the key and the value
+            constexpr size_t node_overhead = 4 * sizeof(void*);
+            const auto& obj = value.get_ref<const json::object_t&>();
+            bytes += sizeof(json::object_t);
+            for (const auto& [key, element] : obj) {
+                bytes += node_overhead + sizeof(json::string_t) + string_heap_bytes(key);
+                bytes += estimate_json_memory(element);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return bytes;
+}
+
+size_t estimate_event_memory(const Event& event) {
+    // The payload's own json object is counted by estimate_json_memory
+    return sizeof(Event) - sizeof(json)
+         + string_heap_bytes(event.type)
+         + string_heap_bytes(event.timestamp)
+         + estimate_json_memory(event.payload);
+}
+
+const char* event_priority_name(EventPriority priority) {
+    switch (priority) {
+        case EventPriority::high: return "high";
+        case EventPriority::normal: return "normal";
+        case EventPriority::low: return "low";
+    }
+    return "normal";
+}
+
+bool parse_event_priority(const std::string& name, EventPriority& out_priority) {
+    if (name == "high") out_priority = EventPriority::high;
+    else if (name == "normal") out_priority = EventPriority::normal;
+    else if (name == "low") out_priority = EventPriority::low;
+    else return false;
+    return true;
+}
+
+// LaneScheduler implementation
+
+LaneScheduler::LaneScheduler(const Weights& weights) {
+    set_weights(weights);
+}
+
+void LaneScheduler::set_weights(const Weights& weights) {
+    weights_ = weights;
+    for (auto& weight : weights_) {
+        if (weight == 0) {
+            weight = 1;  // Every lane must make progress
+        }
+    }
+    credits_ = weights_;
+}
+
+int LaneScheduler::next(const std::array<bool, EVENT_PRIORITY_COUNT>& non_empty) {
+    for (int round = 0; round < 2; round++) {
+        for (size_t lane = 0; lane < EVENT_PRIORITY_COUNT; lane++) {
+            if (non_empty[lane] && credits_[lane] > 0) {
+                credits_[lane]--;
+                return static_cast<int>(lane);
+            }
+        }
+        // Every non-empty lane used up its share: start a new round
+        credits_ = weights_;
+    }
+    return -1;
 }
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <chrono>
 #include <memory>
+#include <array>
 #include <nlohmann/json.hpp>
 #include "logger.h"
 
@@ -13,15 +14,70 @@
 
 using json = nlohmann::json;
 
+// Delivery priority lanes, most urgent first
+enum class EventPriority {
+    high = 0,
+    normal = 1,
+    low = 2
+};
+
+constexpr size_t EVENT_PRIORITY_COUNT = 3;
+
 // Event structure for broadcasting
 struct Event {
     std::string type;          // Event type (e.g., "user_action", "system_alert")
     std::string timestamp;     // ISO 8601 timestamp
     json payload;              // Event payload as JSON
+    EventPriority priority = EventPriority::normal;            // Delivery lane
+    uint64_t sequence = 0;                                     // Assigned by EventManager::publish_event
+    std::chrono::steady_clock::time_point published_at{};      // Set by EventManager::publish_event
+    std::chrono::steady_clock::time_point expires_at{};        // Dropped once stale; zero never expires
+
+    /**
+     * True once the event's TTL has run out (never for events without one)
+     */
+    bool expired(std::chrono::steady_clock::time_point now) const {
+        return expires_at != std::chrono::steady_clock::time_point{} && now >= expires_at;
+    }
 
     json to_json() const;
     std::string to_string() const;
 };
 
+// Serialized event frame, shared read-only by every client it is sent to
+using SharedFrame = std::shared_ptr<const std::string>;
+
 // Get current timestamp in ISO 8601 format
 std::string get_iso8601_timestamp();
+
+// Approximate heap + inline bytes held by a JSON value (recursive)
+size_t estimate_json_memory(const json& value);
+
+// Approximate bytes held by a queued event, including its payload tree
+size_t estimate_event_memory(const Event& event);
+
+// Priority name ("high", "normal", "low")
+const char* event_priority_name(EventPriority priority);
+
+// Parse a priority name; returns false for unknown names
+bool parse_event_priority(const std::string& name, EventPriority& out_priority);
+
+/**
+ * Weighted round-robin over priority lanes
+ * Each round serves up to weights[i] items from lane i, most urgent lane first.
+ */
+class LaneScheduler {
+public:
+    using Weights = std::array<unsigned, EVENT_PRIORITY_COUNT>;
+
+    explicit LaneScheduler(const Weights& weights = {8, 4, 1});
+
+    void set_weights(const Weights& weights);
+
+    // Pick the lane to serve next, or -1 when every lane is empty
+    int next(const std::array<bool, EVENT_PRIORITY_COUNT>& non_empty);
+
+private:
+    Weights weights_;
+    Weights credits_;
+};
@@ -0,0 +1,201 @@
+﻿#include "connection_limiter.h"
+#include <functional>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Soft RLIMIT_NOFILE, 0 where there is no such limit
+size_t descriptor_limit() {
+#if defined(__linux__)
+    struct rlimit limit {};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+        return static_cast<size_t>(limit.rlim_cur);
+    }
+#endif
+    return 0;
+}
+
+// Descriptors open in this process, 0 where it cannot be measured
+size_t open_descriptors() {
+#if defined(__linux__)
+    DIR* dir = opendir("/proc/self/fd");
+    if (!dir) {
+        return 0;
+    }
+    size_t count = 0;
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            count++;
+        }
+    }
+    closedir(dir);
+    return count > 0 ? count - 1 : 0;  // Minus the one opendir holds
+#else
+    return 0;
+#endif
+}
+
+}  // namespace
+
+ConnectionLimiter::ConnectionLimiter() {
+    configure(ConnectionLimitConfig{});
+}
+
+void ConnectionLimiter::configure(const ConnectionLimitConfig& config) {
+    max_connections_ = config.max_connections;
+    max_per_ip_ = config.max_connections_per_ip;
+    max_pending_ = config.max_pending_handshakes;
+    handshake_timeout_ms_ = config.handshake_timeout.count();
+    fd_pause_ratio_ = config.fd_pause_ratio;
+    accept_pause_ms_ = config.accept_pause.count();
+    fd_limit_ = descriptor_limit();
+}
+
+std::chrono::milliseconds ConnectionLimiter::handshake_timeout() const {
+    return std::chrono::milliseconds(handshake_timeout_ms_.load(std::memory_order_relaxed));
+}
+
+ConnectionLimiter::Shard& ConnectionLimiter::shard_for(const std::string& address) {
+    return shards_[std::hash<std::string>{}(address) % SHARD_COUNT];
+}
+
+AdmissionResult ConnectionLimiter::admit(const std::string& address) {
+    // Claim the global slots first and give them back on rejection, so
+    // concurrent acceptors can never overshoot a limit
+    size_t max_connections = max_connections_.load(std::memory_order_relaxed);
+    if (active_.fetch_add(1, std::memory_order_relaxed) >= max_connections && max_connections > 0) {
+        active_.fetch_sub(1, std::memory_order_relaxed);
+        rejected_total_.fetch_add(1, std::memory_order_relaxed);
+        return AdmissionResult::total_limited;
+    }
+
+    size_t max_pending = max_pending_.load(std::memory_order_relaxed);
+    if (pending_.fetch_add(1, std::memory_order_relaxed) >= max_pending && max_pending > 0) {
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        active_.fetch_sub(1, std::memory_order_relaxed);
+        rejected_handshakes_.fetch_add(1, std::memory_order_relaxed);
+        return AdmissionResult::handshake_limited;
+    }
+
+    {
+        auto& shard = shard_for(address);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        size_t& count = shard.connections[address];
+        size_t max_per_ip = max_per_ip_.load(std::memory_order_relaxed);
+        if (max_per_ip > 0 && count >= max_per_ip) {
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+            active_.fetch_sub(1, std::memory_order_relaxed);
+            rejected_per_ip_.fetch_add(1, std::memory_order_relaxed);
+            return AdmissionResult::per_ip_limited;
+        }
+        count++;
+    }
+
+    admitted_.fetch_add(1, std::memory_order_relaxed);
+    return AdmissionResult::admitted;
+}
+
+void ConnectionLimiter::handshake_finished(bool timed_out) {
+    pending_.fetch_sub(1, std::memory_order_relaxed);
+    if (timed_out) {
+        handshake_timeouts_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void ConnectionLimiter::release(const std::string& address) {
+    {
+        auto& shard = shard_for(address);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.connections.find(address);
+        if (it != shard.connections.end() && --it->second == 0) {
+            shard.connections.erase(it);
+        }
+    }
+    active_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+size_t ConnectionLimiter::pause_threshold() const {
+    size_t limit = fd_limit_.load(std::memory_order_relaxed);
+    double ratio = fd_pause_ratio_.load(std::memory_order_relaxed);
+    if (limit == 0 || ratio <= 0.0) {
+        return 0;
+    }
+    return static_cast<size_t>(static_cast<double>(limit) * ratio);
+}
+
+size_t ConnectionLimiter::estimated_descriptors() const {
+    // One descriptor per admitted connection (handshakes included) on top of
+    // everything else the last sample found open
+    return baseline_fds_.load(std::memory_order_relaxed) +
+           active_.load(std::memory_order_relaxed);
+}
+
+void ConnectionLimiter::sample_descriptors() {
+    size_t estimate = estimated_descriptors();
+    size_t threshold = pause_threshold();
+    int64_t now_ns = steady_now_ns();
+    int64_t refresh_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(BASELINE_REFRESH).count();
+    bool near_limit = threshold > 0 &&
+                      estimate >= static_cast<size_t>(static_cast<double>(threshold) * SAMPLE_RATIO);
+    if (!near_limit && now_ns - baseline_sampled_ns_.load(std::memory_order_relaxed) < refresh_ns) {
+        open_fds_ = estimate;
+        return;
+    }
+    size_t active = active_.load(std::memory_order_relaxed);
+    size_t open = open_descriptors();
+    if (open == 0) {
+        open_fds_ = estimate;  // Not measurable here; keep the default baseline
+        return;
+    }
+    baseline_fds_ = open > active ? open - active : 0;
+    baseline_sampled_ns_ = now_ns;
+    open_fds_ = open;
+}
+
+std::chrono::milliseconds ConnectionLimiter::accept_delay() {
+    size_t threshold = pause_threshold();
+    if (threshold == 0 || estimated_descriptors() < threshold) {
+        return std::chrono::milliseconds(0);
+    }
+    accept_pauses_.fetch_add(1, std::memory_order_relaxed);
+    return std::chrono::milliseconds(accept_pause_ms_.load(std::memory_order_relaxed));
+}
+
+std::chrono::milliseconds ConnectionLimiter::descriptors_exhausted() {
+    accept_pauses_.fetch_add(1, std::memory_order_relaxed);
+    return std::chrono::milliseconds(accept_pause_ms_.load(std::memory_order_relaxed));
+}
+
+ConnectionLimiter::Stats ConnectionLimiter::get_stats() const {
+    Stats stats{};
+    stats.active = active_.load(std::memory_order_relaxed);
+    stats.pending_handshakes = pending_.load(std::memory_order_relaxed);
+    stats.admitted = admitted_.load(std::memory_order_relaxed);
+    stats.rejected_total = rejected_total_.load(std::memory_order_relaxed);
+    stats.rejected_per_ip = rejected_per_ip_.load(std::memory_order_relaxed);
+    stats.rejected_handshakes = rejected_handshakes_.load(std::memory_order_relaxed);
+    stats.handshake_timeouts = handshake_timeouts_.load(std::memory_order_relaxed);
+    stats.accept_pauses = accept_pauses_.load(std::memory_order_relaxed);
+    stats.open_fds = open_fds_.load(std::memory_order_relaxed);
+    stats.fd_limit = fd_limit_.load(std::memory_order_relaxed);
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.tracked_addresses += shard.connections.size();
+    }
+    return stats;
+}
+
+ConnectionLimiter& get_connection_limiter() {
+    static ConnectionLimiter instance;
+    return instance;
+}
@@ -0,0 +1,150 @@
+﻿#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Admission limits for WebSocket connections
+ * A limit of 0 disables it.
+ */
+struct ConnectionLimitConfig {
+    size_t max_connections = 100000;
+    size_t max_connections_per_ip = 1000;
+    size_t max_pending_handshakes = 1024;
+    std::chrono::milliseconds handshake_timeout{10000};
+    // Stop accepting while open descriptors exceed this share of RLIMIT_NOFILE
+    double fd_pause_ratio = 0.9;
+    std::chrono::milliseconds accept_pause{100};
+};
+
+enum class AdmissionResult {
+    admitted,
+    total_limited,
+    per_ip_limited,
+    handshake_limited
+};
+
+/**
+ * Counts connections from accept to close and decides who gets in
+ *
+ * Accepted sockets are admitted (or closed right away) before the WebSocket
+ * handshake starts, so a reconnect storm costs one accept and one close per
+ * rejected attempt. Accepting is paused, leaving new connections in the
+ * listen backlog, while the process is close to its descriptor limit.
+ * Safe to call from every acceptor thread.
+ */
+class ConnectionLimiter {
+public:
+    struct Stats {
+        size_t active;
+        size_t pending_handshakes;
+        size_t tracked_addresses;
+        uint64_t admitted;
+        uint64_t rejected_total;       // max_connections reached
+        uint64_t rejected_per_ip;      // max_connections_per_ip reached
+        uint64_t rejected_handshakes;  // max_pending_handshakes reached
+        uint64_t handshake_timeouts;
+        uint64_t accept_pauses;
+        size_t open_fds;               // Last estimate or sample, 0 where it cannot be measured
+        size_t fd_limit;
+    };
+
+    ConnectionLimiter();
+
+    ConnectionLimiter(const ConnectionLimiter&) = delete;
+    ConnectionLimiter& operator=(const ConnectionLimiter&) = delete;
+
+    /**
+     * Apply new limits; connections already admitted stay open
+     */
+    void configure(const ConnectionLimitConfig& config);
+
+    std::chrono::milliseconds handshake_timeout() const;
+
+    /**
+     * Count a new connection from address, with its handshake pending
+     * Every admitted connection must be released exactly once.
+     */
+    AdmissionResult admit(const std::string& address);
+
+    /**
+     * The handshake of an admitted connection finished (either way)
+     */
+    void handshake_finished(bool timed_out);
+
+    /**
+     * An admitted connection closed
+     */
+    void release(const std::string& address);
+
+    /**
+     * How long acceptors should wait before accepting again, 0 to go on
+     * Estimates descriptor usage from the admitted connections plus the
+     * baseline of the last sample; never reads /proc.
+     */
+    std::chrono::milliseconds accept_delay();
+
+    /**
+     * Count the open descriptors when the estimate nears the pause threshold,
+     * or when the baseline is older than BASELINE_REFRESH
+     * O(open descriptors): call it from a thread that serves no I/O.
+     */
+    void sample_descriptors();
+
+    /**
+     * Accept failed for lack of descriptors (EMFILE/ENFILE); pause accepting
+     */
+    std::chrono::milliseconds descriptors_exhausted();
+
+    Stats get_stats() const;
+
+private:
+    static constexpr size_t SHARD_COUNT = 16;
+    // Descriptors other than WebSocket connections until the first sample
+    static constexpr size_t DEFAULT_BASELINE_FDS = 64;
+    // Share of the pause threshold from which every sample_descriptors() counts
+    static constexpr double SAMPLE_RATIO = 0.75;
+    static constexpr std::chrono::seconds BASELINE_REFRESH{10};
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, size_t> connections;
+    };
+
+    std::atomic<size_t> max_connections_{0};
+    std::atomic<size_t> max_per_ip_{0};
+    std::atomic<size_t> max_pending_{0};
+    std::atomic<int64_t> handshake_timeout_ms_{0};
+    std::atomic<double> fd_pause_ratio_{0.0};
+    std::atomic<int64_t> accept_pause_ms_{0};
+
+    std::atomic<size_t> active_{0};
+    std::atomic<size_t> pending_{0};
+    std::array<Shard, SHARD_COUNT> shards_;
+
+    std::atomic<size_t> baseline_fds_{DEFAULT_BASELINE_FDS};
+    std::atomic<int64_t> baseline_sampled_ns_{0};
+    std::atomic<size_t> open_fds_{0};
+    std::atomic<size_t> fd_limit_{0};
+
+    std::atomic<uint64_t> admitted_{0};
+    std::atomic<uint64_t> rejected_total_{0};
+    std::atomic<uint64_t> rejected_per_ip_{0};
+    std::atomic<uint64_t> rejected_handshakes_{0};
+    std::atomic<uint64_t> handshake_timeouts_{0};
+    std::atomic<uint64_t> accept_pauses_{0};
+
+    Shard& shard_for(const std::string& address);
+    size_t pause_threshold() const;
+    size_t estimated_descriptors() const;
+};
+
+/**
+ * Get global connection limiter instance
+ */
+ConnectionLimiter& get_connection_limiter();
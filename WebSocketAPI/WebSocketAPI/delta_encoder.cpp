@@ -0,0 +1,164 @@
+﻿#include "delta_encoder.h"
+#include "memory_pool.h"
+
+namespace {
+
+// Object keys are strings as-is; other key values use their JSON text
+std::string key_text(const json& value) {
+    return value.is_string() ? value.get<std::string>() : value.dump();
+}
+
+std::string base_id(const std::string& type, const std::string& key) {
+    std::string id;
+    id.reserve(type.size() + key.size() + 1);
+    id += type;
+    id += '\0';
+    id += key;
+    return id;
+}
+
+}  // namespace
+
+void DeltaEncoder::configure(const DeltaConfig& config) {
+    std::unordered_map<std::string, json::json_pointer> pointers;
+    for (const auto& [type, pointer] : config.type_keys) {
+        pointers.emplace(type, json::json_pointer(pointer));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = bases_.begin(); it != bases_.end();) {
+        auto old_key = config_.type_keys.find(it->second.type);
+        auto new_key = config.type_keys.find(it->second.type);
+        if (new_key == config.type_keys.end() || old_key == config_.type_keys.end() ||
+            old_key->second != new_key->second) {
+            it = bases_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    config_ = config;
+    pointers_ = std::move(pointers);
+}
+
+bool DeltaEncoder::encode(Event& event, SharedFrame& out_frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto pointer = pointers_.find(event.type);
+    if (pointer == pointers_.end() || !event.payload.contains(pointer->second)) {
+        return false;
+    }
+    std::string key = key_text(event.payload.at(pointer->second));
+    std::string id = base_id(event.type, key);
+
+    auto it = bases_.find(id);
+    if (it == bases_.end()) {
+        if (bases_.size() >= config_.max_keys) {
+            return false;
+        }
+        it = bases_.emplace(id, Base{event.type, key, {}, 0, json(), nullptr}).first;
+    }
+    Base& base = it->second;
+
+    std::string patch_frame;
+    if (base.sequence != 0) {
+        // One diff per event, shared by every client
+        json frame = {
+            {"encoding", "patch"},
+            {"type", event.type},
+            {"key", key},
+            {"sequence", event.sequence},
+            {"base_sequence", base.sequence},
+            {"timestamp", event.timestamp},
+            {"patch", json::diff(base.payload, event.payload)}
+        };
+        patch_frame = frame.dump();
+    }
+
+    base.timestamp = event.timestamp;
+    base.sequence = event.sequence;
+    base.payload = std::move(event.payload);
+    base.frame = std::allocate_shared<std::string>(RecyclingAllocator<std::string>(), full_frame(base));
+
+    if (!patch_frame.empty() && patch_frame.size() < base.frame->size()) {
+        patch_frames_++;
+        bytes_saved_ += base.frame->size() - patch_frame.size();
+        out_frame = std::allocate_shared<std::string>(RecyclingAllocator<std::string>(), std::move(patch_frame));
+    } else {
+        full_frames_++;
+        out_frame = base.frame;
+    }
+    return true;
+}
+
+bool DeltaEncoder::encodes(const std::string& type) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pointers_.count(type) > 0;
+}
+
+std::vector<SharedFrame> DeltaEncoder::snapshot_frames(const std::string& type,
+                                                       const std::string& key) const {
+    std::vector<SharedFrame> frames;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!type.empty() && !key.empty()) {
+        auto it = bases_.find(base_id(type, key));
+        if (it != bases_.end()) {
+            frames.push_back(it->second.frame);
+        }
+        return frames;
+    }
+    frames.reserve(type.empty() ? bases_.size() : 0);
+    for (const auto& [id, base] : bases_) {
+        if (type.empty() || base.type == type) {
+            frames.push_back(base.frame);
+        }
+    }
+    return frames;
+}
+
+bool DeltaEncoder::restore(const std::string& full_frame) {
+    json frame = json::parse(full_frame, nullptr, false);
+    if (!frame.is_object() || frame.value("encoding", "") != "full" ||
+        !frame.contains("type") || !frame.contains("key") || !frame.contains("payload")) {
+        return false;
+    }
+    Base base{frame["type"].get<std::string>(), frame["key"].get<std::string>(),
+              frame.value("timestamp", ""), frame.value("sequence", uint64_t{0}),
+              std::move(frame["payload"]), nullptr};
+    base.frame = std::allocate_shared<std::string>(RecyclingAllocator<std::string>(), DeltaEncoder::full_frame(base));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pointers_.count(base.type) == 0) {
+        return false;
+    }
+    std::string id = base_id(base.type, base.key);
+    if (bases_.count(id) == 0 && bases_.size() >= config_.max_keys) {
+        return false;
+    }
+    bases_[id] = std::move(base);
+    return true;
+}
+
+DeltaEncoder::Stats DeltaEncoder::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Stats{full_frames_, patch_frames_, bytes_saved_, bases_.size()};
+}
+
+std::string DeltaEncoder::full_frame(const Base& base) {
+    // Assembled as text so the base payload is dumped in place, not copied into a frame DOM
+    std::string frame = "{\"encoding\":\"full\",\"key\":";
+    frame += json(base.key).dump();
+    frame += ",\"payload\":";
+    frame += base.payload.dump();
+    frame += ",\"sequence\":";
+    frame += std::to_string(base.sequence);
+    frame += ",\"timestamp\":";
+    frame += json(base.timestamp).dump();
+    frame += ",\"type\":";
+    frame += json(base.type).dump();
+    frame += '}';
+    return frame;
+}
+
+DeltaEncoder& get_delta_encoder() {
+    static DeltaEncoder instance;
+    return instance;
+}
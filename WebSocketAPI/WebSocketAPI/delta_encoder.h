@@ -0,0 +1,108 @@
+﻿#pragma once
+
+#include "common.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Opt-in delta encoding for event types that carry object snapshots
+ * type_keys maps an event type to the JSON pointer (into "data") that
+ * identifies the object, e.g. {"device_state": "/device_id"}.
+ */
+struct DeltaConfig {
+    std::unordered_map<std::string, std::string> type_keys;
+    size_t max_keys = 65536;  // Keys tracked at once; further keys are sent in full
+};
+
+/**
+ * Per-key shared base for delta-encoded broadcasts
+ *
+ * Every client holds the same base for a key (new clients get a snapshot of
+ * all bases when they subscribe), so a patch is computed once per event and
+ * shared by all clients. Frames for delta types look like
+ *   full:  {"encoding": "full", "key", "payload", "sequence", "timestamp", "type"}
+ *   patch: {"encoding": "patch", "key", "base_sequence", "patch": [RFC 6902 ops],
+ *           "sequence", "timestamp", "type"}
+ * A client whose base sequence does not match base_sequence asks for a
+ * snapshot with {"op": "snapshot", "type": ..., "key": ...}.
+ * Used from the WebSocket thread only; configure() may run on any thread.
+ */
+class DeltaEncoder {
+public:
+    struct Stats {
+        uint64_t full_frames;
+        uint64_t patch_frames;
+        uint64_t bytes_saved;   // Full frame bytes minus patch frame bytes, summed
+        size_t tracked_keys;
+    };
+
+    DeltaEncoder() = default;
+
+    DeltaEncoder(const DeltaEncoder&) = delete;
+    DeltaEncoder& operator=(const DeltaEncoder&) = delete;
+
+    /**
+     * Apply the per-type key pointers; bases of types whose pointer changed are dropped
+     */
+    void configure(const DeltaConfig& config);
+
+    /**
+     * Build the broadcast frame for a delta-encoded type
+     * Sends a patch against the shared base when it is smaller than the full
+     * document, and makes the event's payload the new base (the payload is moved).
+     * A full frame is the base's own frame, shared with later snapshots.
+     * @return false if the type is not delta-encoded or the payload has no key;
+     *         the event is left untouched and should be sent as usual
+     */
+    bool encode(Event& event, SharedFrame& out_frame);
+
+    /**
+     * True if events of this type are delta-encoded
+     */
+    bool encodes(const std::string& type) const;
+
+    /**
+     * Full frames for the current bases, shared rather than re-serialized
+     * @param type Only this type, or every type when empty
+     * @param key Only this key, or every key of the type when empty
+     */
+    std::vector<SharedFrame> snapshot_frames(const std::string& type = std::string(),
+                                             const std::string& key = std::string()) const;
+
+    /**
+     * Restore a base from one of snapshot_frames (hot restart handoff)
+     * @return false if the frame is malformed, its type is not delta-encoded
+     *         or max_keys is reached
+     */
+    bool restore(const std::string& full_frame);
+
+    Stats get_stats() const;
+
+private:
+    struct Base {
+        std::string type;
+        std::string key;
+        std::string timestamp;
+        uint64_t sequence = 0;
+        json payload;
+        SharedFrame frame;  // Full frame for the current payload
+    };
+
+    mutable std::mutex mutex_;
+    DeltaConfig config_;
+    std::unordered_map<std::string, json::json_pointer> pointers_;
+    std::unordered_map<std::string, Base> bases_;  // By type + '\0' + key
+    uint64_t full_frames_ = 0;
+    uint64_t patch_frames_ = 0;
+    uint64_t bytes_saved_ = 0;
+
+    static std::string full_frame(const Base& base);
+};
+
+/**
+ * Get global delta encoder instance
+ */
+DeltaEncoder& get_delta_encoder();
@@ -1,35 +1,412 @@
 ﻿#include "event_manager.h"
+#include "flight_recorder.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+LogCounter events_queued("events_queued");
+LogCounter events_spilled("events_spilled");
+LogCounter events_rejected("events_rejected");
+LogCounter events_expired("events_expired");
+
+LogRateLimiter overflow_log(10);
+
+}  // namespace
+
+// LatencyStats implementation
+
+void LatencyStats::record(std::chrono::steady_clock::duration latency) {
+    auto us = static_cast<uint64_t>(std::max<int64_t>(0,
+        std::chrono::duration_cast<std::chrono::microseconds>(latency).count()));
+    count_.fetch_add(1, std::memory_order_relaxed);
+    total_us_.fetch_add(us, std::memory_order_relaxed);
+    uint64_t current = max_us_.load(std::memory_order_relaxed);
+    while (us > current &&
+           !max_us_.compare_exchange_weak(current, us, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyStats::Snapshot LatencyStats::snapshot() const {
+    return Snapshot{
+        count_.load(std::memory_order_relaxed),
+        total_us_.load(std::memory_order_relaxed),
+        max_us_.load(std::memory_order_relaxed)
+    };
+}
+
+// EventManager implementation
 
 EventManager::EventManager() {
+    configure(EventQueueConfig{});
 }
 
-void EventManager::publish_event(const Event& event) {
+void EventManager::configure(const EventQueueConfig& config) {
     std::lock_guard<std::mutex> lock(queue_mutex_);
-    event_queue_.push(event);
-    log_info("=== Event published: type=" + event.type + ", queue_size=" + std::to_string(event_queue_.size()) + " ===");
+    if (spilled_pending_ > 0 && config.spill_file_path != config_.spill_file_path) {
+        log_warn("Spill file path change ignored while " + std::to_string(spilled_pending_) +
+                 " events are spilled");
+        auto path = config_.spill_file_path;
+        config_ = config;
+        config_.spill_file_path = path;
+    } else {
+        config_ = config;
+    }
+    high_watermark_bytes_ = static_cast<size_t>(config_.memory_budget_bytes * config_.high_watermark);
+    low_watermark_bytes_ = static_cast<size_t>(config_.memory_budget_bytes * config_.low_watermark);
+    if (low_watermark_bytes_ > high_watermark_bytes_) {
+        low_watermark_bytes_ = high_watermark_bytes_;
+    }
+    scheduler_.set_weights(config_.lane_weights);
+}
+
+LaneScheduler::Weights EventManager::lane_weights() const {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    return config_.lane_weights;
+}
+
+EventPriority EventManager::priority_for_type(const std::string& type) const {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    auto it = config_.type_priorities.find(type);
+    return it != config_.type_priorities.end() ? it->second : EventPriority::normal;
+}
+
+std::chrono::milliseconds EventManager::ttl_for_type(const std::string& type) const {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    auto it = config_.type_ttls.find(type);
+    return it != config_.type_ttls.end() ? it->second : std::chrono::milliseconds(0);
+}
+
+PublishResult EventManager::publish_event(Event event, uint64_t* out_sequence,
+                                          ForwardCallback on_forwarded) {
+    event.published_at = std::chrono::steady_clock::now();
+
+    // Estimate outside the lock; the payload walk is the expensive part
+    size_t bytes = estimate_event_memory(event) + sizeof(QueuedEvent) - sizeof(Event);
+
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+
+    if (forward_) {
+        // Handed over: the successor process queues and numbers it, and
+        // on_forwarded gets its answer; nobody waits here for it
+        if (!on_forwarded) {
+            return PublishResult::rejected;
+        }
+        auto forward = forward_;
+        lock.unlock();
+        if (!forward(std::move(event), std::move(on_forwarded))) {
+            return PublishResult::rejected;
+        }
+        return PublishResult::forwarded;
+    }
+
+    // Once events are in the spill file, later events follow them there to keep order
+    if (!overflowing_ && spilled_pending_ == 0 &&
+        queued_bytes_ + bytes > high_watermark_bytes_) {
+        overflowing_ = true;
+        log_warn("Event queue reached high watermark (" + std::to_string(queued_bytes_) +
+                 " bytes, " + std::to_string(queued_events_) + " events)");
+    }
+
+    if (overflowing_ || spilled_pending_ > 0) {
+        event.sequence = next_sequence_;
+        if (config_.overflow_policy == OverflowPolicy::spill && spill_locked(event)) {
+            next_sequence_++;
+            if (out_sequence) {
+                *out_sequence = event.sequence;
+            }
+            events_spilled.add(bytes);
+            flight_record(FlightEvent::spill, 0, bytes, static_cast<uint16_t>(event.priority));
+            if (overflow_log.allow()) {
+                log_info("=== Event spilled: type=" + event.type + ", spilled=" +
+                         std::to_string(spilled_pending_) + " ===" +
+                         overflow_log.suppressed_suffix());
+            }
+            return PublishResult::spilled;
+        }
+        rejected_total_++;
+        events_rejected.add(bytes);
+        flight_record(FlightEvent::reject, 0, bytes, static_cast<uint16_t>(event.priority));
+        if (overflow_log.allow()) {
+            log_warn("Event rejected (queue over high watermark): type=" + event.type +
+                     overflow_log.suppressed_suffix());
+        }
+        return PublishResult::rejected;
+    }
+
+    if (log_debug_enabled()) {
+        log_debug("=== Event published: type=" + event.type + ", priority=" +
+                  event_priority_name(event.priority) +
+                  ", queue_size=" + std::to_string(queued_events_ + 1) + " ===");
+    }
+    event.sequence = next_sequence_++;
+    if (out_sequence) {
+        *out_sequence = event.sequence;
+    }
+    events_queued.add(bytes);
+    flight_record(FlightEvent::publish, event.sequence, bytes, static_cast<uint16_t>(event.priority));
+    push_locked(std::move(event), bytes);
+    return PublishResult::queued;
 }
 
 bool EventManager::get_next_event(Event& out_event) {
     std::lock_guard<std::mutex> lock(queue_mutex_);
-    if (event_queue_.empty()) {
+    if (spilled_pending_ > 0 && queued_bytes_ <= low_watermark_bytes_) {
+        refill_from_spill_locked();
+    }
+    auto now = std::chrono::steady_clock::now();
+    int lane;
+    for (;;) {
+        std::array<bool, EVENT_PRIORITY_COUNT> non_empty;
+        for (size_t i = 0; i < EVENT_PRIORITY_COUNT; i++) {
+            non_empty[i] = !lanes_[i].empty();
+        }
+        lane = scheduler_.next(non_empty);
+        if (lane < 0) {
+            break;
+        }
+        auto& queue = lanes_[lane];
+        auto& front = queue.front();
+        queued_bytes_ -= front.bytes;
+        queued_events_--;
+        if (!front.event.expired(now)) {
+            out_event = std::move(front.event);
+            queue.pop();
+            if (mirror_) {
+                mirror_(out_event);
+            }
+            break;
+        }
+        // Stale: dropped before it costs a serialization or a fan-out
+        expired_queued_++;
+        events_expired.add(front.bytes);
+        flight_record(FlightEvent::expire, front.event.sequence,
+                      std::chrono::duration_cast<std::chrono::microseconds>(
+                          now - front.event.published_at).count(),
+                      static_cast<uint16_t>(lane));
+        queue.pop();
+        if (spilled_pending_ > 0 && queued_bytes_ <= low_watermark_bytes_) {
+            refill_from_spill_locked();
+        }
+    }
+
+    if (overflowing_ && queued_bytes_ <= low_watermark_bytes_) {
+        overflowing_ = false;
+        log_info("Event queue back below low watermark (" + std::to_string(queued_bytes_) + " bytes)");
+    }
+    if (lane < 0) {
         return false;
     }
-    out_event = event_queue_.front();
-    event_queue_.pop();
-    log_info("=== Event dequeued: type=" + out_event.type + " ===");
+
+    auto queue_latency = now - out_event.published_at;
+    queue_latency_[lane].record(queue_latency);
+    flight_record(FlightEvent::dequeue, 0,
+                  std::chrono::duration_cast<std::chrono::microseconds>(queue_latency).count(),
+                  static_cast<uint16_t>(lane));
+
+    if (log_debug_enabled()) {
+        log_debug("=== Event dequeued: type=" + out_event.type + " ===");
+    }
     return true;
 }
 
 bool EventManager::has_events() const {
     std::lock_guard<std::mutex> lock(queue_mutex_);
-    return !event_queue_.empty();
+    return queued_events_ > 0 || spilled_pending_ > 0;
 }
 
 void EventManager::clear_events() {
     std::lock_guard<std::mutex> lock(queue_mutex_);
-    while (!event_queue_.empty()) {
-        event_queue_.pop();
+    for (auto& queue : lanes_) {
+        while (!queue.empty()) {
+            queue.pop();
+        }
+    }
+    queued_events_ = 0;
+    queued_bytes_ = 0;
+    overflowing_ = false;
+    reset_spill_locked();
+}
+
+EventManager::Stats EventManager::get_stats() const {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    Stats stats{};
+    stats.queued_events = queued_events_;
+    stats.queued_bytes = queued_bytes_;
+    stats.peak_bytes = peak_bytes_;
+    stats.memory_budget_bytes = config_.memory_budget_bytes;
+    stats.spilled_pending = spilled_pending_;
+    stats.spilled_total = spilled_total_;
+    stats.rejected_total = rejected_total_;
+    stats.expired_queued = expired_queued_;
+    stats.expired_outbound = expired_outbound_.load(std::memory_order_relaxed);
+    stats.overflowing = overflowing_;
+    for (size_t lane = 0; lane < EVENT_PRIORITY_COUNT; lane++) {
+        stats.lane_events[lane] = lanes_[lane].size();
+        stats.queue_latency[lane] = queue_latency_[lane].snapshot();
+        stats.delivery_latency[lane] = delivery_latency_[lane].snapshot();
+    }
+    return stats;
+}
+
+void EventManager::record_delivery_latency(EventPriority priority,
+                                           std::chrono::steady_clock::duration latency) {
+    delivery_latency_[static_cast<size_t>(priority)].record(latency);
+}
+
+void EventManager::record_expired_delivery(size_t bytes) {
+    expired_outbound_.fetch_add(1, std::memory_order_relaxed);
+    events_expired.add(bytes);
+}
+
+bool EventManager::forwarding() const {
+    return forwarding_.load(std::memory_order_relaxed);
+}
+
+std::vector<Event> EventManager::export_events(std::function<bool(Event, ForwardCallback)> forward,
+                                               uint64_t& out_next_sequence) {
+    std::vector<Event> events;
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    events.reserve(queued_events_ + spilled_pending_);
+    for (auto& queue : lanes_) {
+        while (!queue.empty()) {
+            events.push_back(std::move(queue.front().event));
+            queue.pop();
+        }
+    }
+
+    // Spilled events are newer than anything in the lanes
+    if (spilled_pending_ > 0) {
+        spill_out_.flush();
+        if (!spill_in_.is_open()) {
+            spill_in_.open(config_.spill_file_path, std::ios::binary);
+        }
+        spill_in_.clear();
+        std::string line;
+        while (spilled_pending_ > 0 && std::getline(spill_in_, line)) {
+            spilled_pending_--;
+            try {
+                auto spilled = json::parse(line);
+                events.push_back(event_from_queued_record(spilled));
+            } catch (const std::exception& e) {
+                log_error("Dropping corrupt spilled event: " + std::string(e.what()));
+            }
+        }
+    }
+
+    queued_events_ = 0;
+    queued_bytes_ = 0;
+    overflowing_ = false;
+    reset_spill_locked();
+    forward_ = std::move(forward);
+    forwarding_ = true;
+    out_next_sequence = next_sequence_;
+    return events;
+}
+
+void EventManager::import_events(std::vector<Event> events, uint64_t next_sequence) {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    for (auto& event : events) {
+        size_t bytes = estimate_event_memory(event) + sizeof(QueuedEvent) - sizeof(Event);
+        push_locked(std::move(event), bytes);
     }
+    next_sequence_ = std::max(next_sequence_, next_sequence);
+    forward_ = nullptr;
+    forwarding_ = false;
+}
+
+void EventManager::mirror_event(Event event) {
+    size_t bytes = estimate_event_memory(event) + sizeof(QueuedEvent) - sizeof(Event);
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    push_locked(std::move(event), bytes);
+}
+
+void EventManager::set_mirror(std::function<void(const Event&)> mirror) {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    mirror_ = std::move(mirror);
+}
+
+void EventManager::push_locked(Event event, size_t bytes) {
+    auto lane = static_cast<size_t>(event.priority);
+    lanes_[lane].push(QueuedEvent{std::move(event), bytes});
+    queued_events_++;
+    queued_bytes_ += bytes;
+    if (queued_bytes_ > peak_bytes_) {
+        peak_bytes_ = queued_bytes_;
+    }
+}
+
+bool EventManager::spill_locked(const Event& event) {
+    if (!spill_out_.is_open()) {
+        // A fresh spill run starts from an empty file
+        spill_out_.open(config_.spill_file_path,
+                        std::ios::binary | std::ios::out | std::ios::trunc);
+        if (!spill_out_) {
+            log_error("Failed to open spill file: " + config_.spill_file_path);
+            spill_out_.close();
+            return false;
+        }
+    }
+
+    spill_out_ << queued_event_record(event).dump() << '\n';
+    if (!spill_out_) {
+        log_error("Failed to write spill file: " + config_.spill_file_path);
+        return false;
+    }
+    spilled_pending_++;
+    spilled_total_++;
+    return true;
+}
+
+void EventManager::refill_from_spill_locked() {
+    spill_out_.flush();
+    if (!spill_in_.is_open()) {
+        spill_in_.open(config_.spill_file_path, std::ios::binary);
+        if (!spill_in_) {
+            log_error("Failed to open spill file for reading: " + config_.spill_file_path);
+            spill_in_.close();
+            return;
+        }
+    }
+    spill_in_.clear();
+
+    std::string line;
+    size_t loaded = 0;
+    while (spilled_pending_ > 0 && queued_bytes_ < high_watermark_bytes_ &&
+           std::getline(spill_in_, line)) {
+        spilled_pending_--;
+        try {
+            auto spilled = json::parse(line);
+            Event event = event_from_queued_record(spilled);
+            size_t bytes = estimate_event_memory(event) + sizeof(QueuedEvent) - sizeof(Event);
+            push_locked(std::move(event), bytes);
+            loaded++;
+        } catch (const std::exception& e) {
+            log_error("Dropping corrupt spilled event: " + std::string(e.what()));
+        }
+    }
+
+    if (loaded > 0) {
+        log_info("Drained " + std::to_string(loaded) + " events from spill file, " +
+                 std::to_string(spilled_pending_) + " remaining");
+    }
+    if (spilled_pending_ == 0) {
+        reset_spill_locked();
+    }
+}
+
+void EventManager::reset_spill_locked() {
+    if (spill_out_.is_open()) {
+        spill_out_.close();
+    }
+    if (spill_in_.is_open()) {
+        spill_in_.close();
+    }
+    if (spilled_pending_ > 0) {
+        log_warn("Discarding " + std::to_string(spilled_pending_) + " spilled events");
+    }
+    spilled_pending_ = 0;
+    std::remove(config_.spill_file_path.c_str());
 }
 
 // Global event manager instance
@@ -37,3 +414,73 @@ EventManager& get_event_manager() {
     static EventManager instance;
     return instance;
 }
+
+json queued_event_record(const Event& event) {
+    json record = event.to_json();
+    record["priority"] = event_priority_name(event.priority);
+    record["published_ns"] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        event.published_at.time_since_epoch()).count();
+    if (event.expires_at != std::chrono::steady_clock::time_point{}) {
+        record["expires_ns"] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            event.expires_at.time_since_epoch()).count();
+    }
+    return record;
+}
+
+Event event_from_queued_record(json& record) {
+    Event event;
+    event.type = record.at("type").get<std::string>();
+    event.timestamp = record.at("timestamp").get<std::string>();
+    event.payload = std::move(record.at("payload"));
+    parse_event_priority(record.value("priority", "normal"), event.priority);
+    event.sequence = record.value("sequence", uint64_t{0});
+    event.published_at = std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::nanoseconds(record.value("published_ns", int64_t{0}))));
+    event.expires_at = std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::nanoseconds(record.value("expires_ns", int64_t{0}))));
+    return event;
+}
+
+std::string event_from_request(json& request, Event& out_event) {
+    if (!request.is_object() || !request.contains("type") || !request.contains("data")) {
+        return "Missing 'type' or 'data' field";
+    }
+    const auto& type_field = request["type"];
+    if (!type_field.is_string() || type_field.get_ref<const std::string&>().empty()) {
+        return "Invalid 'type' field (expected a non-empty string)";
+    }
+
+    out_event.type = type_field.get<std::string>();
+    out_event.timestamp = get_iso8601_timestamp();
+    out_event.payload = std::move(request["data"]);
+
+    // Explicit priority wins over the per-type default
+    if (request.contains("priority")) {
+        const auto& priority_field = request["priority"];
+        if (!priority_field.is_string() ||
+            !parse_event_priority(priority_field.get<std::string>(), out_event.priority)) {
+            return "Invalid 'priority' field (expected high, normal or low)";
+        }
+    } else {
+        out_event.priority = get_event_manager().priority_for_type(out_event.type);
+    }
+
+    // Likewise for the TTL; it runs from now, so queueing and delivery both count against it
+    std::chrono::milliseconds ttl(0);
+    if (request.contains("ttl_ms")) {
+        const auto& ttl_field = request["ttl_ms"];
+        if (!ttl_field.is_number_unsigned() ||
+            ttl_field.get<uint64_t>() > static_cast<uint64_t>(MAX_EVENT_TTL.count())) {
+            return "Invalid 'ttl_ms' field (expected an integer from 0 to " +
+                   std::to_string(MAX_EVENT_TTL.count()) + ")";
+        }
+        ttl = std::chrono::milliseconds(ttl_field.get<uint64_t>());
+    } else {
+        ttl = get_event_manager().ttl_for_type(out_event.type);
+    }
+    out_event.expires_at = ttl.count() > 0 ? std::chrono::steady_clock::now() + ttl
+                                           : std::chrono::steady_clock::time_point{};
+    return std::string();
+}
@@ -3,12 +3,104 @@
 #include "common.h"
 #include <queue>
 #include <mutex>
+#include <fstream>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * What to do with new events while the queue is above its high watermark
+ */
+enum class OverflowPolicy {
+    reject,     // Refuse the event (REST answers 503)
+    spill       // Append the event to the spill file, drained back in order later
+};
+
+/**
+ * Memory limits for queued events
+ * Overflow starts when queued bytes reach high_watermark * memory_budget_bytes
+ * and ends once they fall back to low_watermark * memory_budget_bytes.
+ */
+struct EventQueueConfig {
+    size_t memory_budget_bytes = 64 * 1024 * 1024;
+    double high_watermark = 0.9;
+    double low_watermark = 0.7;
+    OverflowPolicy overflow_policy = OverflowPolicy::reject;
+    std::string spill_file_path = "event_spill.jsonl";
+
+    // Events served per scheduling round from each lane (high, normal, low)
+    LaneScheduler::Weights lane_weights = {8, 4, 1};
+    // Priority for events that do not carry an explicit "priority" field
+    std::unordered_map<std::string, EventPriority> type_priorities = {
+        {"system_alert", EventPriority::high}
+    };
+    // Time to live for events that do not carry an explicit "ttl_ms" field;
+    // types not listed never expire. Stale events are dropped at dequeue and
+    // from per-session outbound queues instead of being delivered late.
+    std::unordered_map<std::string, std::chrono::milliseconds> type_ttls{};
+};
+
+/**
+ * Lock-free latency accumulator (microseconds)
+ */
+class LatencyStats {
+public:
+    struct Snapshot {
+        uint64_t count;
+        uint64_t total_us;
+        uint64_t max_us;
+
+        uint64_t average_us() const { return count ? total_us / count : 0; }
+    };
+
+    void record(std::chrono::steady_clock::duration latency);
+    Snapshot snapshot() const;
+
+private:
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> total_us_{0};
+    std::atomic<uint64_t> max_us_{0};
+};
+
+/**
+ * Result of publish_event
+ */
+enum class PublishResult {
+    queued,
+    spilled,
+    rejected,
+    forwarded   // Handed to a hot restart successor; on_forwarded reports the outcome
+};
 
 /**
  * Thread-safe event queue and broadcast manager
  */
 class EventManager {
 public:
+    struct Stats {
+        size_t queued_events;
+        size_t queued_bytes;
+        size_t peak_bytes;
+        size_t memory_budget_bytes;
+        size_t spilled_pending;
+        uint64_t spilled_total;
+        uint64_t rejected_total;
+        uint64_t expired_queued;     // Dropped at dequeue, never broadcast
+        uint64_t expired_outbound;   // Dropped from WebSocket and SSE outbound queues
+        bool overflowing;
+        std::array<size_t, EVENT_PRIORITY_COUNT> lane_events;
+        // Publish -> dequeue, and publish -> written to a WebSocket client
+        std::array<LatencyStats::Snapshot, EVENT_PRIORITY_COUNT> queue_latency;
+        std::array<LatencyStats::Snapshot, EVENT_PRIORITY_COUNT> delivery_latency;
+    };
+
+    /**
+     * Outcome of a forwarded publish: queued with the successor's sequence,
+     * or rejected with 0. Called once, on a hot restart thread.
+     */
+    using ForwardCallback = std::function<void(PublishResult result, uint64_t sequence)>;
+
     EventManager();
     ~EventManager() = default;
 
@@ -16,13 +108,46 @@ public:
     EventManager(const EventManager&) = delete;
     EventManager& operator=(const EventManager&) = delete;
 
+    /**
+     * Apply memory budget and overflow policy
+     */
+    void configure(const EventQueueConfig& config);
+
     /**
      * Enqueue an event for broadcasting
+     * @param out_sequence Receives the sequence number assigned to a queued or spilled event
+     * @param on_forwarded Once handed over to a hot restart successor, the event
+     *        is forwarded only with this set; without it the publish is rejected
+     * @return rejected when over the high watermark with the reject policy,
+     *         forwarded when on_forwarded will report the outcome
+     */
+    PublishResult publish_event(Event event, uint64_t* out_sequence = nullptr,
+                                ForwardCallback on_forwarded = nullptr);
+
+    /**
+     * True once handed over to a hot restart successor, until import_events
+     * Publishers that can answer later pass on_forwarded while it is set.
+     */
+    bool forwarding() const;
+
+    /**
+     * Lane weights, shared with the per-session outbound queues
+     */
+    LaneScheduler::Weights lane_weights() const;
+
+    /**
+     * Priority for an event type without an explicit priority
+     */
+    EventPriority priority_for_type(const std::string& type) const;
+
+    /**
+     * TTL for an event type without an explicit TTL (0: never expires)
      */
-    void publish_event(const Event& event);
+    std::chrono::milliseconds ttl_for_type(const std::string& type) const;
 
     /**
-     * Get and remove the next event from queue
+     * Get and remove the next event, weighted across priority lanes
+     * Expired events on the way are dropped and counted.
      */
     bool get_next_event(Event& out_event);
 
@@ -36,11 +161,125 @@ public:
      */
     void clear_events();
 
+    /**
+     * Record publish-to-send latency once an event reached a client
+     */
+    void record_delivery_latency(EventPriority priority,
+                                 std::chrono::steady_clock::duration latency);
+
+    /**
+     * Count a frame a session dropped from its outbound queue as expired
+     */
+    void record_expired_delivery(size_t bytes);
+
+    /**
+     * Queue memory usage, overflow counters and per-priority latency
+     */
+    Stats get_stats() const;
+
+    /**
+     * Hot restart, outgoing process: remove every queued and spilled event and
+     * hand each later publish to forward instead of queueing it. Both happen
+     * under the queue lock, so nothing is queued here after the export.
+     * forward runs outside the lock and must not wait for the successor: it
+     * takes the publish's on_forwarded, or returns false to reject it.
+     * @param out_next_sequence Receives the sequence the successor continues from
+     * @return Exported events, in dequeue order within each lane
+     */
+    std::vector<Event> export_events(std::function<bool(Event, ForwardCallback)> forward,
+                                     uint64_t& out_next_sequence);
+
+    /**
+     * Hot restart, outgoing process: queue an event the successor broadcast,
+     * for the clients still draining here. Keeps its sequence, and ignores
+     * forwarding and the watermarks.
+     */
+    void mirror_event(Event event);
+
+    /**
+     * Hot restart, incoming process: while set, mirror gets a copy of every
+     * event handed to the broadcaster (called under the queue lock)
+     */
+    void set_mirror(std::function<void(const Event&)> mirror);
+
+    /**
+     * Hot restart, incoming process: queue events exported by the predecessor,
+     * keeping their sequence numbers and priorities, and continue numbering
+     * from next_sequence. Ignores the watermarks. Also ends forwarding, which
+     * is how a failed handoff takes its events back.
+     */
+    void import_events(std::vector<Event> events, uint64_t next_sequence);
+
 private:
-    std::queue<Event> event_queue_;
+    struct QueuedEvent {
+        Event event;
+        size_t bytes;
+    };
+
+    // One FIFO per priority lane
+    std::array<std::queue<QueuedEvent>, EVENT_PRIORITY_COUNT> lanes_;
+    LaneScheduler scheduler_;
+    size_t queued_events_ = 0;
     mutable std::mutex queue_mutex_;
+
+    std::array<LatencyStats, EVENT_PRIORITY_COUNT> queue_latency_;
+    std::array<LatencyStats, EVENT_PRIORITY_COUNT> delivery_latency_;
+
+    EventQueueConfig config_;
+    size_t high_watermark_bytes_ = 0;
+    size_t low_watermark_bytes_ = 0;
+    size_t queued_bytes_ = 0;
+    size_t peak_bytes_ = 0;
+    bool overflowing_ = false;
+    uint64_t rejected_total_ = 0;
+    uint64_t expired_queued_ = 0;
+    std::atomic<uint64_t> expired_outbound_{0};
+    uint64_t next_sequence_ = 1;
+
+    // Spill file: events are appended as JSON lines and read back in order
+    std::ofstream spill_out_;
+    std::ifstream spill_in_;
+    size_t spilled_pending_ = 0;
+    uint64_t spilled_total_ = 0;
+
+    std::function<bool(Event, ForwardCallback)> forward_;  // Set once handed over to a successor
+    std::atomic<bool> forwarding_{false};
+    std::function<void(const Event&)> mirror_;  // Set while a predecessor drains its clients
+
+    void push_locked(Event event, size_t bytes);
+    bool spill_locked(const Event& event);
+    void refill_from_spill_locked();
+    void reset_spill_locked();
 };
 
+/**
+ * Maximum "ttl_ms" a publish request may ask for
+ */
+constexpr std::chrono::milliseconds MAX_EVENT_TTL = std::chrono::hours(24);
+
+/**
+ * Build an event from a publish request: {"type", "data", optional "priority",
+ * optional "ttl_ms"}
+ * Shared by POST /api/event and WebSocket publish frames so both validate alike.
+ * The request's "data" is moved into the event.
+ * @return Empty on success, otherwise the reason the request is invalid
+ */
+std::string event_from_request(json& request, Event& out_event);
+
+/**
+ * Queued event as JSON: the client-facing fields plus "priority",
+ * "published_ns" and "expires_ns" (when it has a TTL), enough to requeue it in
+ * the right lane
+ * Shared by the spill file and the hot restart handoff.
+ */
+json queued_event_record(const Event& event);
+
+/**
+ * Event back from queued_event_record (the record's payload is moved)
+ * @throws json::exception on a malformed record
+ */
+Event event_from_queued_record(json& record);
+
 /**
  * Get global event manager instance
  */
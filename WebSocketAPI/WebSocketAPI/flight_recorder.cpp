@@ -0,0 +1,208 @@
+﻿#include "flight_recorder.h"
+#include <chrono>
+#include <csignal>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+static_assert((FLIGHT_RING_CAPACITY & (FLIGHT_RING_CAPACITY - 1)) == 0,
+              "FLIGHT_RING_CAPACITY must be a power of two");
+
+// Written only by its owning thread; head is published with release so a
+// dumping thread sees every record below it
+struct FlightRing {
+    std::atomic<uint64_t> head{0};
+    uint32_t thread_index = 0;
+    FlightRecord records[FLIGHT_RING_CAPACITY];
+};
+
+std::atomic<FlightRing*> rings[FLIGHT_MAX_THREADS];
+std::atomic<uint32_t> ring_count{0};
+
+thread_local FlightRing* thread_ring = nullptr;
+thread_local bool thread_ring_exhausted = false;
+
+char dump_path[512] = "flight_recorder.bin";
+std::atomic<bool> crash_dumped{false};
+
+uint64_t steady_now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+FlightRing* acquire_ring() {
+    if (thread_ring_exhausted) {
+        return nullptr;
+    }
+    uint32_t index = ring_count.fetch_add(1, std::memory_order_relaxed);
+    if (index >= FLIGHT_MAX_THREADS) {
+        // Too many threads; later ones are simply not recorded
+        thread_ring_exhausted = true;
+        return nullptr;
+    }
+    // Leaked on purpose: a dump may run after the owning thread has exited
+    auto* ring = new FlightRing();
+    ring->thread_index = index;
+    rings[index].store(ring, std::memory_order_release);
+    thread_ring = ring;
+    return ring;
+}
+
+#if defined(_WIN32)
+int open_dump_file() {
+    return _open(dump_path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+
+bool write_all(int fd, const void* data, size_t size) {
+    return _write(fd, data, static_cast<unsigned>(size)) == static_cast<int>(size);
+}
+
+void close_dump_file(int fd) {
+    _close(fd);
+}
+#else
+int open_dump_file() {
+    return ::open(dump_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+bool write_all(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = ::write(fd, bytes, size);
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+void close_dump_file(int fd) {
+    ::close(fd);
+}
+#endif
+
+void crash_handler(int signal) {
+    if (!crash_dumped.exchange(true)) {
+        dump_flight_recorder(signal);
+    }
+#if defined(_WIN32)
+    std::signal(signal, SIG_DFL);
+#endif
+    // The handler was installed one-shot, so this runs the default action
+    std::raise(signal);
+}
+
+}  // namespace
+
+void flight_record(FlightEvent kind, uint64_t session_id, uint64_t value, uint16_t detail) {
+    FlightRing* ring = thread_ring;
+    if (!ring) {
+        ring = acquire_ring();
+        if (!ring) {
+            return;
+        }
+    }
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    FlightRecord& record = ring->records[head & (FLIGHT_RING_CAPACITY - 1)];
+    record.timestamp_ns = steady_now_ns();
+    record.session_id = session_id;
+    record.value = value;
+    record.kind = static_cast<uint16_t>(kind);
+    record.detail = detail;
+    record.reserved = 0;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void set_flight_recorder_file(const char* path) {
+    std::strncpy(dump_path, path, sizeof(dump_path) - 1);
+    dump_path[sizeof(dump_path) - 1] = '\0';
+}
+
+bool dump_flight_recorder(int signal) {
+    int fd = open_dump_file();
+    if (fd < 0) {
+        return false;
+    }
+
+    uint32_t count = ring_count.load(std::memory_order_acquire);
+    if (count > FLIGHT_MAX_THREADS) {
+        count = FLIGHT_MAX_THREADS;
+    }
+
+    FlightDumpHeader header{};
+    header.magic = FLIGHT_DUMP_MAGIC;
+    header.version = FLIGHT_DUMP_VERSION;
+    header.record_size = sizeof(FlightRecord);
+    header.steady_now_ns = steady_now_ns();
+    header.system_now_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    header.signal = signal;
+
+    // A ring slot can be claimed but not yet published; those are skipped
+    FlightRing* snapshot[FLIGHT_MAX_THREADS];
+    for (uint32_t i = 0; i < count; i++) {
+        FlightRing* ring = rings[i].load(std::memory_order_acquire);
+        if (ring) {
+            snapshot[header.ring_count++] = ring;
+        }
+    }
+
+    bool ok = write_all(fd, &header, sizeof(header));
+    for (uint32_t i = 0; ok && i < header.ring_count; i++) {
+        FlightRing* ring = snapshot[i];
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t kept = head < FLIGHT_RING_CAPACITY ? head : FLIGHT_RING_CAPACITY;
+
+        FlightRingHeader ring_header{};
+        ring_header.thread_index = ring->thread_index;
+        ring_header.count = static_cast<uint32_t>(kept);
+        ring_header.total_recorded = head;
+        ok = write_all(fd, &ring_header, sizeof(ring_header));
+
+        // Oldest first: the part after the write position, then the part before it
+        size_t start = static_cast<size_t>((head - kept) & (FLIGHT_RING_CAPACITY - 1));
+        size_t first = static_cast<size_t>(kept) < FLIGHT_RING_CAPACITY - start
+                           ? static_cast<size_t>(kept) : FLIGHT_RING_CAPACITY - start;
+        if (ok && first > 0) {
+            ok = write_all(fd, &ring->records[start], first * sizeof(FlightRecord));
+        }
+        if (ok && kept > first) {
+            ok = write_all(fd, &ring->records[0], (static_cast<size_t>(kept) - first) * sizeof(FlightRecord));
+        }
+    }
+
+    close_dump_file(fd);
+    return ok;
+}
+
+void install_flight_recorder_crash_handlers() {
+    const int signals[] = {
+        SIGSEGV, SIGABRT, SIGFPE, SIGILL,
+#if defined(SIGBUS)
+        SIGBUS,
+#endif
+    };
+    for (int signal : signals) {
+#if defined(_WIN32)
+        std::signal(signal, crash_handler);
+#else
+        struct sigaction action {};
+        action.sa_handler = crash_handler;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESETHAND;
+        sigaction(signal, &action, nullptr);
+#endif
+    }
+}
@@ -0,0 +1,97 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Always-on flight recorder
+ * Every thread that records gets its own ring of fixed-size binary records.
+ * Recording is a plain store into thread-owned memory plus one release store
+ * of the ring head, so it costs a few nanoseconds and never blocks. Rings are
+ * never freed, which lets a signal handler dump them at any time.
+ */
+
+enum class FlightEvent : uint16_t {
+    publish = 1,    // session = event sequence, value = queued bytes, detail = priority
+    dequeue = 2,    // value = queue latency (us), detail = priority
+    send = 3,       // session, value = bytes written
+    error = 4,      // session, value = error code, detail = FlightErrorSource
+    close = 5,      // session
+    accept = 6,     // session (0 for REST connections)
+    reject = 7,     // value = bytes, detail = priority
+    spill = 8,      // value = bytes, detail = priority
+    expire = 9,     // session = event sequence, value = queue latency (us), detail = priority
+};
+
+enum class FlightErrorSource : uint16_t {
+    accept = 1,
+    handshake = 2,
+    read = 3,
+    write = 4,
+    ping = 5,
+};
+
+// One record, 32 bytes; layout is part of the dump format
+struct FlightRecord {
+    uint64_t timestamp_ns;  // steady_clock since epoch
+    uint64_t session_id;
+    uint64_t value;
+    uint16_t kind;          // FlightEvent
+    uint16_t detail;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(FlightRecord) == 32, "FlightRecord layout is part of the dump format");
+
+// Records kept per thread (power of two) and most threads that get a ring
+constexpr size_t FLIGHT_RING_CAPACITY = 4096;
+constexpr size_t FLIGHT_MAX_THREADS = 64;
+
+// Dump file layout: FlightDumpHeader, then per ring a FlightRingHeader
+// followed by ring_header.count records, oldest first
+constexpr uint32_t FLIGHT_DUMP_MAGIC = 0x52465357;  // "WSFR"
+constexpr uint32_t FLIGHT_DUMP_VERSION = 1;
+
+struct FlightDumpHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t ring_count;
+    uint64_t steady_now_ns;   // Clocks read at dump time, to map
+    uint64_t system_now_ns;   // record timestamps to wall-clock time
+    int32_t signal;           // Signal that triggered the dump, 0 if requested
+    uint32_t reserved;
+};
+
+struct FlightRingHeader {
+    uint32_t thread_index;
+    uint32_t count;
+    uint64_t total_recorded;  // Records ever written, including overwritten ones
+};
+
+/**
+ * Append a record to the calling thread's ring
+ */
+void flight_record(FlightEvent kind, uint64_t session_id = 0, uint64_t value = 0,
+                   uint16_t detail = 0);
+
+/**
+ * Set the file written by dumps; call once at startup
+ * The path is copied into a fixed buffer so that signal handlers can use it.
+ */
+void set_flight_recorder_file(const char* path);
+
+/**
+ * Write all rings to the dump file
+ * Uses only async-signal-safe calls (open/write/close).
+ * @param signal Signal being handled, or 0
+ * @return true if the file was written
+ */
+bool dump_flight_recorder(int signal = 0);
+
+/**
+ * Dump the rings on fatal signals (SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL),
+ * then let the default action run
+ */
+void install_flight_recorder_crash_handlers();
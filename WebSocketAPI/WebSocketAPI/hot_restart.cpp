@@ -0,0 +1,761 @@
+﻿#include "hot_restart.h"
+#include "delta_encoder.h"
+#include "event_manager.h"
+#include "memory_pool.h"
+#include "rest_api_server.h"
+#include "state_store.h"
+#include "websocket_server.h"
+#include <future>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+
+namespace {
+
+constexpr size_t MAX_HANDLES = 64;  // Listening sockets per handoff, both servers together
+
+/**
+ * Newline-delimited JSON over a Unix stream socket, with descriptor passing
+ */
+class LineChannel {
+public:
+    explicit LineChannel(int fd) : fd_(fd) {}
+
+    // Receive timeout for later reads; zero waits indefinitely
+    void set_timeout(std::chrono::milliseconds timeout) {
+        timeval tv{};
+        tv.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+        tv.tv_usec = static_cast<suseconds_t>((timeout.count() % 1000) * 1000);
+        ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+
+    bool send_line(const std::string& line, const std::vector<int>& handles = {}) {
+        std::string data = line + '\n';
+        size_t sent = 0;
+        if (!handles.empty()) {
+            // The descriptors travel with the first bytes of the line
+            iovec iov{data.data(), data.size()};
+            std::vector<char> control(CMSG_SPACE(sizeof(int) * handles.size()));
+            msghdr message{};
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+            message.msg_control = control.data();
+            message.msg_controllen = control.size();
+            cmsghdr* header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(sizeof(int) * handles.size());
+            std::memcpy(CMSG_DATA(header), handles.data(), sizeof(int) * handles.size());
+            ssize_t n = ::sendmsg(fd_, &message, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            sent = static_cast<size_t>(n);
+        }
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    /**
+     * Next line as JSON
+     * @param handles Receives descriptors passed along; others are closed
+     * @return false at end of stream, on timeout or on a line that is not JSON
+     */
+    bool read_line(json& out, std::vector<int>* handles = nullptr) {
+        size_t end;
+        while ((end = buffer_.find('\n')) == std::string::npos) {
+            char chunk[16 * 1024];
+            iovec iov{chunk, sizeof(chunk)};
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_HANDLES)];
+            msghdr message{};
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            ssize_t n = ::recvmsg(fd_, &message, MSG_CMSG_CLOEXEC);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr;
+                 header = CMSG_NXTHDR(&message, header)) {
+                if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+                    continue;
+                }
+                size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                for (size_t i = 0; i < count; i++) {
+                    int handle;
+                    std::memcpy(&handle, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+                    if (handles) {
+                        handles->push_back(handle);
+                    } else {
+                        ::close(handle);
+                    }
+                }
+            }
+            buffer_.append(chunk, static_cast<size_t>(n));
+        }
+        out = json::parse(buffer_.begin(), buffer_.begin() + static_cast<std::ptrdiff_t>(end),
+                          nullptr, false);
+        buffer_.erase(0, end + 1);
+        return !out.is_discarded() && out.is_object();
+    }
+
+private:
+    int fd_;
+    std::string buffer_;
+};
+
+bool make_address(const std::string& path, sockaddr_un& out) {
+    out = sockaddr_un{};
+    out.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(out.sun_path)) {
+        return false;
+    }
+    std::memcpy(out.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+int connect_unix(const std::string& path) {
+    sockaddr_un address;
+    if (!make_address(path, address)) {
+        return -1;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int listen_unix(const std::string& path) {
+    sockaddr_un address;
+    if (!make_address(path, address)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    // A predecessor that handed over, or one that crashed, leaves its path behind
+    ::unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(fd, 4) != 0) {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+void close_handles(const std::vector<int>& handles) {
+    for (int handle : handles) {
+        ::close(handle);
+    }
+}
+
+std::string op_line(const char* op) {
+    return json{{"op", op}}.dump();
+}
+
+}  // namespace
+
+HotRestart::~HotRestart() {
+    stop();
+}
+
+void HotRestart::configure(const HotRestartConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+}
+
+bool HotRestart::enabled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return config_.enabled;
+}
+
+bool HotRestart::take_over(ListenerConfig& rest_api, ListenerConfig& websocket) {
+    HotRestartConfig config;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config = config_;
+    }
+    if (!config.enabled) {
+        return false;
+    }
+    int fd = connect_unix(config.socket_path);
+    if (fd < 0) {
+        log_info("Hot restart: no running instance on " + config.socket_path + ", starting cold");
+        return false;
+    }
+
+    LineChannel channel(fd);
+    channel.set_timeout(config.handoff_timeout);
+    std::vector<int> handles;
+    json line;
+    size_t rest_api_count = 0;
+    uint64_t next_sequence = 0;
+    std::vector<Event> events;
+    std::vector<std::string> state_frames;
+    std::vector<std::string> base_frames;
+    bool complete = false;
+    try {
+        if (channel.send_line(op_line("handoff")) && channel.read_line(line, &handles) &&
+            line.value("op", "") == "listeners") {
+            rest_api_count = line.value("rest_api", size_t{0});
+            size_t websocket_count = line.value("websocket", size_t{0});
+            next_sequence = line.value("next_sequence", uint64_t{0});
+            if (rest_api_count > 0 && websocket_count > 0 &&
+                handles.size() == rest_api_count + websocket_count) {
+                while (!complete && channel.read_line(line)) {
+                    auto op = line.value("op", "");
+                    if (op == "event") {
+                        events.push_back(event_from_queued_record(line.at("event")));
+                    } else if (op == "state") {
+                        state_frames.push_back(line.at("frame").get<std::string>());
+                    } else if (op == "base") {
+                        base_frames.push_back(line.at("frame").get<std::string>());
+                    } else if (op == "end") {
+                        complete = true;
+                    }
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        log_error("Hot restart: malformed handoff record: " + std::string(e.what()));
+        complete = false;
+    }
+    if (!complete) {
+        log_error("Hot restart: handoff from " + config.socket_path + " failed, starting cold");
+        close_handles(handles);
+        ::close(fd);
+        return false;
+    }
+
+    // Import before any server runs: nothing is published or broadcast yet
+    size_t event_count = events.size();
+    get_event_manager().import_events(std::move(events), next_sequence);
+
+    size_t restored_bases = 0;
+    for (const auto& frame : base_frames) {
+        try {
+            restored_bases += get_delta_encoder().restore(frame) ? 1 : 0;
+        } catch (const std::exception&) {
+        }
+    }
+
+    auto& state_store = get_state_store();
+    for (auto& frame : state_frames) {
+        json parsed = json::parse(frame, nullptr, false);
+        if (!parsed.is_object() || !parsed.contains("type") || !parsed["type"].is_string()) {
+            continue;
+        }
+        Event event;
+        event.type = parsed["type"].get<std::string>();
+        event.timestamp = parsed.value("timestamp", "");
+        event.sequence = parsed.value("sequence", uint64_t{0});
+        event.payload = std::move(parsed["payload"]);
+        state_store.update(event, std::allocate_shared<std::string>(RecyclingAllocator<std::string>(),
+                                                                     std::move(frame)));
+    }
+    state_store.commit();
+
+    rest_api.inherited_handles.assign(handles.begin(),
+                                      handles.begin() + static_cast<std::ptrdiff_t>(rest_api_count));
+    websocket.inherited_handles.assign(handles.begin() + static_cast<std::ptrdiff_t>(rest_api_count),
+                                       handles.end());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        predecessor_fd_ = fd;
+        started_sent_ = false;
+    }
+    // From the first broadcast on, including the imported events; sent once
+    // the predecessor has been told to drain
+    {
+        std::lock_guard<std::mutex> lock(mirror_mutex_);
+        mirrored_.clear();
+        mirroring_ = true;
+    }
+    get_event_manager().set_mirror([this](const Event& event) { mirror(event); });
+    log_info("Hot restart: took over " + std::to_string(handles.size()) + " listening sockets, " +
+             std::to_string(event_count) + " queued events, " +
+             std::to_string(state_frames.size()) + " state entries and " +
+             std::to_string(restored_bases) + " delta bases (next sequence " +
+             std::to_string(next_sequence) + ")");
+    return true;
+}
+
+void HotRestart::listen(std::function<void()> on_handed_over) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!config_.enabled || listen_thread_.joinable()) {
+        return;
+    }
+    int fd = listen_unix(config_.socket_path);
+    if (fd < 0) {
+        log_error("Hot restart: cannot listen on " + config_.socket_path + ": " +
+                  std::strerror(errno));
+        return;
+    }
+    listen_fd_ = fd;
+    log_info("Hot restart: listening for a successor on " + config_.socket_path);
+
+    listen_thread_ = std::thread([this, fd, on_handed_over = std::move(on_handed_over)]() {
+        while (!stopping_) {
+            int connection = ::accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (connection < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                break;
+            }
+            bool handed_over = hand_over(connection);
+            ::close(connection);
+            if (handed_over) {
+                log_info("Hot restart: handed over and drained, exiting");
+                on_handed_over();
+                break;
+            }
+        }
+    });
+}
+
+void HotRestart::attach_rest_api(RestApiServer* server) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rest_api_ = server;
+    notify_started_locked();
+}
+
+void HotRestart::attach_websocket(std::shared_ptr<WebSocketServer> server) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    websocket_ = std::move(server);
+    notify_started_locked();
+}
+
+void HotRestart::stop() {
+    stopping_ = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (listen_fd_ >= 0) {
+            ::shutdown(listen_fd_, SHUT_RDWR);
+        }
+        if (predecessor_fd_ >= 0) {
+            ::shutdown(predecessor_fd_, SHUT_RDWR);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(forward_mutex_);
+        forward_ready_.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mirror_mutex_);
+        mirroring_ = false;
+        mirror_ready_.notify_all();
+    }
+    if (listen_thread_.joinable()) {
+        listen_thread_.join();
+    }
+    if (predecessor_thread_.joinable()) {
+        predecessor_thread_.join();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+}
+
+void HotRestart::notify_started_locked() {
+    if (predecessor_fd_ < 0 || started_sent_ || rest_api_ == nullptr || !websocket_) {
+        return;
+    }
+    started_sent_ = true;
+    if (!LineChannel(predecessor_fd_).send_line(op_line("started"))) {
+        log_error("Hot restart: predecessor went away before the servers started");
+    }
+    // receive_forwarded joins the mirror thread, so that one starts first
+    mirror_thread_ = std::thread(&HotRestart::send_mirrored, this, predecessor_fd_);
+    predecessor_thread_ = std::thread(&HotRestart::receive_forwarded, this, predecessor_fd_);
+}
+
+void HotRestart::receive_forwarded(int fd) {
+    // The predecessor sends nothing between "end" and our "started", so no
+    // buffered bytes were left behind by take_over
+    LineChannel channel(fd);
+    channel.set_timeout(std::chrono::milliseconds(0));
+    size_t forwarded = 0;
+    json line;
+    while (channel.read_line(line)) {
+        if (line.value("op", "") != "event") {
+            continue;
+        }
+        // Every forwarded event is answered, in order, so that the predecessor
+        // can match the answers to the publishes waiting for them
+        uint64_t sequence = 0;
+        try {
+            if (get_event_manager().publish_event(event_from_queued_record(line.at("event")),
+                                                  &sequence) == PublishResult::rejected) {
+                sequence = 0;
+            }
+            forwarded++;
+        } catch (const std::exception& e) {
+            log_error("Hot restart: dropping malformed forwarded event: " + std::string(e.what()));
+        }
+        json answer = sequence != 0 ? json{{"op", "queued"}, {"sequence", sequence}}
+                                    : json{{"op", "rejected"}};
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        channel.send_line(answer.dump());
+    }
+    log_info("Hot restart: predecessor finished draining (" + std::to_string(forwarded) +
+             " forwarded events)");
+    get_event_manager().set_mirror(nullptr);
+    {
+        std::lock_guard<std::mutex> lock(mirror_mutex_);
+        mirroring_ = false;
+        mirrored_.clear();
+        mirror_ready_.notify_all();
+    }
+    mirror_thread_.join();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ::close(fd);
+    predecessor_fd_ = -1;
+}
+
+void HotRestart::send_mirrored(int fd) {
+    LineChannel channel(fd);
+    std::unique_lock<std::mutex> lock(mirror_mutex_);
+    while (mirroring_) {
+        mirror_ready_.wait(lock, [this]() { return !mirroring_ || !mirrored_.empty(); });
+        std::vector<Event> batch;
+        batch.swap(mirrored_);
+        lock.unlock();
+        bool sent = true;
+        {
+            std::lock_guard<std::mutex> send_lock(send_mutex_);
+            for (const auto& event : batch) {
+                sent = sent && channel.send_line(
+                    json{{"op", "event"}, {"event", queued_event_record(event)}}.dump());
+            }
+        }
+        lock.lock();
+        if (!sent) {
+            mirroring_ = false;
+        }
+    }
+    mirrored_.clear();
+}
+
+void HotRestart::mirror(const Event& event) {
+    std::lock_guard<std::mutex> lock(mirror_mutex_);
+    if (!mirroring_) {
+        return;
+    }
+    mirrored_.push_back(event);
+    mirror_ready_.notify_all();
+}
+
+bool HotRestart::forward(Event event, EventManager::ForwardCallback on_answer) {
+    // Runs on the publishing I/O thread: queue it for hand_over and return
+    std::lock_guard<std::mutex> lock(forward_mutex_);
+    if (forward_failed_) {
+        return false;
+    }
+    forwarded_.push_back(ForwardedEvent{std::move(event), std::move(on_answer)});
+    forward_ready_.notify_all();
+    return true;
+}
+
+void HotRestart::fail_forwarded() {
+    std::vector<EventManager::ForwardCallback> failed;
+    {
+        std::lock_guard<std::mutex> lock(forward_mutex_);
+        forward_failed_ = true;
+        for (auto& on_answer : awaiting_reply_) {
+            failed.push_back(std::move(on_answer));
+        }
+        awaiting_reply_.clear();
+        for (auto& item : forwarded_) {
+            failed.push_back(std::move(item.on_answer));
+        }
+        forwarded_.clear();
+        forward_ready_.notify_all();
+    }
+    for (auto& on_answer : failed) {
+        on_answer(PublishResult::rejected, 0);
+    }
+}
+
+bool HotRestart::hand_over(int fd) {
+    LineChannel channel(fd);
+    HotRestartConfig config;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config = config_;
+    }
+    channel.set_timeout(config.handoff_timeout);
+    json line;
+    if (!channel.read_line(line) || line.value("op", "") != "handoff") {
+        return false;
+    }
+    std::shared_ptr<WebSocketServer> websocket;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (rest_api_ == nullptr || !websocket_) {
+            log_warn("Hot restart: successor connected before the servers were up; ignored");
+            return false;
+        }
+        websocket = websocket_;
+    }
+    log_info("Hot restart: successor connected, handing over");
+
+    {
+        std::lock_guard<std::mutex> forward_lock(forward_mutex_);
+        forwarded_.clear();
+        awaiting_reply_.clear();
+        forward_failed_ = false;
+        drained_ = false;
+    }
+    // Export between broadcast batches on the server thread: nothing is queued
+    // afterwards, so the state store and delta bases stay as they are, and the
+    // server thread is not stuck in a forwarded publish of its own (answers
+    // only come once the successor has started)
+    struct Export {
+        std::mutex mutex;
+        bool abandoned = false;
+        std::vector<Event> events;
+        uint64_t next_sequence = 0;
+        std::promise<void> done;
+    };
+    auto exported = std::make_shared<Export>();
+    auto export_done = exported->done.get_future();
+    websocket->post_between_batches([this, exported]() {
+        std::lock_guard<std::mutex> export_lock(exported->mutex);
+        if (exported->abandoned) {
+            return;
+        }
+        exported->events = get_event_manager().export_events(
+            [this](Event event, EventManager::ForwardCallback on_answer) {
+                return forward(std::move(event), std::move(on_answer));
+            },
+            exported->next_sequence);
+        exported->done.set_value();
+    });
+    if (export_done.wait_for(config.handoff_timeout) != std::future_status::ready) {
+        std::lock_guard<std::mutex> export_lock(exported->mutex);
+        if (export_done.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            exported->abandoned = true;
+            log_error("Hot restart: server thread did not reach a batch boundary; not handing over");
+            return false;
+        }
+    }
+    auto& events = exported->events;
+    uint64_t next_sequence = exported->next_sequence;
+
+    // rest_api_ is only valid while attached, so mutex_ covers each use of it
+    std::vector<int> handles;
+    bool attached = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (rest_api_ != nullptr) {
+            handles = rest_api_->listening_handles();
+            attached = true;
+        }
+    }
+    size_t rest_api_count = handles.size();
+    auto websocket_handles = websocket->listening_handles();
+    handles.insert(handles.end(), websocket_handles.begin(), websocket_handles.end());
+    json header = {
+        {"op", "listeners"},
+        {"rest_api", rest_api_count},
+        {"websocket", websocket_handles.size()},
+        {"next_sequence", next_sequence}
+    };
+    bool ok = attached && channel.send_line(header.dump(), handles);
+    for (const auto& event : events) {
+        ok = ok && channel.send_line(
+            json{{"op", "event"}, {"event", queued_event_record(event)}}.dump());
+    }
+    auto state = get_state_store().snapshot();
+    for (const auto& [type, type_state] : state->types) {
+        type_state->for_each_frame([&](const SharedFrame& frame) {
+            ok = ok && channel.send_line(json{{"op", "state"}, {"frame", *frame}}.dump());
+        });
+    }
+    for (const auto& frame : get_delta_encoder().snapshot_frames()) {
+        ok = ok && channel.send_line(json{{"op", "base"}, {"frame", *frame}}.dump());
+    }
+    ok = ok && channel.send_line(op_line("end"));
+    // The successor imports, then starts its servers
+    ok = ok && channel.read_line(line) && line.value("op", "") == "started";
+
+    if (!ok) {
+        log_error("Hot restart: successor did not take over; keeping the listeners and queued events");
+        // Ends forwarding first, so nothing is appended to forwarded_ afterwards
+        get_event_manager().import_events(std::move(events), next_sequence);
+        std::vector<ForwardedEvent> forwarded;
+        {
+            std::lock_guard<std::mutex> forward_lock(forward_mutex_);
+            forwarded.swap(forwarded_);
+        }
+        for (auto& item : forwarded) {
+            uint64_t sequence = 0;
+            auto result = get_event_manager().publish_event(std::move(item.event), &sequence);
+            item.on_answer(result, result == PublishResult::rejected ? 0 : sequence);
+        }
+        return false;
+    }
+
+    log_info("Hot restart: successor is accepting; closing listeners and draining clients");
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (rest_api_ != nullptr) {
+            rest_api_->stop_accepting();
+        }
+    }
+    websocket->stop_accepting();
+    websocket->drain_for_restart(config.drain_window, config.reconnect_jitter, [this]() {
+        std::lock_guard<std::mutex> forward_lock(forward_mutex_);
+        drained_ = true;
+        forward_ready_.notify_all();
+    });
+
+    // The successor answers forwarded events and sends back what it
+    // broadcasts, for the clients still connected here
+    channel.set_timeout(std::chrono::milliseconds(0));
+    std::thread successor_reader([this, &channel]() {
+        json answer;
+        while (channel.read_line(answer)) {
+            auto op = answer.value("op", "");
+            if (op == "event") {
+                try {
+                    get_event_manager().mirror_event(event_from_queued_record(answer.at("event")));
+                } catch (const std::exception& e) {
+                    log_error("Hot restart: dropping malformed mirrored event: " + std::string(e.what()));
+                }
+                continue;
+            }
+            if (op != "queued" && op != "rejected") {
+                continue;
+            }
+            EventManager::ForwardCallback on_answer;
+            {
+                std::lock_guard<std::mutex> forward_lock(forward_mutex_);
+                if (awaiting_reply_.empty()) {
+                    continue;
+                }
+                on_answer = std::move(awaiting_reply_.front());
+                awaiting_reply_.pop_front();
+                forward_ready_.notify_all();
+            }
+            if (op == "queued") {
+                on_answer(PublishResult::queued, answer.value("sequence", uint64_t{0}));
+            } else {
+                on_answer(PublishResult::rejected, 0);
+            }
+        }
+        fail_forwarded();
+    });
+
+    // Forward what is still published here (in-flight requests, draining
+    // clients) until the drain completes
+    std::unique_lock<std::mutex> forward_lock(forward_mutex_);
+    while (true) {
+        forward_ready_.wait(forward_lock, [this]() {
+            return drained_ || stopping_ || !forwarded_.empty();
+        });
+        std::vector<ForwardedEvent> batch;
+        batch.swap(forwarded_);
+        for (auto& item : batch) {
+            awaiting_reply_.push_back(std::move(item.on_answer));
+        }
+        bool done = drained_ || stopping_;
+        forward_lock.unlock();
+        bool sent = true;
+        for (const auto& item : batch) {
+            sent = sent && channel.send_line(
+                json{{"op", "event"}, {"event", queued_event_record(item.event)}}.dump());
+        }
+        if (!sent) {
+            log_error("Hot restart: lost the successor while forwarding; rejecting further events");
+            fail_forwarded();
+        }
+        forward_lock.lock();
+        if (done && forwarded_.empty()) {
+            break;
+        }
+    }
+    // Publishes from here on are rejected; clients retry against the successor.
+    // The last answers are awaited before the connection closes.
+    forward_failed_ = true;
+    forward_ready_.wait_for(forward_lock, config.handoff_timeout,
+                            [this]() { return awaiting_reply_.empty(); });
+    forward_lock.unlock();
+    ::shutdown(fd, SHUT_RDWR);
+    successor_reader.join();
+    return true;
+}
+
+#else
+
+HotRestart::~HotRestart() = default;
+
+void HotRestart::configure(const HotRestartConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+}
+
+bool HotRestart::enabled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return config_.enabled;
+}
+
+bool HotRestart::take_over(ListenerConfig&, ListenerConfig&) {
+    if (enabled()) {
+        log_warn("Hot restart is only supported on Linux; starting cold");
+    }
+    return false;
+}
+
+void HotRestart::listen(std::function<void()>) {}
+
+void HotRestart::attach_rest_api(RestApiServer* server) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rest_api_ = server;
+}
+
+void HotRestart::attach_websocket(std::shared_ptr<WebSocketServer> server) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    websocket_ = std::move(server);
+}
+
+void HotRestart::stop() {}
+
+#endif
+
+HotRestart& get_hot_restart() {
+    static HotRestart instance;
+    return instance;
+}
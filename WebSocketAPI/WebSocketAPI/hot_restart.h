@@ -0,0 +1,141 @@
+﻿#pragma once
+
+#include "common.h"
+#include "event_manager.h"
+#include "listener.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class RestApiServer;
+class WebSocketServer;
+
+/**
+ * Zero-downtime restart by listening socket handoff
+ */
+struct HotRestartConfig {
+    bool enabled = false;
+    std::string socket_path = "websocketapi.sock";     // Unix domain socket of the running process
+    std::chrono::milliseconds handoff_timeout{5000};   // Per step of the handoff
+    std::chrono::milliseconds drain_window{10000};     // Old WebSocket clients are closed across this window
+    std::chrono::milliseconds reconnect_jitter{5000};  // Upper bound of each client's retry_after_ms
+};
+
+/**
+ * Hands the listening sockets, queued events and broadcast state of a running
+ * process to its replacement (Linux only)
+ *
+ * A process started with hot restart enabled first connects to socket_path.
+ * If an older process answers, the handoff runs as
+ *   1. new -> old  {"op": "handoff"}
+ *   2. old exports its queued events (EventManager::export_events; later
+ *      publishes are forwarded from then on) and, between broadcast
+ *      batches, its StateStore entries and delta bases
+ *   3. old -> new  {"op": "listeners", "rest_api": N, "websocket": M, "next_sequence": S}
+ *      with the N + M listening sockets attached (SCM_RIGHTS), then one
+ *      {"op": "event" | "state" | "base", ...} line per item and {"op": "end"}
+ *   4. new imports everything, starts its servers on the inherited sockets
+ *      and answers {"op": "started"}
+ *   5. old stops accepting and closes its WebSocket clients across
+ *      drain_window with 1012 (Service Restart) and a random retry_after_ms,
+ *      forwarding whatever is published to it meanwhile as {"op": "event"}
+ *      lines, then closes the connection and exits. new answers each with
+ *      {"op": "queued", "sequence": N} or {"op": "rejected"}, which is what
+ *      the publish at old reports, and sends every event it broadcasts back
+ *      as {"op": "event"} for old to broadcast to the clients still draining
+ * Both processes accept on the same sockets between steps 4 and 5, so no
+ * connection is refused or left waiting. If step 4 does not arrive in time
+ * the old process takes its events back and carries on.
+ * Every enabled process then listens on socket_path for its own successor.
+ */
+class HotRestart {
+public:
+    HotRestart() = default;
+    ~HotRestart();
+
+    HotRestart(const HotRestart&) = delete;
+    HotRestart& operator=(const HotRestart&) = delete;
+
+    void configure(const HotRestartConfig& config);
+    bool enabled() const;
+
+    /**
+     * Incoming side, before the servers are created: take over from the
+     * process listening on socket_path, if there is one
+     * Imports its events and state, and sets inherited_handles on both listeners.
+     * @return true if a predecessor handed over
+     */
+    bool take_over(ListenerConfig& rest_api, ListenerConfig& websocket);
+
+    /**
+     * Listen on socket_path for a successor
+     * @param on_handed_over Called once this process has handed over and drained
+     */
+    void listen(std::function<void()> on_handed_over);
+
+    /**
+     * Servers to hand over, set by the server threads once they accept and
+     * cleared (nullptr) before the servers are destroyed. Once both are set
+     * after a take_over, the predecessor is told to drain.
+     */
+    void attach_rest_api(RestApiServer* server);
+    void attach_websocket(std::shared_ptr<WebSocketServer> server);
+
+    /**
+     * Close the handoff sockets and join the handoff threads
+     */
+    void stop();
+
+private:
+    mutable std::mutex mutex_;  // Config, attached servers and descriptors
+    HotRestartConfig config_;
+    RestApiServer* rest_api_ = nullptr;
+    std::shared_ptr<WebSocketServer> websocket_;
+    int listen_fd_ = -1;
+    int predecessor_fd_ = -1;   // Open from take_over until the predecessor exits
+    bool started_sent_ = false;
+    std::thread listen_thread_;
+    std::thread predecessor_thread_;
+    std::atomic<bool> stopping_{false};
+
+    // Outgoing side: publishes forwarded to the successor during the drain,
+    // each answered through its callback once the successor replies
+    struct ForwardedEvent {
+        Event event;
+        EventManager::ForwardCallback on_answer;
+    };
+    std::mutex forward_mutex_;
+    std::condition_variable forward_ready_;
+    std::vector<ForwardedEvent> forwarded_;
+    std::deque<EventManager::ForwardCallback> awaiting_reply_;  // Sent, in send order
+    bool forward_failed_ = false;
+    bool drained_ = false;
+
+    // Incoming side: broadcast events sent back to the draining predecessor
+    std::mutex mirror_mutex_;
+    std::condition_variable mirror_ready_;
+    std::vector<Event> mirrored_;
+    bool mirroring_ = false;
+    std::thread mirror_thread_;
+    std::mutex send_mutex_;  // Replies and mirrored events share the socket
+
+    void notify_started_locked();
+    void receive_forwarded(int fd);
+    void send_mirrored(int fd);
+    void mirror(const Event& event);
+    bool hand_over(int fd);
+    bool forward(Event event, EventManager::ForwardCallback on_answer);
+    void fail_forwarded();
+};
+
+/**
+ * Get global hot restart instance
+ */
+HotRestart& get_hot_restart();
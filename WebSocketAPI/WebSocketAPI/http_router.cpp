@@ -0,0 +1,183 @@
+﻿#include "http_router.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Path part of a target without its trailing slash ("/" becomes ""), or
+// nullopt if it is not an absolute path
+std::optional<std::string_view> normalized_path(std::string_view path) {
+    if (path.empty() || path.front() != '/') {
+        return std::nullopt;
+    }
+    if (path.back() == '/') {
+        path.remove_suffix(1);
+    }
+    return path;
+}
+
+}  // namespace
+
+HttpMethod parse_http_method(std::string_view method) {
+    static constexpr std::array<std::pair<std::string_view, HttpMethod>, HTTP_METHOD_COUNT> methods{{
+        {"GET", HttpMethod::get},
+        {"HEAD", HttpMethod::head},
+        {"POST", HttpMethod::post},
+        {"PUT", HttpMethod::put},
+        {"PATCH", HttpMethod::patch},
+        {"DELETE", HttpMethod::del},
+        {"OPTIONS", HttpMethod::options}
+    }};
+    for (const auto& [name, value] : methods) {
+        if (method == name) {
+            return value;
+        }
+    }
+    return HttpMethod::unknown;
+}
+
+// RouteParams implementation
+
+std::optional<std::string_view> RouteParams::path(std::string_view name) const {
+    for (size_t i = 0; i < path_count_; i++) {
+        if (path_[i].first == name) {
+            return path_[i].second;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<std::string_view> RouteParams::query(std::string_view name) const {
+    std::string_view rest = query_;
+    while (!rest.empty()) {
+        size_t end = rest.find('&');
+        std::string_view pair = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+
+        size_t equals = pair.find('=');
+        if (pair.substr(0, equals) == name) {
+            return equals == std::string_view::npos ? std::string_view() : pair.substr(equals + 1);
+        }
+    }
+    return std::nullopt;
+}
+
+// HttpRouter implementation
+
+struct HttpRouter::Node {
+    std::vector<std::pair<std::string, std::unique_ptr<Node>>> children;  // Literal segments, sorted
+    std::unique_ptr<Node> param_child;
+    std::string param_name;
+    std::array<size_t, HTTP_METHOD_COUNT> routes;
+
+    Node() { routes.fill(NO_ROUTE); }
+
+    std::vector<std::pair<std::string, std::unique_ptr<Node>>>::const_iterator
+    find_child(std::string_view segment) const {
+        auto it = std::lower_bound(children.begin(), children.end(), segment,
+                                   [](const auto& child, std::string_view key) { return child.first < key; });
+        return it != children.end() && it->first == segment ? it : children.end();
+    }
+};
+
+HttpRouter::HttpRouter() : root_(std::make_unique<Node>()) {}
+
+HttpRouter::~HttpRouter() = default;
+
+HttpRouter::HttpRouter(HttpRouter&&) noexcept = default;
+
+HttpRouter& HttpRouter::operator=(HttpRouter&&) noexcept = default;
+
+size_t HttpRouter::add(HttpMethod method, std::string_view pattern) {
+    auto m = static_cast<size_t>(method);
+    auto path = normalized_path(pattern);
+    if (m >= HTTP_METHOD_COUNT || !path || path->find('?') != std::string_view::npos) {
+        throw std::invalid_argument("invalid route: " + std::string(pattern));
+    }
+
+    Node* node = root_.get();
+    size_t param_count = 0;
+    std::string_view rest = *path;
+    while (!rest.empty()) {
+        rest.remove_prefix(1);
+        size_t end = rest.find('/');
+        std::string_view segment = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view() : rest.substr(end);
+
+        if (segment.size() >= 2 && segment.front() == '{' && segment.back() == '}') {
+            std::string_view name = segment.substr(1, segment.size() - 2);
+            if (name.empty() || ++param_count > RouteParams::MAX_PATH_PARAMS) {
+                throw std::invalid_argument("invalid route parameter in " + std::string(pattern));
+            }
+            if (!node->param_child) {
+                node->param_child = std::make_unique<Node>();
+                node->param_name = std::string(name);
+            } else if (node->param_name != name) {
+                throw std::invalid_argument("route " + std::string(pattern) + " renames parameter {" +
+                                            node->param_name + "}");
+            }
+            node = node->param_child.get();
+            continue;
+        }
+
+        if (segment.empty() || segment.find_first_of("{}") != std::string_view::npos) {
+            throw std::invalid_argument("invalid route segment in " + std::string(pattern));
+        }
+        auto it = std::lower_bound(node->children.begin(), node->children.end(), segment,
+                                   [](const auto& child, std::string_view key) { return child.first < key; });
+        if (it == node->children.end() || it->first != segment) {
+            it = node->children.emplace(it, std::string(segment), std::make_unique<Node>());
+        }
+        node = it->second.get();
+    }
+
+    if (node->routes[m] != NO_ROUTE) {
+        throw std::invalid_argument("duplicate route: " + std::string(pattern));
+    }
+    node->routes[m] = route_count_;
+    return route_count_++;
+}
+
+size_t HttpRouter::find(HttpMethod method, std::string_view target, RouteParams& out_params) const {
+    out_params.path_count_ = 0;
+    size_t query_start = target.find('?');
+    out_params.query_ = query_start == std::string_view::npos ? std::string_view()
+                                                              : target.substr(query_start + 1);
+
+    auto m = static_cast<size_t>(method);
+    auto path = normalized_path(target.substr(0, query_start));
+    if (m >= HTTP_METHOD_COUNT || !path) {
+        return NO_ROUTE;
+    }
+    return match(*root_, *path, m, out_params);
+}
+
+size_t HttpRouter::match(const Node& node, std::string_view rest, size_t method, RouteParams& params) {
+    if (rest.empty()) {
+        return node.routes[method];
+    }
+    rest.remove_prefix(1);
+    size_t end = rest.find('/');
+    std::string_view segment = rest.substr(0, end);
+    rest = end == std::string_view::npos ? std::string_view() : rest.substr(end);
+
+    // Literal first; fall back to the parameter if that branch has no route
+    auto child = node.find_child(segment);
+    if (child != node.children.end()) {
+        size_t route = match(*child->second, rest, method, params);
+        if (route != NO_ROUTE) {
+            return route;
+        }
+    }
+    if (node.param_child && !segment.empty()) {
+        size_t count = params.path_count_;
+        params.path_[count] = {node.param_name, segment};
+        params.path_count_ = count + 1;
+        size_t route = match(*node.param_child, rest, method, params);
+        if (route != NO_ROUTE) {
+            return route;
+        }
+        params.path_count_ = count;
+    }
+    return NO_ROUTE;
+}
@@ -0,0 +1,152 @@
+﻿#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+enum class HttpMethod {
+    get = 0,
+    head,
+    post,
+    put,
+    patch,
+    del,
+    options,
+    unknown
+};
+
+constexpr size_t HTTP_METHOD_COUNT = 7;  // Routable methods, excluding unknown
+
+HttpMethod parse_http_method(std::string_view method);
+
+/**
+ * Parameter text as a typed value: string_view as is, bool as true/false/1/0,
+ * integers and floating point with from_chars (the whole text must parse)
+ * @return nullopt if the text is not a valid T
+ */
+template <typename T>
+std::optional<T> parse_route_param(std::string_view text) {
+    if constexpr (std::is_same_v<T, std::string_view>) {
+        return text;
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        return std::string(text);
+    } else if constexpr (std::is_same_v<T, bool>) {
+        if (text == "true" || text == "1") {
+            return true;
+        }
+        if (text == "false" || text == "0") {
+            return false;
+        }
+        return std::nullopt;
+    } else {
+        static_assert(std::is_arithmetic_v<T>, "route parameters parse to strings, bool or numbers");
+        T value{};
+        auto parsed = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (text.empty() || parsed.ec != std::errc() || parsed.ptr != text.data() + text.size()) {
+            return std::nullopt;
+        }
+        return value;
+    }
+}
+
+/**
+ * Path and query parameters of a matched request
+ * Views into the request target: no copies, no allocation, and no
+ * percent-decoding. Valid only while the target is.
+ */
+class RouteParams {
+public:
+    static constexpr size_t MAX_PATH_PARAMS = 8;
+
+    /**
+     * Value of the {name} path segment, or nullopt if the route has none
+     */
+    std::optional<std::string_view> path(std::string_view name) const;
+
+    /**
+     * Value of name in the query string ("a=1&b" gives "1" for a and "" for b)
+     * The first occurrence wins; nullopt if absent.
+     */
+    std::optional<std::string_view> query(std::string_view name) const;
+
+    template <typename T>
+    std::optional<T> path_as(std::string_view name) const {
+        auto text = path(name);
+        return text ? parse_route_param<T>(*text) : std::nullopt;
+    }
+
+    template <typename T>
+    std::optional<T> query_as(std::string_view name) const {
+        auto text = query(name);
+        return text ? parse_route_param<T>(*text) : std::nullopt;
+    }
+
+    std::string_view query_string() const { return query_; }
+    size_t path_count() const { return path_count_; }
+
+private:
+    friend class HttpRouter;
+
+    std::array<std::pair<std::string_view, std::string_view>, MAX_PATH_PARAMS> path_{};
+    size_t path_count_ = 0;
+    std::string_view query_;
+};
+
+/**
+ * Route table built once at startup: a trie keyed on path segments with a
+ * route id per method at each node
+ *
+ * Patterns are absolute paths whose segments are literals or {name}
+ * parameters, e.g. "/api/state/{type}". A literal segment wins over a
+ * parameter at the same position. Lookup walks one node per segment, with a
+ * binary search among the literal children, so its cost depends on the
+ * depth of the path and not on the number of routes, and it does not
+ * allocate. A trailing slash is ignored and the query string is left to
+ * RouteParams. Not safe to add routes while looking up.
+ */
+class HttpRouter {
+public:
+    static constexpr size_t NO_ROUTE = SIZE_MAX;
+
+    HttpRouter();
+    ~HttpRouter();
+
+    HttpRouter(const HttpRouter&) = delete;
+    HttpRouter& operator=(const HttpRouter&) = delete;
+    HttpRouter(HttpRouter&&) noexcept;
+    HttpRouter& operator=(HttpRouter&&) noexcept;
+
+    /**
+     * Register a route
+     * @return Route id: 0 for the first route added, then 1, 2, ...
+     * @throws std::invalid_argument on a malformed pattern, too many parameters,
+     *         a parameter named differently from one already at that position,
+     *         or a method and pattern that are already registered
+     */
+    size_t add(HttpMethod method, std::string_view pattern);
+
+    /**
+     * Route id for a request, or NO_ROUTE
+     * @param target Request target, path and optional query string
+     * @param out_params Receives the path parameters and the query string
+     */
+    size_t find(HttpMethod method, std::string_view target, RouteParams& out_params) const;
+
+    size_t size() const { return route_count_; }
+
+private:
+    struct Node;
+
+    std::unique_ptr<Node> root_;
+    size_t route_count_ = 0;
+
+    // rest is empty at the node itself, otherwise "/segment..."
+    static size_t match(const Node& node, std::string_view rest, size_t method, RouteParams& params);
+};
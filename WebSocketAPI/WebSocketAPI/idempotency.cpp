@@ -0,0 +1,181 @@
+﻿#include "idempotency.h"
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace {
+
+int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+// IdempotencyIndex implementation
+
+IdempotencyIndex::IdempotencyIndex() {
+    configure(IdempotencyConfig{});
+}
+
+void IdempotencyIndex::configure(const IdempotencyConfig& config) {
+    ttl_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(config.ttl).count();
+    shard_budget_bytes_ = config.memory_budget_bytes / SHARD_COUNT;
+    max_key_length_ = config.max_key_length;
+    enabled_ = config.enabled && config.ttl.count() > 0 && config.memory_budget_bytes > 0;
+}
+
+bool IdempotencyIndex::enabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+}
+
+size_t IdempotencyIndex::max_key_length() const {
+    return max_key_length_.load(std::memory_order_relaxed);
+}
+
+IdempotencyResult IdempotencyIndex::begin(std::string_view key, IdempotentResponse& out_response) {
+    int64_t now_ns = steady_now_ns();
+    auto& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto found = shard.index.find(key);
+    if (found != shard.index.end()) {
+        auto it = found->second;
+        if (it->expires_ns > now_ns) {
+            if (it->pending) {
+                in_progress_.fetch_add(1, std::memory_order_relaxed);
+                return IdempotencyResult::in_progress;
+            }
+            shard.lru.splice(shard.lru.end(), shard.lru, it);
+            out_response = it->response;
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return IdempotencyResult::duplicate;
+        }
+        expired_.fetch_add(1, std::memory_order_relaxed);
+        erase_locked(shard, it);
+    }
+
+    // Node, map entry and bucket; the response strings are added by complete()
+    size_t bytes = sizeof(Entry) + 2 * sizeof(void*) +
+                   sizeof(std::pair<const std::string_view, std::list<Entry>::iterator>) +
+                   3 * sizeof(void*) + key.size();
+    make_room_locked(shard, bytes, now_ns);
+
+    Entry entry;
+    entry.key = std::string(key);
+    entry.expires_ns = now_ns + ttl_ns_.load(std::memory_order_relaxed);
+    entry.bytes = bytes;
+    shard.lru.push_back(std::move(entry));
+    auto it = std::prev(shard.lru.end());
+    shard.index.emplace(std::string_view(it->key), it);
+    shard.bytes += bytes;
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return IdempotencyResult::first;
+}
+
+void IdempotencyIndex::complete(std::string_view key, IdempotentResponse response) {
+    int64_t now_ns = steady_now_ns();
+    auto& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // Gone if it was evicted while publishing; the next retry then publishes again
+    auto found = shard.index.find(key);
+    if (found == shard.index.end()) {
+        return;
+    }
+    auto it = found->second;
+    size_t response_bytes = response.event_type.size() + response.timestamp.size();
+    it->pending = false;
+    it->expires_ns = now_ns + ttl_ns_.load(std::memory_order_relaxed);
+    it->response = std::move(response);
+    it->bytes += response_bytes;
+    shard.bytes += response_bytes;
+    shard.lru.splice(shard.lru.end(), shard.lru, it);
+}
+
+void IdempotencyIndex::abandon(std::string_view key) {
+    auto& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(key);
+    if (found != shard.index.end() && found->second->pending) {
+        erase_locked(shard, found->second);
+    }
+}
+
+IdempotencyIndex::Stats IdempotencyIndex::get_stats() const {
+    Stats stats{};
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    stats.in_progress = in_progress_.load(std::memory_order_relaxed);
+    stats.evicted = evicted_.load(std::memory_order_relaxed);
+    stats.expired = expired_.load(std::memory_order_relaxed);
+    stats.memory_budget_bytes = shard_budget_bytes_.load(std::memory_order_relaxed) * SHARD_COUNT;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.entries += shard.lru.size();
+        stats.memory_bytes += shard.bytes;
+    }
+    return stats;
+}
+
+IdempotencyIndex::Shard& IdempotencyIndex::shard_for(std::string_view key) {
+    return shards_[std::hash<std::string_view>{}(key) % SHARD_COUNT];
+}
+
+void IdempotencyIndex::erase_locked(Shard& shard, std::list<Entry>::iterator it) {
+    shard.bytes -= it->bytes;
+    shard.index.erase(std::string_view(it->key));
+    shard.lru.erase(it);
+}
+
+void IdempotencyIndex::make_room_locked(Shard& shard, size_t bytes, int64_t now_ns) {
+    // Expired keys go first wherever they are at the front, then the least recently used
+    size_t budget = shard_budget_bytes_.load(std::memory_order_relaxed);
+    while (!shard.lru.empty()) {
+        auto oldest = shard.lru.begin();
+        if (oldest->expires_ns <= now_ns) {
+            expired_.fetch_add(1, std::memory_order_relaxed);
+        } else if (shard.bytes + bytes > budget) {
+            evicted_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            break;
+        }
+        erase_locked(shard, oldest);
+    }
+}
+
+// IdempotencyReservation implementation
+
+IdempotencyReservation::IdempotencyReservation(IdempotencyReservation&& other) noexcept
+    : key_(std::move(other.key_)), held_(std::exchange(other.held_, false)) {}
+
+IdempotencyReservation::~IdempotencyReservation() {
+    if (held_) {
+        get_idempotency_index().abandon(key_);
+    }
+}
+
+IdempotencyResult IdempotencyReservation::begin(std::string key, IdempotentResponse& out_response) {
+    if (key.empty()) {
+        return IdempotencyResult::first;
+    }
+    auto result = get_idempotency_index().begin(key, out_response);
+    if (result == IdempotencyResult::first) {
+        key_ = std::move(key);
+        held_ = true;
+    }
+    return result;
+}
+
+void IdempotencyReservation::complete(IdempotentResponse response) {
+    if (held_) {
+        get_idempotency_index().complete(key_, std::move(response));
+        held_ = false;
+    }
+}
+
+// Global idempotency index instance
+IdempotencyIndex& get_idempotency_index() {
+    static IdempotencyIndex instance;
+    return instance;
+}
@@ -0,0 +1,163 @@
+﻿#pragma once
+
+#include "common.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * Deduplication of retried publishes by Idempotency-Key
+ * Keys are compared as given, so producers should use globally unique
+ * values (UUIDs). A TTL or memory budget of 0 disables the index.
+ */
+struct IdempotencyConfig {
+    bool enabled = true;
+    std::chrono::seconds ttl{600};                // How long a key is remembered after its publish
+    size_t memory_budget_bytes = 16 * 1024 * 1024; // Least recently used keys are evicted beyond this
+    size_t max_key_length = 255;                  // Longer keys are rejected with 400
+};
+
+/**
+ * What a publish answered, kept so a retry gets the same reply
+ */
+struct IdempotentResponse {
+    std::string event_type;
+    EventPriority priority = EventPriority::normal;
+    std::string timestamp;
+    uint64_t sequence = 0;
+};
+
+enum class IdempotencyResult {
+    first,        // Not seen before: reserved, publish it
+    duplicate,    // Already published: reply with the original response
+    in_progress   // The original is still being published: retry later
+};
+
+/**
+ * Time-bounded, memory-capped set of recently published Idempotency-Keys
+ * Mutex-sharded hash maps, each with an exact LRU list for eviction. A key
+ * is reserved before its event reaches EventManager and completed with the
+ * response afterwards, so concurrent retries cannot both publish.
+ */
+class IdempotencyIndex {
+public:
+    struct Stats {
+        uint64_t hits;          // Duplicates answered from the index
+        uint64_t misses;        // First sightings
+        uint64_t in_progress;   // Retries that raced their original
+        uint64_t evicted;       // Dropped to stay within the memory budget
+        uint64_t expired;
+        size_t entries;
+        size_t memory_bytes;
+        size_t memory_budget_bytes;
+
+        double hit_rate() const {
+            return hits + misses ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+        }
+    };
+
+    IdempotencyIndex();
+
+    IdempotencyIndex(const IdempotencyIndex&) = delete;
+    IdempotencyIndex& operator=(const IdempotencyIndex&) = delete;
+
+    /**
+     * Apply new settings (safe while requests are being checked)
+     * A smaller budget takes effect as keys are added.
+     */
+    void configure(const IdempotencyConfig& config);
+
+    bool enabled() const;
+    size_t max_key_length() const;
+
+    /**
+     * Look the key up, reserving it when it is new
+     * @param out_response Receives the original response on duplicate
+     */
+    IdempotencyResult begin(std::string_view key, IdempotentResponse& out_response);
+
+    /**
+     * Store the response of a reserved key; its TTL starts now
+     */
+    void complete(std::string_view key, IdempotentResponse response);
+
+    /**
+     * Release a reserved key whose publish failed, so a retry can publish
+     */
+    void abandon(std::string_view key);
+
+    Stats get_stats() const;
+
+private:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct Entry {
+        std::string key;
+        int64_t expires_ns = 0;
+        bool pending = true;
+        size_t bytes = 0;
+        IdempotentResponse response;
+    };
+
+    // Most recently used at the back; the map keys view the key in the list node
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> lru;
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+        size_t bytes = 0;
+    };
+
+    std::atomic<bool> enabled_{false};
+    std::atomic<int64_t> ttl_ns_{0};
+    std::atomic<size_t> shard_budget_bytes_{0};
+    std::atomic<size_t> max_key_length_{0};
+
+    std::array<Shard, SHARD_COUNT> shards_;
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> in_progress_{0};
+    std::atomic<uint64_t> evicted_{0};
+    std::atomic<uint64_t> expired_{0};
+
+    Shard& shard_for(std::string_view key);
+    void erase_locked(Shard& shard, std::list<Entry>::iterator it);
+    void make_room_locked(Shard& shard, size_t bytes, int64_t now_ns);
+};
+
+/**
+ * Reservation of one key for the duration of a publish
+ * Abandons the key on destruction unless complete() was called, so every
+ * early return and exception releases it.
+ */
+class IdempotencyReservation {
+public:
+    IdempotencyReservation() = default;
+    IdempotencyReservation(IdempotencyReservation&& other) noexcept;
+    ~IdempotencyReservation();
+
+    IdempotencyReservation(const IdempotencyReservation&) = delete;
+    IdempotencyReservation& operator=(const IdempotencyReservation&) = delete;
+
+    /**
+     * IdempotencyIndex::begin, holding the key when it is new
+     * An empty key is no key: first, and nothing is reserved.
+     */
+    IdempotencyResult begin(std::string key, IdempotentResponse& out_response);
+    void complete(IdempotentResponse response);
+
+private:
+    std::string key_;
+    bool held_ = false;
+};
+
+/**
+ * Get global idempotency index instance
+ */
+IdempotencyIndex& get_idempotency_index();
@@ -0,0 +1,177 @@
+﻿#include "ingest_capture.h"
+#include "logger.h"
+#include <limits>
+
+namespace {
+
+// The writer is woken early once this much is buffered
+constexpr size_t WRITE_BATCH_BYTES = 1024 * 1024;
+
+template <typename Clock>
+uint64_t clock_ns(typename Clock::time_point time) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count());
+}
+
+}  // namespace
+
+// IngestCapture implementation
+
+IngestCapture::~IngestCapture() {
+    shutdown_writer();
+}
+
+void IngestCapture::configure(const IngestCaptureConfig& config) {
+    if (writer_.joinable() && config.enabled && config.path == config_.path) {
+        // Same file: only the limits change
+        std::lock_guard<std::mutex> lock(mutex_);
+        config_ = config;
+        return;
+    }
+
+    stop();
+    config_ = config;
+    if (!config.enabled) {
+        return;
+    }
+
+    file_.open(config.path, std::ios::binary | std::ios::trunc);
+    if (!file_) {
+        log_error("Cannot open ingest capture file " + config.path);
+        return;
+    }
+    start_ = std::chrono::steady_clock::now();
+    IngestCaptureHeader header{};
+    header.magic = INGEST_CAPTURE_MAGIC;
+    header.version = INGEST_CAPTURE_VERSION;
+    header.record_size = sizeof(IngestCaptureRecord);
+    header.steady_start_ns = clock_ns<std::chrono::steady_clock>(start_);
+    header.system_start_ns = clock_ns<std::chrono::system_clock>(std::chrono::system_clock::now());
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        file_bytes_ = sizeof(header);
+        stopping_ = false;
+    }
+    records_ = 0;
+    bytes_ = 0;
+    dropped_ = 0;
+    writer_ = std::thread(&IngestCapture::write_loop, this);
+    active_ = true;
+    log_info("Ingest capture started: " + config.path);
+}
+
+void IngestCapture::stop() {
+    if (shutdown_writer()) {
+        log_info("Ingest capture stopped: " + config_.path + " (records=" + std::to_string(records_) +
+                 ", bytes=" + std::to_string(bytes_) + ", dropped=" + std::to_string(dropped_) + ")");
+    }
+}
+
+bool IngestCapture::shutdown_writer() {
+    if (!writer_.joinable()) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        active_ = false;
+    }
+    wake_.notify_one();
+    writer_.join();
+    file_.close();
+    return true;
+}
+
+void IngestCapture::record(std::chrono::steady_clock::time_point arrival, std::string_view type,
+                           std::string_view body) {
+    if (!active()) {
+        return;
+    }
+    size_t size = sizeof(IngestCaptureRecord) + type.size() + body.size();
+    if (type.size() > std::numeric_limits<uint16_t>::max() ||
+        body.size() > std::numeric_limits<uint32_t>::max()) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+        if (config_.max_file_bytes > 0 && file_bytes_ + size > config_.max_file_bytes) {
+            if (active_.exchange(false)) {
+                log_warn("Ingest capture reached max_file_bytes, no longer recording: " + config_.path);
+            }
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (buffer_.size() + size > config_.buffer_bytes) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        IngestCaptureRecord header{};
+        header.arrival_ns = arrival > start_ ? static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(arrival - start_).count()) : 0;
+        header.body_size = static_cast<uint32_t>(body.size());
+        header.type_size = static_cast<uint16_t>(type.size());
+        buffer_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        buffer_.append(type);
+        buffer_.append(body);
+        file_bytes_ += size;
+        wake = buffer_.size() >= WRITE_BATCH_BYTES;
+    }
+    records_.fetch_add(1, std::memory_order_relaxed);
+    bytes_.fetch_add(size, std::memory_order_relaxed);
+    if (wake) {
+        wake_.notify_one();
+    }
+}
+
+IngestCapture::Stats IngestCapture::get_stats() const {
+    Stats stats{};
+    stats.active = active();
+    stats.records = records_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.buffered_bytes = buffer_.size();
+    return stats;
+}
+
+void IngestCapture::write_loop() {
+    // The two buffers trade places, so both keep their capacity
+    std::string writing;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait_for(lock, config_.flush_interval, [this]() {
+            return stopping_ || buffer_.size() >= WRITE_BATCH_BYTES;
+        });
+        writing.swap(buffer_);
+        bool stopping = stopping_;
+        lock.unlock();
+
+        if (!writing.empty()) {
+            file_.write(writing.data(), static_cast<std::streamsize>(writing.size()));
+            file_.flush();
+            writing.clear();
+            if (!file_ && active_.exchange(false)) {
+                log_error("Ingest capture write failed, no longer recording: " + config_.path);
+            }
+        }
+        if (stopping) {
+            return;
+        }
+        lock.lock();
+    }
+}
+
+// Global ingest capture instance
+IngestCapture& get_ingest_capture() {
+    static IngestCapture instance;
+    return instance;
+}
@@ -0,0 +1,123 @@
+﻿#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Capture file layout: IngestCaptureHeader, then per event an
+// IngestCaptureRecord followed by type_size bytes of type and body_size bytes
+// of the raw request body. Records are in write order, which can differ
+// slightly from arrival order across REST threads.
+constexpr uint32_t INGEST_CAPTURE_MAGIC = 0x43495357;  // "WSIC"
+constexpr uint32_t INGEST_CAPTURE_VERSION = 1;
+
+struct IngestCaptureHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t steady_start_ns;  // Clocks read when the capture started, to map
+    uint64_t system_start_ns;  // arrival offsets to wall-clock time
+};
+
+// One record header, 16 bytes; layout is part of the capture format
+struct IngestCaptureRecord {
+    uint64_t arrival_ns;  // Since steady_start_ns
+    uint32_t body_size;
+    uint16_t type_size;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(IngestCaptureRecord) == 16, "IngestCaptureRecord layout is part of the capture format");
+
+/**
+ * Recording of accepted POST /api/event requests, for replay with IngestReplay
+ * max_file_bytes of 0 is unlimited; capture stops once the file reaches it.
+ * Starting a capture truncates the file, so with hot restart the successor
+ * needs its own path.
+ */
+struct IngestCaptureConfig {
+    bool enabled = false;
+    std::string path = "ingest_capture.bin";
+    size_t max_file_bytes = 1024 * 1024 * 1024;
+    size_t buffer_bytes = 16 * 1024 * 1024;             // Records beyond this, unwritten, are dropped
+    std::chrono::milliseconds flush_interval{100};
+};
+
+/**
+ * Capture file writer
+ * REST threads append records to an in-memory buffer under a short lock;
+ * a writer thread swaps the buffer out and writes it, so request handling
+ * never waits on the disk. Records that do not fit the buffer are dropped
+ * and counted rather than blocking the request.
+ */
+class IngestCapture {
+public:
+    struct Stats {
+        bool active;
+        uint64_t records;        // Written or buffered
+        uint64_t bytes;          // Likewise, including record headers
+        uint64_t dropped;        // Buffer full or file limit reached
+        size_t buffered_bytes;
+    };
+
+    IngestCapture() = default;
+    ~IngestCapture();
+
+    IngestCapture(const IngestCapture&) = delete;
+    IngestCapture& operator=(const IngestCapture&) = delete;
+
+    /**
+     * Start, stop or switch files (any thread; not concurrently with itself)
+     * A new capture truncates its file.
+     */
+    void configure(const IngestCaptureConfig& config);
+
+    /**
+     * Write what is buffered and close the file
+     */
+    void stop();
+
+    bool active() const { return active_.load(std::memory_order_relaxed); }
+
+    /**
+     * Append an accepted event (any thread)
+     * @param arrival When the request was read
+     */
+    void record(std::chrono::steady_clock::time_point arrival, std::string_view type,
+                std::string_view body);
+
+    Stats get_stats() const;
+
+private:
+    std::atomic<bool> active_{false};
+    IngestCaptureConfig config_;
+    std::chrono::steady_clock::time_point start_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::string buffer_;       // Records not yet handed to the writer
+    size_t file_bytes_ = 0;    // Written or buffered, for max_file_bytes
+    bool stopping_ = false;
+
+    std::thread writer_;
+    std::ofstream file_;
+
+    std::atomic<uint64_t> records_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    void write_loop();
+    bool shutdown_writer();  // false if no capture was running
+};
+
+/**
+ * Get global ingest capture instance
+ */
+IngestCapture& get_ingest_capture();
@@ -0,0 +1,108 @@
+﻿#include "listener.h"
+#include "logger.h"
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#endif
+
+bool reuse_port_supported() {
+#if defined(__linux__) && defined(SO_REUSEPORT)
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t effective_acceptor_count(const ListenerConfig& config) {
+    if (!config.inherited_handles.empty()) {
+        return config.inherited_handles.size();
+    }
+    if (config.acceptor_count <= 1) {
+        return 1;
+    }
+    if (!reuse_port_supported()) {
+        log_warn("SO_REUSEPORT is not available on this platform; using a single acceptor");
+        return 1;
+    }
+    return config.acceptor_count;
+}
+
+tcp::acceptor open_acceptor(boost::asio::io_context& io_context,
+                            const tcp::endpoint& endpoint,
+                            int backlog,
+                            bool reuse_port) {
+    tcp::acceptor acceptor(io_context);
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(tcp::acceptor::reuse_address(true));
+#if defined(__linux__) && defined(SO_REUSEPORT)
+    if (reuse_port) {
+        using reuse_port_option = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+        acceptor.set_option(reuse_port_option(true));
+    }
+#else
+    (void)reuse_port;
+#endif
+    acceptor.bind(endpoint);
+    acceptor.listen(backlog);
+    return acceptor;
+}
+
+tcp::acceptor open_listener_acceptor(boost::asio::io_context& io_context,
+                                     const tcp::endpoint& endpoint,
+                                     const ListenerConfig& config,
+                                     size_t index,
+                                     bool reuse_port) {
+    if (index < config.inherited_handles.size()) {
+        // Already bound and listening; connections queued in its backlog are kept
+        tcp::acceptor acceptor(io_context);
+        acceptor.assign(endpoint.protocol(), config.inherited_handles[index]);
+        return acceptor;
+    }
+    return open_acceptor(io_context, endpoint, config.backlog, reuse_port);
+}
+
+// IoThreadPool implementation
+
+IoThreadPool::IoThreadPool(size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        contexts_.push_back(std::make_unique<boost::asio::io_context>(1));
+        work_guards_.push_back(boost::asio::make_work_guard(*contexts_.back()));
+    }
+}
+
+IoThreadPool::~IoThreadPool() {
+    stop();
+}
+
+boost::asio::io_context& IoThreadPool::context(size_t index) {
+    return *contexts_[index];
+}
+
+size_t IoThreadPool::size() const {
+    return contexts_.size();
+}
+
+void IoThreadPool::start() {
+    for (auto& context : contexts_) {
+        threads_.emplace_back([&context]() {
+            try {
+                context->run();
+            } catch (const std::exception& e) {
+                log_error("I/O thread error: " + std::string(e.what()));
+            }
+        });
+    }
+}
+
+void IoThreadPool::stop() {
+    work_guards_.clear();
+    for (auto& context : contexts_) {
+        context->stop();
+    }
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads_.clear();
+}
@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include "asio_config.h"
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+
+using boost::asio::ip::tcp;
+
+/**
+ * Listening socket settings shared by the REST API and WebSocket servers
+ * With acceptor_count > 1 every acceptor binds the same port with SO_REUSEPORT
+ * and the kernel spreads incoming connections across them. Linux only; other
+ * platforms fall back to a single acceptor.
+ */
+struct ListenerConfig {
+    int backlog = boost::asio::socket_base::max_listen_connections;
+    size_t acceptor_count = 1;
+    // Listening sockets handed over by a hot restart predecessor (see HotRestart).
+    // When present they are adopted instead of binding, one acceptor each.
+    std::vector<int> inherited_handles{};
+};
+
+/**
+ * True when this platform can run several acceptors on one port
+ */
+bool reuse_port_supported();
+
+/**
+ * Acceptors to open for this config on this platform (at least 1)
+ */
+size_t effective_acceptor_count(const ListenerConfig& config);
+
+/**
+ * Open, bind and listen
+ * @param reuse_port set SO_REUSEPORT so sibling acceptors can bind the same port
+ */
+tcp::acceptor open_acceptor(boost::asio::io_context& io_context,
+                            const tcp::endpoint& endpoint,
+                            int backlog,
+                            bool reuse_port);
+
+/**
+ * Acceptor number index of a listener: the inherited socket when the config
+ * carries one for that index, otherwise a new one from open_acceptor
+ */
+tcp::acceptor open_listener_acceptor(boost::asio::io_context& io_context,
+                                     const tcp::endpoint& endpoint,
+                                     const ListenerConfig& config,
+                                     size_t index,
+                                     bool reuse_port);
+
+/**
+ * Threads that each run their own io_context until stopped
+ * Used for the additional acceptors of a multi-acceptor listener.
+ */
+class IoThreadPool {
+public:
+    explicit IoThreadPool(size_t count);
+    ~IoThreadPool();
+
+    IoThreadPool(const IoThreadPool&) = delete;
+    IoThreadPool& operator=(const IoThreadPool&) = delete;
+
+    boost::asio::io_context& context(size_t index);
+    size_t size() const;
+
+    void start();
+    void stop();  // Stops the io_contexts and joins the threads
+
+private:
+    using WorkGuard = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
+
+    std::vector<std::unique_ptr<boost::asio::io_context>> contexts_;
+    std::vector<WorkGuard> work_guards_;
+    std::vector<std::thread> threads_;
+};
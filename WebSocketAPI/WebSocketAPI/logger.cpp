@@ -1,5 +1,9 @@
 ﻿#include "logger.h"
+#include "uring_file_sink.h"
 #include <fstream>
+#include <mutex>
+#include <sstream>
+#include <vector>
 #include <nlohmann/json.hpp>
 #include <spdlog/sinks/rotating_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
@@ -8,6 +12,16 @@ using json = nlohmann::json;
 
 static std::shared_ptr<spdlog::logger> g_logger;
 
+static bool parse_level(const std::string& level_str, spdlog::level::level_enum& level) {
+    if (level_str == "debug") level = spdlog::level::debug;
+    else if (level_str == "info") level = spdlog::level::info;
+    else if (level_str == "warn") level = spdlog::level::warn;
+    else if (level_str == "err") level = spdlog::level::err;
+    else if (level_str == "critical") level = spdlog::level::critical;
+    else return false;
+    return true;
+}
+
 void init_logger(const std::string& config_file) {
     try {
         // Read configuration file
@@ -37,11 +51,7 @@ void init_logger(const std::string& config_file) {
         // Parse log level
         auto level_str = log_config["level"].get<std::string>();
         spdlog::level::level_enum level = spdlog::level::info;
-        if (level_str == "debug") level = spdlog::level::debug;
-        else if (level_str == "info") level = spdlog::level::info;
-        else if (level_str == "warn") level = spdlog::level::warn;
-        else if (level_str == "err") level = spdlog::level::err;
-        else if (level_str == "critical") level = spdlog::level::critical;
+        parse_level(level_str, level);
 
         std::vector<spdlog::sink_ptr> sinks;
 
@@ -58,8 +68,12 @@ void init_logger(const std::string& config_file) {
             auto max_size = log_config["max_file_size"].get<size_t>();
             auto max_files = log_config["max_files"].get<size_t>();
             
+#if defined(WEBSOCKETAPI_IO_URING)
+            auto file_sink = std::make_shared<UringFileSink>(file_path, max_size, max_files);
+#else
             auto file_sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(
                 file_path, max_size, max_files);
+#endif
             file_sink->set_level(level);
             sinks.push_back(file_sink);
         }
@@ -89,6 +103,18 @@ void init_logger(const std::string& config_file) {
     }
 }
 
+bool set_log_level(const std::string& level_str) {
+    spdlog::level::level_enum level;
+    if (!g_logger || !parse_level(level_str, level)) {
+        return false;
+    }
+    for (auto& sink : g_logger->sinks()) {
+        sink->set_level(level);
+    }
+    g_logger->set_level(level);
+    return true;
+}
+
 std::shared_ptr<spdlog::logger> get_logger() {
     if (!g_logger) {
         init_logger();
@@ -113,3 +139,110 @@ void log_warn(const std::string& message) {
         g_logger->warn(message);
     }
 }
+
+void log_debug(const std::string& message) {
+    if (g_logger) {
+        g_logger->debug(message);
+    }
+}
+
+bool log_debug_enabled() {
+    return g_logger && g_logger->should_log(spdlog::level::debug);
+}
+
+// LogRateLimiter implementation
+
+LogRateLimiter::LogRateLimiter(uint32_t max_per_second, uint32_t sample_every)
+    : max_per_second_(max_per_second),
+      sample_every_(sample_every > 0 ? sample_every : 1) {
+}
+
+bool LogRateLimiter::allow() {
+    if (sample_every_ > 1 &&
+        calls_.fetch_add(1, std::memory_order_relaxed) % sample_every_ != 0) {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Whoever first sees a new second resets the window; racing callers may
+    // let a line or two extra through, which is fine for logging
+    int64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t window = window_.load(std::memory_order_relaxed);
+    if (window != second &&
+        window_.compare_exchange_strong(window, second, std::memory_order_relaxed)) {
+        window_count_.store(0, std::memory_order_relaxed);
+    }
+    if (window_count_.fetch_add(1, std::memory_order_relaxed) < max_per_second_) {
+        return true;
+    }
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+std::string LogRateLimiter::suppressed_suffix() {
+    uint64_t suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+    if (suppressed == 0) {
+        return std::string();
+    }
+    return " (" + std::to_string(suppressed) + " similar suppressed)";
+}
+
+// LogCounter implementation
+
+namespace {
+
+// Counters are defined at namespace scope in several files, so the registry
+// is a function-local static to be ready before any of them registers
+struct CounterRegistry {
+    std::mutex mutex;
+    std::vector<LogCounter*> counters;
+};
+
+CounterRegistry& counter_registry() {
+    static CounterRegistry registry;
+    return registry;
+}
+
+}  // namespace
+
+LogCounter::LogCounter(const char* name)
+    : name_(name) {
+    auto& registry = counter_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.counters.push_back(this);
+}
+
+void log_summary(std::chrono::steady_clock::duration interval) {
+    auto& registry = counter_registry();
+    double seconds = std::chrono::duration<double>(interval).count();
+
+    std::ostringstream line;
+    bool any = false;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (auto* counter : registry.counters) {
+            uint64_t count = counter->count_.exchange(0, std::memory_order_relaxed);
+            uint64_t bytes = counter->bytes_.exchange(0, std::memory_order_relaxed);
+            uint64_t errors = counter->errors_.exchange(0, std::memory_order_relaxed);
+            if (count == 0 && errors == 0) {
+                continue;
+            }
+            line << (any ? ", " : " ") << counter->name_ << "=" << count;
+            if (seconds > 0) {
+                line << " (" << static_cast<uint64_t>(count / seconds) << "/s)";
+            }
+            if (bytes) {
+                line << " bytes=" << bytes;
+            }
+            if (errors) {
+                line << " errors=" << errors;
+            }
+            any = true;
+        }
+    }
+
+    if (any) {
+        log_info("Summary (" + std::to_string(static_cast<int64_t>(seconds)) + "s):" + line.str());
+    }
+}
@@ -1,5 +1,8 @@
 ﻿#pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <spdlog/spdlog.h>
@@ -10,6 +13,13 @@
  */
 void init_logger(const std::string& config_file = "logging_config.json");
 
+/**
+ * Change the level of the logger and all of its sinks at runtime
+ * @param level "debug", "info", "warn", "err" or "critical"
+ * @return false (level unchanged) for an unknown level name
+ */
+bool set_log_level(const std::string& level);
+
 /**
  * Get the global logger instance
  * @return Shared pointer to spdlog logger
@@ -33,3 +43,85 @@ void log_error(const std::string& message);
  * @param message Message to log
  */
 void log_warn(const std::string& message);
+
+/**
+ * Log debug level message
+ * @param message Message to log
+ */
+void log_debug(const std::string& message);
+
+/**
+ * Check whether debug messages would be written
+ * Hot paths test this before building a message string.
+ * @return true if the logger accepts debug level
+ */
+bool log_debug_enabled();
+
+/**
+ * Per-call-site log limiter: sampling plus at most N lines per second
+ * Declare one as a static next to a noisy log call and test allow() before
+ * building the message. Dropped calls are counted and reported on the next
+ * line that gets through.
+ */
+class LogRateLimiter {
+public:
+    /**
+     * @param max_per_second Lines let through per one-second window
+     * @param sample_every Consider only every Nth call (1 = every call)
+     */
+    explicit LogRateLimiter(uint32_t max_per_second, uint32_t sample_every = 1);
+
+    /**
+     * @return true if this call may log; otherwise it is counted as suppressed
+     */
+    bool allow();
+
+    /**
+     * Suffix such as " (42 similar suppressed)" for the line being logged,
+     * or an empty string; resets the suppressed count
+     */
+    std::string suppressed_suffix();
+
+private:
+    const uint32_t max_per_second_;
+    const uint32_t sample_every_;
+    std::atomic<int64_t> window_{-1};
+    std::atomic<uint32_t> window_count_{0};
+    std::atomic<uint64_t> calls_{0};
+    std::atomic<uint64_t> suppressed_{0};
+};
+
+/**
+ * Activity counter reported in the periodic summary line instead of per-event lines
+ * Define at namespace scope; counters register themselves on construction.
+ */
+class LogCounter {
+public:
+    explicit LogCounter(const char* name);
+
+    void add(uint64_t bytes = 0) {
+        count_.fetch_add(1, std::memory_order_relaxed);
+        if (bytes) {
+            bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        }
+    }
+
+    void add_error() {
+        errors_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    friend void log_summary(std::chrono::steady_clock::duration interval);
+
+    const char* name_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> errors_{0};
+};
+
+/**
+ * Write one info line with the counts, bytes and errors of every counter
+ * that saw activity since the previous call, then reset them
+ * @param interval Time covered by this summary, for the rates shown
+ */
+void log_summary(std::chrono::steady_clock::duration interval);
@@ -0,0 +1,139 @@
+﻿#include "memory_pool.h"
+#include <array>
+
+// BufferPool implementation
+
+void BufferPool::Releaser::operator()(std::vector<char>* buffer) const {
+    pool->release(buffer);
+}
+
+BufferPool::BufferPool(size_t buffer_size, size_t max_cached)
+    : buffer_size_(buffer_size),
+      max_cached_(max_cached) {
+}
+
+BufferPool::Handle BufferPool::acquire() {
+    size_t buffer_size = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            auto buffer = std::move(free_.back());
+            free_.pop_back();
+            reused_++;
+            return Handle(buffer.release(), Releaser{this});
+        }
+        created_++;
+        buffer_size = buffer_size_;
+    }
+    return Handle(new std::vector<char>(buffer_size), Releaser{this});
+}
+
+size_t BufferPool::buffer_size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return buffer_size_;
+}
+
+void BufferPool::set_buffer_size(size_t buffer_size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buffer_size != buffer_size_) {
+        buffer_size_ = buffer_size;
+        free_.clear();
+    }
+}
+
+BufferPool::Stats BufferPool::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Stats{created_, reused_, free_.size()};
+}
+
+void BufferPool::release(std::vector<char>* buffer) {
+    std::unique_ptr<std::vector<char>> owned(buffer);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_.size() < max_cached_ && owned->size() == buffer_size_) {
+        free_.push_back(std::move(owned));
+    }
+}
+
+// Recycling allocator implementation
+
+namespace {
+
+// Size classes 64, 128, ..., 4096 bytes; larger blocks go straight to the heap
+constexpr size_t MIN_BLOCK_SHIFT = 6;
+constexpr size_t SIZE_CLASS_COUNT = 7;
+constexpr size_t MAX_CACHED_PER_CLASS = 4096;
+
+size_t size_class(size_t size) {
+    size_t block = size_t{1} << MIN_BLOCK_SHIFT;
+    size_t index = 0;
+    while (block < size) {
+        block <<= 1;
+        index++;
+    }
+    return index;
+}
+
+// Set once the calling thread's cache is gone; blocks freed later, e.g. by
+// static objects destroyed at exit, go straight back to the heap
+thread_local bool cache_destroyed = false;
+
+struct RecyclingCache {
+    std::array<std::vector<void*>, SIZE_CLASS_COUNT> free_blocks;
+
+    ~RecyclingCache() {
+        cache_destroyed = true;
+        for (auto& blocks : free_blocks) {
+            for (void* block : blocks) {
+                ::operator delete(block);
+            }
+        }
+    }
+};
+
+RecyclingCache& recycling_cache() {
+    thread_local RecyclingCache cache;
+    return cache;
+}
+
+}  // namespace
+
+void* recycling_allocate(size_t size) {
+    size_t index = size_class(size);
+    if (index >= SIZE_CLASS_COUNT) {
+        return ::operator new(size);
+    }
+    if (cache_destroyed) {
+        return ::operator new(size_t{1} << (MIN_BLOCK_SHIFT + index));
+    }
+    auto& blocks = recycling_cache().free_blocks[index];
+    if (!blocks.empty()) {
+        void* block = blocks.back();
+        blocks.pop_back();
+        return block;
+    }
+    return ::operator new(size_t{1} << (MIN_BLOCK_SHIFT + index));
+}
+
+void recycling_deallocate(void* ptr, size_t size) {
+    size_t index = size_class(size);
+    if (index < SIZE_CLASS_COUNT && !cache_destroyed) {
+        auto& blocks = recycling_cache().free_blocks[index];
+        if (blocks.size() < MAX_CACHED_PER_CLASS) {
+            blocks.push_back(ptr);
+            return;
+        }
+    }
+    ::operator delete(ptr);
+}
+
+// Global pools
+
+BufferPool& get_read_buffer_pool() {
+    static BufferPool instance(8192, 1024);
+    return instance;
+}
+
+std::pmr::memory_resource* get_session_memory_resource() {
+    static std::pmr::synchronized_pool_resource instance;
+    return &instance;
+}
@@ -0,0 +1,142 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Recycling pool of fixed-size byte buffers (socket read buffers)
+ * Buffers return to the pool when their handle is destroyed.
+ */
+class BufferPool {
+public:
+    struct Releaser {
+        BufferPool* pool;
+        void operator()(std::vector<char>* buffer) const;
+    };
+
+    using Handle = std::unique_ptr<std::vector<char>, Releaser>;
+
+    struct Stats {
+        uint64_t created;
+        uint64_t reused;
+        size_t cached;
+    };
+
+    BufferPool(size_t buffer_size, size_t max_cached);
+    ~BufferPool() = default;
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /**
+     * Get a buffer of buffer_size() bytes, reusing a released one when possible
+     */
+    Handle acquire();
+
+    size_t buffer_size() const;
+    Stats get_stats() const;
+
+    /**
+     * Change the size of buffers handed out from now on
+     * Buffers already in use keep their size and are freed, not cached,
+     * when they come back.
+     */
+    void set_buffer_size(size_t buffer_size);
+
+private:
+    size_t buffer_size_;
+    size_t max_cached_;
+    std::vector<std::unique_ptr<std::vector<char>>> free_;
+    uint64_t created_ = 0;
+    uint64_t reused_ = 0;
+    mutable std::mutex mutex_;
+
+    void release(std::vector<char>* buffer);
+};
+
+/**
+ * Thread-local recycling of small blocks for async operation state
+ * Asio and Beast allocate their operation objects through the completion
+ * handler's associated allocator; routing that to per-thread size-class
+ * free lists makes steady-state reads and writes allocation-free.
+ */
+void* recycling_allocate(size_t size);
+void recycling_deallocate(void* ptr, size_t size);
+
+template <typename T>
+class RecyclingAllocator {
+public:
+    using value_type = T;
+
+    RecyclingAllocator() noexcept = default;
+
+    template <typename U>
+    RecyclingAllocator(const RecyclingAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(recycling_allocate(sizeof(T) * n));
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        recycling_deallocate(ptr, sizeof(T) * n);
+    }
+
+    template <typename U>
+    bool operator==(const RecyclingAllocator<U>&) const noexcept { return true; }
+
+    template <typename U>
+    bool operator!=(const RecyclingAllocator<U>&) const noexcept { return false; }
+};
+
+/**
+ * Completion handler wrapper that advertises RecyclingAllocator
+ */
+template <typename Handler>
+class RecyclingHandler {
+public:
+    using allocator_type = RecyclingAllocator<Handler>;
+
+    explicit RecyclingHandler(Handler handler) : handler_(std::move(handler)) {}
+
+    allocator_type get_allocator() const noexcept { return allocator_type(); }
+
+    template <typename... Args>
+    void operator()(Args&&... args) {
+        handler_(std::forward<Args>(args)...);
+    }
+
+private:
+    Handler handler_;
+};
+
+template <typename Handler>
+RecyclingHandler<std::decay_t<Handler>> make_recycling_handler(Handler&& handler) {
+    return RecyclingHandler<std::decay_t<Handler>>(std::forward<Handler>(handler));
+}
+
+/**
+ * Get the pool for 8 KB REST read buffers
+ */
+BufferPool& get_read_buffer_pool();
+
+/**
+ * Pooled memory resource for session objects
+ * Shared by both server threads; sessions are allocated with
+ * std::allocate_shared so object and control block come from one slab slot.
+ */
+std::pmr::memory_resource* get_session_memory_resource();
+
+/**
+ * Allocate a shared session object from the session slab
+ */
+template <typename T, typename... Args>
+std::shared_ptr<T> make_pooled_session(Args&&... args) {
+    return std::allocate_shared<T>(
+        std::pmr::polymorphic_allocator<T>(get_session_memory_resource()),
+        std::forward<Args>(args)...);
+}
@@ -0,0 +1,174 @@
+﻿#include "rate_limiter.h"
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Convert rate/burst to GCRA parameters (interval between tokens, bucket depth)
+void to_gcra(double rate, double burst, int64_t& interval_ns, int64_t& capacity_ns) {
+    if (rate <= 0.0) {
+        interval_ns = 0;
+        capacity_ns = 0;
+        return;
+    }
+    interval_ns = std::max<int64_t>(1, static_cast<int64_t>(1e9 / rate));
+    capacity_ns = interval_ns * static_cast<int64_t>(std::max(1.0, burst));
+}
+
+}  // namespace
+
+// TokenBucket implementation
+
+int64_t TokenBucket::try_acquire(int64_t now_ns, int64_t interval_ns, int64_t capacity_ns) {
+    int64_t tat = tat_.load(std::memory_order_relaxed);
+    for (;;) {
+        int64_t new_tat = std::max(tat, now_ns) + interval_ns;
+        int64_t wait_ns = new_tat - now_ns - capacity_ns;
+        if (wait_ns > 0) {
+            return wait_ns;
+        }
+        if (tat_.compare_exchange_weak(tat, new_tat, std::memory_order_relaxed)) {
+            return 0;
+        }
+    }
+}
+
+void TokenBucket::refund(int64_t interval_ns) {
+    tat_.fetch_sub(interval_ns, std::memory_order_relaxed);
+}
+
+bool TokenBucket::is_idle(int64_t now_ns) const {
+    return tat_.load(std::memory_order_relaxed) <= now_ns;
+}
+
+// RateLimiter implementation
+
+RateLimiter::RateLimiter() {
+    configure(RateLimitConfig{});
+}
+
+void RateLimiter::configure(const RateLimitConfig& config) {
+    int64_t interval_ns = 0;
+    int64_t capacity_ns = 0;
+
+    to_gcra(config.global_rate, config.global_burst, interval_ns, capacity_ns);
+    global_interval_ns_ = interval_ns;
+    global_capacity_ns_ = capacity_ns;
+
+    to_gcra(config.per_client_rate, config.per_client_burst, interval_ns, capacity_ns);
+    client_interval_ns_ = interval_ns;
+    client_capacity_ns_ = capacity_ns;
+
+    max_clients_per_shard_ = std::max<size_t>(1, config.max_tracked_clients / SHARD_COUNT);
+    enabled_ = config.enabled;
+}
+
+RateLimitDecision RateLimiter::check(const std::string& client_key) {
+    RateLimitDecision decision;
+    if (!enabled_.load(std::memory_order_relaxed)) {
+        allowed_.fetch_add(1, std::memory_order_relaxed);
+        return decision;
+    }
+
+    int64_t now_ns = steady_now_ns();
+
+    // Per-client bucket first so an abusive client cannot drain the global budget
+    int64_t client_interval = client_interval_ns_.load(std::memory_order_relaxed);
+    Shard* client_shard = nullptr;
+    if (client_interval > 0) {
+        auto& shard = shards_[std::hash<std::string>{}(client_key) % SHARD_COUNT];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        TokenBucket* bucket;
+        auto it = shard.buckets.find(client_key);
+        if (it != shard.buckets.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            bucket = &it->second->bucket;
+        } else {
+            bucket = track_client(shard, client_key, now_ns);
+        }
+        int64_t wait_ns = 0;
+        if (bucket) {
+            wait_ns = bucket->try_acquire(
+                now_ns, client_interval, client_capacity_ns_.load(std::memory_order_relaxed));
+            client_shard = &shard;
+        } else {
+            untracked_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (wait_ns > 0) {
+            rejected_client_.fetch_add(1, std::memory_order_relaxed);
+            decision.result = RateLimitResult::client_limited;
+            decision.retry_after = std::chrono::nanoseconds(wait_ns);
+            return decision;
+        }
+    }
+
+    int64_t global_interval = global_interval_ns_.load(std::memory_order_relaxed);
+    if (global_interval > 0) {
+        int64_t wait_ns = global_bucket_.try_acquire(
+            now_ns, global_interval, global_capacity_ns_.load(std::memory_order_relaxed));
+        if (wait_ns > 0) {
+            if (client_shard) {
+                refund_client(*client_shard, client_key, client_interval);
+            }
+            rejected_global_.fetch_add(1, std::memory_order_relaxed);
+            decision.result = RateLimitResult::global_limited;
+            decision.retry_after = std::chrono::nanoseconds(wait_ns);
+            return decision;
+        }
+    }
+
+    allowed_.fetch_add(1, std::memory_order_relaxed);
+    return decision;
+}
+
+RateLimiter::Stats RateLimiter::get_stats() const {
+    Stats stats{};
+    stats.allowed = allowed_.load(std::memory_order_relaxed);
+    stats.rejected_global = rejected_global_.load(std::memory_order_relaxed);
+    stats.rejected_client = rejected_client_.load(std::memory_order_relaxed);
+    stats.untracked = untracked_.load(std::memory_order_relaxed);
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.tracked_clients += shard.buckets.size();
+    }
+    return stats;
+}
+
+TokenBucket* RateLimiter::track_client(Shard& shard, const std::string& client_key, int64_t now_ns) {
+    // Make room from the least recently used end. A full bucket carries no
+    // state, so dropping it is equivalent to keeping it; a bucket still in
+    // use is kept, and the new client goes without one rather than let a
+    // flood of new keys reset the limits of active clients.
+    size_t max_clients = max_clients_per_shard_.load(std::memory_order_relaxed);
+    while (shard.buckets.size() >= max_clients) {
+        auto& oldest = shard.lru.back();
+        if (!oldest.bucket.is_idle(now_ns)) {
+            return nullptr;
+        }
+        shard.buckets.erase(oldest.key);
+        shard.lru.pop_back();
+    }
+    shard.lru.emplace_front(client_key);
+    shard.buckets.emplace(shard.lru.front().key, shard.lru.begin());
+    return &shard.lru.front().bucket;
+}
+
+void RateLimiter::refund_client(Shard& shard, const std::string& client_key, int64_t interval_ns) {
+    // Looked up again: the bucket may have been evicted since it was charged
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.buckets.find(client_key);
+    if (it != shard.buckets.end()) {
+        it->second->bucket.refund(interval_ns);
+    }
+}
+
+// Global rate limiter instance
+RateLimiter& get_rate_limiter() {
+    static RateLimiter instance;
+    return instance;
+}
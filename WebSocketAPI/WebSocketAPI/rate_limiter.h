@@ -0,0 +1,142 @@
+﻿#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * Token-bucket limits for event ingest
+ * Rates are tokens per second, bursts are the bucket capacity in tokens.
+ * A rate of 0 disables that limit.
+ */
+struct RateLimitConfig {
+    bool enabled = true;
+    double global_rate = 1000.0;
+    double global_burst = 2000.0;
+    double per_client_rate = 100.0;
+    double per_client_burst = 200.0;
+    size_t max_tracked_clients = 65536;
+};
+
+/**
+ * Lock-free token bucket
+ * Stores only the theoretical arrival time (GCRA form), so a take is a single CAS.
+ */
+class TokenBucket {
+public:
+    /**
+     * Try to take one token
+     * @return 0 if admitted, otherwise nanoseconds until a token is available
+     */
+    int64_t try_acquire(int64_t now_ns, int64_t interval_ns, int64_t capacity_ns);
+
+    /**
+     * Give back a token taken by try_acquire
+     */
+    void refund(int64_t interval_ns);
+
+    /**
+     * True when the bucket is full again and can be forgotten
+     */
+    bool is_idle(int64_t now_ns) const;
+
+private:
+    std::atomic<int64_t> tat_{0};
+};
+
+enum class RateLimitResult {
+    allowed,
+    global_limited,
+    client_limited
+};
+
+struct RateLimitDecision {
+    RateLimitResult result = RateLimitResult::allowed;
+    std::chrono::nanoseconds retry_after{0};
+
+    bool allowed() const { return result == RateLimitResult::allowed; }
+};
+
+/**
+ * Admission control for POST /api/event
+ * One global bucket plus per-client buckets (source address or API key)
+ * kept in mutex-sharded maps so clients rarely contend with each other.
+ * Each shard keeps its clients in LRU order; once max_tracked_clients is
+ * reached a new client replaces the least recently used one if that bucket
+ * is full again, and otherwise is admitted on the global bucket alone.
+ * A request the global bucket rejects does not cost the client a token.
+ */
+class RateLimiter {
+public:
+    struct Stats {
+        uint64_t allowed;
+        uint64_t rejected_global;
+        uint64_t rejected_client;
+        uint64_t untracked;  // Checks by new clients while every tracked bucket was in use
+        size_t tracked_clients;
+    };
+
+    RateLimiter();
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    /**
+     * Apply new limits (safe while requests are being checked)
+     */
+    void configure(const RateLimitConfig& config);
+
+    /**
+     * Take a token for the given client key
+     */
+    RateLimitDecision check(const std::string& client_key);
+
+    Stats get_stats() const;
+
+private:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct ClientBucket {
+        std::string key;
+        TokenBucket bucket;
+
+        explicit ClientBucket(const std::string& client_key) : key(client_key) {}
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<ClientBucket> lru;  // Most recently used first
+        std::unordered_map<std::string_view, std::list<ClientBucket>::iterator> buckets;  // Keys view into lru
+    };
+
+    std::atomic<bool> enabled_{false};
+    std::atomic<int64_t> global_interval_ns_{0};
+    std::atomic<int64_t> global_capacity_ns_{0};
+    std::atomic<int64_t> client_interval_ns_{0};
+    std::atomic<int64_t> client_capacity_ns_{0};
+    std::atomic<size_t> max_clients_per_shard_{0};
+
+    TokenBucket global_bucket_;
+    std::array<Shard, SHARD_COUNT> shards_;
+
+    std::atomic<uint64_t> allowed_{0};
+    std::atomic<uint64_t> rejected_global_{0};
+    std::atomic<uint64_t> rejected_client_{0};
+    std::atomic<uint64_t> untracked_{0};
+
+    // Bucket for a client not yet in the shard, or nullptr when the shard is full of active clients
+    TokenBucket* track_client(Shard& shard, const std::string& client_key, int64_t now_ns);
+    // Undo a client's token when the global bucket turns the request away
+    void refund_client(Shard& shard, const std::string& client_key, int64_t interval_ns);
+};
+
+/**
+ * Get global rate limiter instance
+ */
+RateLimiter& get_rate_limiter();
@@ -1,33 +1,404 @@
 ﻿#include "rest_api_server.h"
+#include "flight_recorder.h"
+#include "idempotency.h"
+#include "ingest_capture.h"
+#include "memory_pool.h"
+#include "rate_limiter.h"
+#include "sse_session.h"
+#include "state_store.h"
 #include <sstream>
 #include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <memory_resource>
+#include <optional>
 
-RestApiServer::RestApiServer(boost::asio::io_context& io_context, unsigned short port)
+namespace {
+
+// Reported by the periodic summary line instead of per-request log lines
+LogCounter rest_reads("rest_reads");
+LogCounter rest_responses("rest_responses");
+
+}  // namespace
+
+bool parse_request_head(std::string_view buffer, std::pmr::string& headers_lower,
+                        HttpRequestHead& out_head) {
+    // Find header/body boundary
+    size_t header_end = buffer.find("\r\n\r\n");
+    if (header_end == std::string_view::npos) {
+        return false;
+    }
+    header_end += 4;  // Include the \r\n\r\n
+    out_head.header_bytes = header_end;
+
+    // Extract method and target from the request line
+    size_t first_space = buffer.find(' ');
+    size_t second_space = buffer.find(' ', first_space + 1);
+    out_head.method = buffer.substr(0, first_space);
+    out_head.target = buffer.substr(first_space + 1, second_space - first_space - 1);
+
+    // Headers only, lower-cased for case-insensitive lookups
+    headers_lower.assign(buffer.substr(0, header_end));
+    std::transform(headers_lower.begin(), headers_lower.end(), headers_lower.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    // Extract Content-Length from headers (case-insensitive)
+    out_head.content_length = 0;
+    size_t cl_pos = headers_lower.find("content-length:");
+    if (cl_pos != std::string::npos) {
+        size_t cl_end = buffer.find("\r\n", cl_pos);
+        std::string_view cl_str = buffer.substr(cl_pos + 15, cl_end - cl_pos - 15);
+        // Trim whitespace
+        size_t cl_first = cl_str.find_first_not_of(" \t");
+        cl_str = cl_first == std::string_view::npos ? std::string_view() : cl_str.substr(cl_first);
+        cl_str = cl_str.substr(0, cl_str.find_last_not_of(" \t") + 1);
+        size_t content_length = 0;
+        auto parsed = std::from_chars(cl_str.data(), cl_str.data() + cl_str.size(), content_length);
+        if (parsed.ec != std::errc() || parsed.ptr != cl_str.data() + cl_str.size()) {
+            static LogRateLimiter content_length_log(5);
+            if (content_length_log.allow()) {
+                log_warn("REST API: Could not parse Content-Length value: " + std::string(cl_str) +
+                         content_length_log.suppressed_suffix());
+            }
+        } else {
+            out_head.content_length = content_length;
+            if (log_debug_enabled()) {
+                log_debug("REST API: Content-Length = " + std::to_string(content_length));
+            }
+        }
+    } else if (log_debug_enabled()) {
+        log_debug("REST API: No Content-Length header found");
+    }
+    return true;
+}
+
+std::optional<HttpResponse> handle_post_event(std::string_view body, std::string_view idempotency_key,
+                                              std::function<void(HttpResponse)> respond_later) {
+    auto arrival = std::chrono::steady_clock::now();
+    auto json_response = [](int status_code, const std::string& message) {
+        json response;
+        response["status"] = (status_code == 200) ? "success" : "error";
+        response["message"] = message;
+        return HttpResponse{status_code, response.dump(), {}};
+    };
+    auto accepted_response = [](const IdempotentResponse& accepted) {
+        json response;
+        response["status"] = "success";
+        response["message"] = "Event received and queued for broadcast";
+        response["event_type"] = accepted.event_type;
+        response["priority"] = event_priority_name(accepted.priority);
+        response["timestamp"] = accepted.timestamp;
+        response["sequence"] = accepted.sequence;
+        return response.dump();
+    };
+    auto queue_full_response = [json_response]() {
+        // Push back on the producer until the broadcaster catches up
+        auto rejected = json_response(503, "Event queue is full, retry later");
+        rejected.headers.emplace_back("Retry-After", "1");
+        return rejected;
+    };
+
+    // Released on every path that does not publish, so the producer can retry
+    IdempotencyReservation reservation;
+    auto& idempotency = get_idempotency_index();
+    auto check_duplicate = [&](std::string key) -> std::optional<HttpResponse> {
+        // An empty key, in the header or the body, is no key
+        if (key.empty()) {
+            return std::nullopt;
+        }
+        if (key.size() > idempotency.max_key_length()) {
+            return json_response(400, "Idempotency key is longer than " +
+                                      std::to_string(idempotency.max_key_length()) + " bytes");
+        }
+        IdempotentResponse original;
+        switch (reservation.begin(std::move(key), original)) {
+            case IdempotencyResult::duplicate:
+                return HttpResponse{200, accepted_response(original), {{"Idempotent-Replayed", "true"}}};
+            case IdempotencyResult::in_progress: {
+                auto conflict = json_response(409, "A request with this idempotency key is in progress");
+                conflict.headers.emplace_back("Retry-After", "1");
+                return conflict;
+            }
+            default:
+                return std::nullopt;
+        }
+    };
+
+    try {
+        // Empty body check
+        if (body.empty()) {
+            static LogRateLimiter empty_body_log(5);
+            if (empty_body_log.allow()) {
+                log_error("POST /api/event received empty body" +
+                          empty_body_log.suppressed_suffix());
+            }
+            return json_response(400, "Request body is empty");
+        }
+
+        // A retry named by header is answered before its body is parsed
+        bool dedupe = idempotency.enabled();
+        if (dedupe && !idempotency_key.empty()) {
+            if (auto duplicate = check_duplicate(std::string(idempotency_key))) {
+                return std::move(*duplicate);
+            }
+        }
+
+        if (log_debug_enabled()) {
+            log_debug("REST API: Received body: " + std::string(body.substr(0, 100)) + 
+                    (body.length() > 100 ? "..." : ""));
+        }
+
+        auto request_json = json::parse(body);
+
+        if (dedupe && idempotency_key.empty() && request_json.is_object() &&
+            request_json.contains("idempotency_key") && request_json["idempotency_key"].is_string()) {
+            if (auto duplicate = check_duplicate(request_json["idempotency_key"].get<std::string>())) {
+                return std::move(*duplicate);
+            }
+        }
+
+        // Validate request format and create the event
+        Event event;
+        auto invalid = event_from_request(request_json, event);
+        if (!invalid.empty()) {
+            return json_response(400, invalid);
+        }
+
+        // Keep the reply fields so the event can be moved into the queue
+        IdempotentResponse accepted{event.type, event.priority, event.timestamp, 0};
+
+        auto& manager = get_event_manager();
+        EventManager::ForwardCallback on_forwarded;
+        std::shared_ptr<IdempotencyReservation> forwarded_reservation;
+        if (respond_later && manager.forwarding()) {
+            // Handed over to a hot restart successor: answered from its reply,
+            // so this I/O thread never waits for it
+            forwarded_reservation = std::make_shared<IdempotencyReservation>(std::move(reservation));
+            on_forwarded = [reservation = forwarded_reservation, accepted, respond_later,
+                            accepted_response, queue_full_response,
+                            captured = std::string(body), arrival]
+                           (PublishResult result, uint64_t sequence) mutable {
+                if (result == PublishResult::rejected) {
+                    respond_later(queue_full_response());
+                    return;
+                }
+                auto& capture = get_ingest_capture();
+                if (capture.active()) {
+                    capture.record(arrival, accepted.event_type, captured);
+                }
+                accepted.sequence = sequence;
+                std::string response = accepted_response(accepted);
+                reservation->complete(std::move(accepted));
+                respond_later(HttpResponse{200, std::move(response), {}});
+            };
+        }
+
+        auto result = manager.publish_event(std::move(event), &accepted.sequence,
+                                            std::move(on_forwarded));
+        if (result == PublishResult::forwarded) {
+            return std::nullopt;
+        }
+        if (result == PublishResult::rejected) {
+            return queue_full_response();
+        }
+
+        // Duplicates and rejected events are left out, so a replay publishes what was queued
+        auto& capture = get_ingest_capture();
+        if (capture.active()) {
+            capture.record(arrival, accepted.event_type, body);
+        }
+
+        // Forwarding may have ended in between, leaving the event queued here
+        std::string response = accepted_response(accepted);
+        (forwarded_reservation ? *forwarded_reservation : reservation).complete(std::move(accepted));
+        if (log_debug_enabled()) {
+            log_debug("REST API: /api/event handled successfully");
+        }
+        return HttpResponse{200, std::move(response), {}};
+    } catch (const json::parse_error& e) {
+        static LogRateLimiter parse_error_log(20);
+        if (parse_error_log.allow()) {
+            log_error("JSON parse error: " + std::string(e.what()) +
+                      parse_error_log.suppressed_suffix());
+        }
+        return json_response(400, std::string("Invalid JSON format: ") + e.what());
+    } catch (const std::exception& e) {
+        log_error("Event handling error: " + std::string(e.what()));
+        return json_response(500, "Internal server error");
+    }
+}
+
+HttpResponse handle_get_state(std::string_view type, std::string_view if_none_match) {
+    // Lock-free read of the current snapshot; the broadcaster is never blocked
+    auto snapshot = get_state_store().snapshot();
+
+    uint64_t version = 0;
+    const StateStore::TypeState* type_state = nullptr;
+    if (type.empty()) {
+        version = snapshot->version;
+    } else {
+        auto it = snapshot->types.find(std::string(type));
+        if (it == snapshot->types.end()) {
+            json response;
+            response["status"] = "error";
+            response["message"] = "No state for type " + std::string(type);
+            return HttpResponse{404, response.dump(), {}};
+        }
+        type_state = it->second.get();
+        version = type_state->version;
+    }
+
+    std::string etag = state_etag(version);
+    std::vector<std::pair<std::string, std::string>> headers = {
+        {"ETag", etag},
+        {"Cache-Control", "no-cache"}
+    };
+    if (!if_none_match.empty() && etag_matches(if_none_match, etag)) {
+        return HttpResponse{304, std::string(), std::move(headers)};
+    }
+    std::string body = type_state ? render_type_state(std::string(type), *type_state)
+                                  : render_state(*snapshot);
+    return HttpResponse{200, std::move(body), std::move(headers)};
+}
+
+std::string_view HttpRequest::header(std::string_view lower_name) const {
+    // Names are matched at line starts in the lower-cased copy, values taken from the original
+    for (size_t pos = headers_lower.find(lower_name); pos != std::string_view::npos;
+         pos = headers_lower.find(lower_name, pos + 1)) {
+        size_t colon = pos + lower_name.size();
+        if (pos < 2 || headers_lower.compare(pos - 2, 2, "\r\n") != 0 ||
+            colon >= headers_lower.size() || headers_lower[colon] != ':') {
+            continue;
+        }
+        size_t value_end = headers.find("\r\n", colon);
+        std::string_view value = headers.substr(colon + 1, value_end - colon - 1);
+        size_t first = value.find_first_not_of(" \t");
+        if (first == std::string_view::npos) {
+            return std::string_view();
+        }
+        return value.substr(first, value.find_last_not_of(" \t") - first + 1);
+    }
+    return std::string_view();
+}
+
+void RestApiServer::RouteTable::add(HttpMethod method, std::string_view pattern, RouteHandler handler,
+                                    bool rate_limited) {
+    size_t id = router.add(method, pattern);
+    routes.resize(std::max(routes.size(), id + 1));
+    routes[id] = Route{std::move(handler), rate_limited};
+}
+
+const RestApiServer::RouteTable& RestApiServer::route_table() {
+    static const RouteTable table = [] {
+        using Session = HttpSession::pointer;
+        RouteTable routes;
+        routes.add(HttpMethod::get, "/", [](const Session& session, const HttpRequest&) {
+            session->send_response(200, "WebSocket API Server is running");
+        });
+        routes.add(HttpMethod::get, "/api/state", [](const Session& session, const HttpRequest& request) {
+            session->handle_get_state(request);
+        });
+        routes.add(HttpMethod::get, "/api/state/{type}", [](const Session& session, const HttpRequest& request) {
+            session->handle_get_state(request);
+        });
+        routes.add(HttpMethod::get, "/api/stream", [](const Session& session, const HttpRequest&) {
+            session->handle_stream();
+        });
+        routes.add(HttpMethod::post, "/api/event", [](const Session& session, const HttpRequest& request) {
+            session->handle_post_event(request);
+        }, true);
+        return routes;
+    }();
+    return table;
+}
+
+RestApiServer::RestApiServer(boost::asio::io_context& io_context, unsigned short port,
+                             const ListenerConfig& listener)
     : io_context_(io_context),
-      acceptor_(io_context, tcp::endpoint(tcp::v4(), port)) {
-    log_info("REST API Server initialized on port " + std::to_string(port));
-    start_accept();
+      accept_threads_(effective_acceptor_count(listener) - 1) {
+    route_table();  // Built before the first request rather than during it
+    bool reuse_port = accept_threads_.size() > 0;
+    acceptors_.push_back(std::make_unique<Acceptor>(Acceptor{io_context,
+        open_listener_acceptor(io_context, tcp::endpoint(tcp::v4(), port), listener, 0, reuse_port)}));
+
+    // Siblings bind the port actually chosen, so port 0 works as well
+    tcp::endpoint bound(tcp::v4(), local_port());
+    for (size_t i = 0; i < accept_threads_.size(); i++) {
+        auto& context = accept_threads_.context(i);
+        acceptors_.push_back(std::make_unique<Acceptor>(Acceptor{context,
+            open_listener_acceptor(context, bound, listener, i + 1, true)}));
+    }
+
+    log_info("REST API Server initialized on port " + std::to_string(local_port()) +
+             " (acceptors=" + std::to_string(acceptors_.size()) +
+             ", backlog=" + std::to_string(listener.backlog) + ")");
+    for (auto& acceptor : acceptors_) {
+        start_accept(*acceptor);
+    }
+    accept_threads_.start();
 }
 
 RestApiServer::~RestApiServer() {
-    try {
-        acceptor_.close();
-    } catch (...) {
+    accept_threads_.stop();
+    for (auto& acceptor : acceptors_) {
+        try {
+            acceptor->acceptor.close();
+        } catch (...) {
+        }
+    }
+}
+
+unsigned short RestApiServer::local_port() const {
+    return acceptors_.front()->acceptor.local_endpoint().port();
+}
+
+uint64_t RestApiServer::accepted_connections() const {
+    return accepted_.load(std::memory_order_relaxed);
+}
+
+std::vector<int> RestApiServer::listening_handles() {
+    std::vector<int> handles;
+    for (auto& acceptor : acceptors_) {
+        handles.push_back(static_cast<int>(acceptor->acceptor.native_handle()));
+    }
+    return handles;
+}
+
+void RestApiServer::stop_accepting() {
+    // Each acceptor is closed on its own thread; sessions already accepted carry on
+    for (auto& acceptor : acceptors_) {
+        boost::asio::post(acceptor->io_context, [&listening = acceptor->acceptor]() {
+            boost::system::error_code ec;
+            listening.close(ec);
+        });
     }
 }
 
-void RestApiServer::start_accept() {
-    auto new_session = std::make_shared<HttpSession>(io_context_);
-    acceptor_.async_accept(
+void RestApiServer::start_accept(Acceptor& acceptor) {
+    auto new_session = make_pooled_session<HttpSession>(acceptor.io_context);
+    acceptor.acceptor.async_accept(
         new_session->socket(),
-        [this, new_session](const boost::system::error_code& ec) {
+        [this, &acceptor, new_session](const boost::system::error_code& ec) {
+            if (ec == boost::asio::error::operation_aborted) {
+                return;
+            }
             if (!ec) {
+                accepted_.fetch_add(1, std::memory_order_relaxed);
                 new_session->start();
-                log_info("REST API: New connection accepted");
+                if (log_debug_enabled()) {
+                    log_debug("REST API: New connection accepted");
+                }
             } else {
-                log_error("REST API accept error: " + ec.message());
+                flight_record(FlightEvent::error, 0, ec.value(),
+                              static_cast<uint16_t>(FlightErrorSource::accept));
+                static LogRateLimiter accept_error_log(20);
+                if (accept_error_log.allow()) {
+                    log_error("REST API accept error: " + ec.message() +
+                              accept_error_log.suppressed_suffix());
+                }
             }
-            start_accept();
+            start_accept(acceptor);
         });
 }
 
@@ -41,21 +412,31 @@ tcp::socket& RestApiServer::HttpSession::socket() {
 void RestApiServer::HttpSession::start() {
     auto self(shared_from_this());
     
-    // Read data into our buffer
-    auto read_buffer = std::make_shared<std::vector<char>>(8192);
+    // Read data into a pooled buffer, kept for the life of the session
+    read_buffer_ = get_read_buffer_pool().acquire();
     
     boost::asio::async_read(
         socket_,
-        boost::asio::buffer(*read_buffer),
+        boost::asio::buffer(*read_buffer_),
         boost::asio::transfer_at_least(1),
-        [this, self, read_buffer](const boost::system::error_code& ec, std::size_t bytes_transferred) {
+        [this, self](const boost::system::error_code& ec, std::size_t bytes_transferred) {
             if (!ec && bytes_transferred > 0) {
-                log_info("REST API: Read " + std::to_string(bytes_transferred) + " bytes");
+                if (log_debug_enabled()) {
+                    log_debug("REST API: Read " + std::to_string(bytes_transferred) + " bytes");
+                }
+                rest_reads.add(bytes_transferred);
                 // Append to buffer
-                buffer_.insert(buffer_.end(), read_buffer->begin(), read_buffer->begin() + bytes_transferred);
+                buffer_.insert(buffer_.end(), read_buffer_->begin(), read_buffer_->begin() + bytes_transferred);
                 handle_request();
             } else if (ec != boost::asio::error::eof) {
-                log_error("REST API read error: " + ec.message());
+                rest_reads.add_error();
+                flight_record(FlightEvent::error, 0, ec.value(),
+                              static_cast<uint16_t>(FlightErrorSource::read));
+                static LogRateLimiter read_error_log(20);
+                if (read_error_log.allow()) {
+                    log_error("REST API read error: " + ec.message() +
+                              read_error_log.suppressed_suffix());
+                }
             }
         });
 }
@@ -64,20 +445,28 @@ void RestApiServer::HttpSession::read_request_body() {
     auto self(shared_from_this());
     
     // Read more data into our buffer
-    auto read_buffer = std::make_shared<std::vector<char>>(8192);
-    
     boost::asio::async_read(
         socket_,
-        boost::asio::buffer(*read_buffer),
+        boost::asio::buffer(*read_buffer_),
         boost::asio::transfer_at_least(1),
-        [this, self, read_buffer](const boost::system::error_code& ec, std::size_t bytes_transferred) {
+        [this, self](const boost::system::error_code& ec, std::size_t bytes_transferred) {
             if (!ec && bytes_transferred > 0) {
-                log_info("REST API: Read more " + std::to_string(bytes_transferred) + " bytes");
+                if (log_debug_enabled()) {
+                    log_debug("REST API: Read more " + std::to_string(bytes_transferred) + " bytes");
+                }
+                rest_reads.add(bytes_transferred);
                 // Append to buffer
-                buffer_.insert(buffer_.end(), read_buffer->begin(), read_buffer->begin() + bytes_transferred);
+                buffer_.insert(buffer_.end(), read_buffer_->begin(), read_buffer_->begin() + bytes_transferred);
                 handle_request();
             } else {
-                log_error("REST API body read error: " + (ec ? ec.message() : "eof"));
+                rest_reads.add_error();
+                flight_record(FlightEvent::error, 0, ec.value(),
+                              static_cast<uint16_t>(FlightErrorSource::read));
+                static LogRateLimiter body_read_error_log(20);
+                if (body_read_error_log.allow()) {
+                    log_error("REST API body read error: " + (ec ? ec.message() : "eof") +
+                              body_read_error_log.suppressed_suffix());
+                }
             }
         });
 }
@@ -89,139 +478,178 @@ void RestApiServer::HttpSession::handle_request() {
         }
         
         size_t buffer_size = buffer_.size();
-        log_info("REST API: Buffer has " + std::to_string(buffer_size) + " bytes");
+        if (log_debug_enabled()) {
+            log_debug("REST API: Buffer has " + std::to_string(buffer_size) + " bytes");
+        }
         
         if (buffer_size == 0) {
-            log_warn("REST API: Buffer is empty, reading more data...");
+            if (log_debug_enabled()) {
+                log_debug("REST API: Buffer is empty, reading more data...");
+            }
             read_request_body();
             return;
         }
         
-        // Find header/body boundary
-        std::string buffer_str(buffer_.begin(), buffer_.end());
-        size_t header_end = buffer_str.find("\r\n\r\n");
+        // Parse in place; views into buffer_ stay valid until the next read
+        std::string_view buffer_str(buffer_.data(), buffer_.size());
         
-        if (header_end == std::string::npos) {
-            log_warn("REST API: Headers not complete yet, reading more data...");
+        // Per-request scratch arena: typical headers fit on the stack
+        std::array<char, 2048> arena_storage;
+        std::pmr::monotonic_buffer_resource arena(arena_storage.data(), arena_storage.size());
+        std::pmr::string buffer_lower(&arena);
+
+        HttpRequestHead head;
+        if (!parse_request_head(buffer_str, buffer_lower, head)) {
+            if (log_debug_enabled()) {
+                log_debug("REST API: Headers not complete yet, reading more data...");
+            }
             read_request_body();
             return;
         }
-        
-        header_end += 4;  // Include the \r\n\r\n
-        
-        // Extract Content-Length from headers (case-insensitive)
-        size_t content_length = 0;
-        std::string buffer_lower = buffer_str;
-        std::transform(buffer_lower.begin(), buffer_lower.end(), buffer_lower.begin(), ::tolower);
-        
-        size_t cl_pos = buffer_lower.find("content-length:");
-        if (cl_pos != std::string::npos) {
-            size_t cl_end = buffer_str.find("\r\n", cl_pos);
-            std::string cl_str = buffer_str.substr(cl_pos + 15, cl_end - cl_pos - 15);
-            // Trim whitespace
-            cl_str.erase(0, cl_str.find_first_not_of(" \t"));
-            cl_str.erase(cl_str.find_last_not_of(" \t") + 1);
-            try {
-                content_length = std::stoul(cl_str);
-                log_info("REST API: Content-Length = " + std::to_string(content_length));
-            } catch (...) {
-                log_warn("REST API: Could not parse Content-Length value: " + cl_str);
+        std::string_view method = head.method;
+        std::string_view target = head.target;
+        size_t header_end = head.header_bytes;
+        size_t content_length = head.content_length;
+
+        // Matched on every pass: the views into buffer_ move when it grows
+        const auto& table = route_table();
+        HttpRequest request;
+        request.method = parse_http_method(method);
+        request.target = target;
+        size_t route_id = table.router.find(request.method, target, request.params);
+        const Route* route = route_id == HttpRouter::NO_ROUTE ? nullptr : &table.routes[route_id];
+
+        // Admission control runs once per request, before the body is read or parsed
+        if (!admission_checked_ && route != nullptr && route->rate_limited) {
+            admission_checked_ = true;
+            if (!admit_request(buffer_str, buffer_lower)) {
+                request_handled = true;
+                return;
             }
-        } else {
-            log_info("REST API: No Content-Length header found");
         }
-        
+
         size_t total_needed = header_end + content_length;
-        log_info("REST API: Header ends at " + std::to_string(header_end) + 
-                ", total needed = " + std::to_string(total_needed) + 
-                ", have " + std::to_string(buffer_size));
+        if (log_debug_enabled()) {
+            log_debug("REST API: Header ends at " + std::to_string(header_end) + 
+                    ", total needed = " + std::to_string(total_needed) + 
+                    ", have " + std::to_string(buffer_size));
+        }
         
         if (buffer_size < total_needed) {
-            log_warn("REST API: Incomplete message, reading more...");
+            if (log_debug_enabled()) {
+                log_debug("REST API: Incomplete message, reading more...");
+            }
             read_request_body();
             return;
         }
         
-        // Extract method, target, and body manually
-        size_t first_space = buffer_str.find(' ');
-        size_t second_space = buffer_str.find(' ', first_space + 1);
-        
-        std::string method = buffer_str.substr(0, first_space);
-        std::string target = buffer_str.substr(first_space + 1, second_space - first_space - 1);
-        std::string body = buffer_str.substr(header_end, content_length);
+        // Extract body
+        std::string_view body = buffer_str.substr(header_end, content_length);
         
-        log_info("REST API: " + method + " " + target);
-        log_info("REST API: Body length=" + std::to_string(body.length()));
-        if (!body.empty()) {
-            log_info("REST API: Body=" + body.substr(0, 300));
+        if (log_debug_enabled()) {
+            log_debug("REST API: " + std::string(method) + " " + std::string(target));
+            log_debug("REST API: Body length=" + std::to_string(body.length()));
+            if (!body.empty()) {
+                log_debug("REST API: Body=" + std::string(body.substr(0, 300)));
+            }
         }
         
         request_handled = true;
-        
-        // Route the request
-        if (method == "GET" && target == "/") {
-            send_response(200, "WebSocket API Server is running");
-        } else if (method == "POST" && target == "/api/event") {
-            if (body.empty()) {
-                log_warn("POST /api/event received empty body");
-                send_json_response(400, std::string("Request body is empty"));
-            } else {
-                handle_post_event(body);
-            }
-        } else {
+        if (route == nullptr) {
             send_response(404, "Not Found");
+            return;
         }
+        request.headers = buffer_str.substr(0, header_end);
+        request.headers_lower = buffer_lower;
+        request.body = body;
+        route->handler(shared_from_this(), request);
     } catch (const std::exception& e) {
         log_error("REST API request handling error: " + std::string(e.what()));
         send_response(400, "Bad Request");
     }
 }
 
-void RestApiServer::HttpSession::handle_post_event(const std::string& body) {
-    try {
-        // Empty body check
-        if (body.empty()) {
-            log_error("POST /api/event received empty body");
-            send_json_response(400, std::string("Request body is empty"));
-            return;
-        }
+bool RestApiServer::HttpSession::admit_request(std::string_view headers,
+                                               std::string_view headers_lower) {
+    // Key by API key when the producer sends one, otherwise by source address
+    std::string client_key;
+    size_t key_pos = headers_lower.find("\r\nx-api-key:");
+    if (key_pos != std::string::npos) {
+        size_t value_start = key_pos + 12;
+        size_t value_end = headers.find("\r\n", value_start);
+        client_key = std::string(headers.substr(value_start, value_end - value_start));
+        client_key.erase(0, client_key.find_first_not_of(" \t"));
+        client_key.erase(client_key.find_last_not_of(" \t") + 1);
+        client_key = "key:" + client_key;
+    } else {
+        boost::system::error_code ec;
+        auto remote = socket_.remote_endpoint(ec);
+        client_key = ec ? std::string("addr:unknown") : "addr:" + remote.address().to_string();
+    }
 
-        log_info("REST API: Received body: " + body.substr(0, 100) + 
-                (body.length() > 100 ? "..." : ""));
+    auto decision = get_rate_limiter().check(client_key);
+    if (decision.allowed()) {
+        return true;
+    }
 
-        auto request_json = json::parse(body);
+    // Retry-After is whole seconds, rounded up
+    auto retry_after = std::chrono::ceil<std::chrono::seconds>(decision.retry_after);
+    if (retry_after.count() < 1) {
+        retry_after = std::chrono::seconds(1);
+    }
 
-        // Validate request format
-        if (!request_json.contains("type") || 
-            !request_json.contains("data")) {
-            send_json_response(400, std::string("Missing 'type' or 'data' field"));
-            return;
-        }
+    bool global = decision.result == RateLimitResult::global_limited;
+    static LogRateLimiter rate_limit_log(5);
+    if (rate_limit_log.allow()) {
+        log_warn(std::string("REST API: Rate limit exceeded (") +
+                 (global ? "global" : client_key) + "), retry after " +
+                 std::to_string(retry_after.count()) + "s" + rate_limit_log.suppressed_suffix());
+    }
 
-        // Create and publish event
-        Event event;
-        event.type = request_json["type"].get<std::string>();
-        event.timestamp = get_iso8601_timestamp();
-        event.payload = request_json["data"];
+    json response;
+    response["status"] = "error";
+    response["message"] = global ? "Server is over its event rate limit"
+                                 : "Client is over its event rate limit";
+    response["retry_after"] = retry_after.count();
+    send_response(429, response.dump(), "application/json",
+                  {{"Retry-After", std::to_string(retry_after.count())}});
+    return false;
+}
 
-        get_event_manager().publish_event(event);
+void RestApiServer::HttpSession::handle_post_event(const HttpRequest& request) {
+    if (request.body.empty()) {
+        static LogRateLimiter empty_body_log(5);
+        if (empty_body_log.allow()) {
+            log_warn("POST /api/event received empty body" + empty_body_log.suppressed_suffix());
+        }
+        send_json_response(400, std::string("Request body is empty"));
+        return;
+    }
+    auto self(shared_from_this());
+    auto response = ::handle_post_event(request.body, request.header("idempotency-key"),
+        [self](HttpResponse forwarded) { self->respond(std::move(forwarded)); });
+    if (response) {
+        respond(std::move(*response));
+    }
+}
 
-        // Send success response
-        json response;
-        response["status"] = "success";
-        response["message"] = "Event received and queued for broadcast";
-        response["event_type"] = event.type;
-        response["timestamp"] = event.timestamp;
+void RestApiServer::HttpSession::handle_get_state(const HttpRequest& request) {
+    auto type = request.params.path("type");
+    respond(::handle_get_state(type.value_or(std::string_view()), request.header("if-none-match")));
+}
 
-        send_json_response(200, response);
-        log_info("REST API: /api/event handled successfully");
-    } catch (const json::parse_error& e) {
-        log_error("JSON parse error: " + std::string(e.what()));
-        send_json_response(400, std::string("Invalid JSON format: ") + e.what());
-    } catch (const std::exception& e) {
-        log_error("Event handling error: " + std::string(e.what()));
-        send_json_response(500, std::string("Internal server error"));
-    }
+void RestApiServer::HttpSession::handle_stream() {
+    // The connection becomes an event stream and outlives this session
+    std::make_shared<SseSession>(std::move(socket_))->start();
+}
+
+void RestApiServer::HttpSession::respond(HttpResponse response, std::string content_type) {
+    // Inline on the session's own thread, posted there from any other
+    auto self(shared_from_this());
+    boost::asio::dispatch(socket_.get_executor(),
+        [this, self, response = std::move(response), content_type = std::move(content_type)]() {
+            send_response(response.status_code, response.body, content_type, response.headers);
+        });
 }
 
 void RestApiServer::HttpSession::send_json_response(int status_code, const json& response_body) {
@@ -237,7 +665,8 @@ void RestApiServer::HttpSession::send_json_response(int status_code, const std::
 }
 
 void RestApiServer::HttpSession::send_response(int status_code, const std::string& body,
-                      const std::string& content_type) {
+                      const std::string& content_type,
+                      const std::vector<std::pair<std::string, std::string>>& extra_headers) {
     try {
         std::ostringstream response;
 
@@ -245,30 +674,51 @@ void RestApiServer::HttpSession::send_response(int status_code, const std::strin
         response << "HTTP/1.1 " << status_code << " ";
         switch (status_code) {
             case 200: response << "OK"; break;
+            case 304: response << "Not Modified"; break;
             case 400: response << "Bad Request"; break;
             case 404: response << "Not Found"; break;
+            case 409: response << "Conflict"; break;
+            case 429: response << "Too Many Requests"; break;
             case 500: response << "Internal Server Error"; break;
+            case 503: response << "Service Unavailable"; break;
             default: response << "Error"; break;
         }
         response << "\r\n";
 
-        // Headers
-        response << "Content-Type: " << content_type << "\r\n";
-        response << "Content-Length: " << body.size() << "\r\n";
+        // Headers; a 304 has no body and must not describe one
+        if (status_code != 304) {
+            response << "Content-Type: " << content_type << "\r\n";
+            response << "Content-Length: " << body.size() << "\r\n";
+        }
+        for (const auto& header : extra_headers) {
+            response << header.first << ": " << header.second << "\r\n";
+        }
         response << "Connection: close\r\n";
         response << "\r\n";
 
-        // Body
-        response << body;
-
-        // Send response
-        auto response_str = response.str();
-        boost::asio::write(socket_,
-            boost::asio::buffer(response_str));
+        // Send headers and body with one gathered write, without copying the body
+        auto header_str = response.str();
+        std::array<boost::asio::const_buffer, 2> buffers = {
+            boost::asio::buffer(header_str),
+            boost::asio::buffer(body)
+        };
+        boost::asio::write(socket_, buffers);
+        rest_responses.add(header_str.size() + body.size());
+        if (status_code >= 400) {
+            rest_responses.add_error();
+        }
 
-        log_info("REST API: Response sent (status=" + std::to_string(status_code) + ")");
+        if (log_debug_enabled()) {
+            log_debug("REST API: Response sent (status=" + std::to_string(status_code) + ")");
+        }
     } catch (const std::exception& e) {
-        log_error("Response sending error: " + std::string(e.what()));
+        rest_responses.add_error();
+        flight_record(FlightEvent::error, 0, 0, static_cast<uint16_t>(FlightErrorSource::write));
+        static LogRateLimiter send_error_log(20);
+        if (send_error_log.allow()) {
+            log_error("Response sending error: " + std::string(e.what()) +
+                      send_error_log.suppressed_suffix());
+        }
     }
 
     // Close connection
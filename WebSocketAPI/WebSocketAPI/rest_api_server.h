@@ -1,31 +1,167 @@
 ﻿#pragma once
 
+#include "asio_config.h"
 #include "common.h"
 #include "event_manager.h"
+#include "http_router.h"
+#include "listener.h"
+#include "memory_pool.h"
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace beast = boost::beast;
 namespace http = beast::http;
 using boost::asio::ip::tcp;
 
+/**
+ * Request line and framing of an HTTP/1.1 request, as views into the read buffer
+ */
+struct HttpRequestHead {
+    std::string_view method;
+    std::string_view target;
+    size_t header_bytes = 0;     // Request line and headers, including the blank line
+    size_t content_length = 0;
+};
+
+/**
+ * Parse the request line and Content-Length from the start of a read buffer
+ * @param buffer Bytes received so far
+ * @param headers_lower Receives the header block lower-cased, for case-insensitive lookups
+ * @return false if the header block is not complete yet
+ */
+bool parse_request_head(std::string_view buffer, std::pmr::string& headers_lower,
+                        HttpRequestHead& out_head);
+
+/**
+ * A routed request, as views into the session's buffers
+ * Valid only during the handler call; an async handler copies what it
+ * needs before returning.
+ */
+struct HttpRequest {
+    HttpMethod method = HttpMethod::unknown;
+    std::string_view target;
+    std::string_view headers;        // Request line and header block
+    std::string_view headers_lower;  // The same, lower-cased
+    std::string_view body;
+    RouteParams params;
+
+    /**
+     * Value of a header with surrounding blanks trimmed, or empty if absent
+     * @param lower_name Header name in lower case
+     */
+    std::string_view header(std::string_view lower_name) const;
+};
+
+/**
+ * Response to an HTTP request, before framing
+ */
+struct HttpResponse {
+    int status_code = 200;
+    std::string body;
+    std::vector<std::pair<std::string, std::string>> headers;
+};
+
+/**
+ * Validate and publish the body of POST /api/event
+ * Everything but admission control and writing the response.
+ * @param idempotency_key Idempotency-Key header value; without one, an
+ *        "idempotency_key" body field is used. A key already published gets
+ *        the original response (see IdempotencyIndex), one being published 409.
+ * @param respond_later Lets a hot restart forward the event to the successor;
+ *        it gets the response once the successor answered, on another thread
+ * @return The response, or std::nullopt when respond_later will get it
+ */
+std::optional<HttpResponse> handle_post_event(std::string_view body,
+                                              std::string_view idempotency_key = {},
+                                              std::function<void(HttpResponse)> respond_later = nullptr);
+
+/**
+ * GET /api/state (type empty) and GET /api/state/{type} from the latest-state store
+ * Replies 304 when If-None-Match matches the current ETag and 404 for a type
+ * that has no state yet.
+ */
+HttpResponse handle_get_state(std::string_view type, std::string_view if_none_match);
+
 /**
  * REST API Server - Handles HTTP POST requests
  * Endpoint: POST /api/event
- * Payload: JSON with "type" and "data" fields
- * Response: JSON with "status" and "message" fields
+ * Payload: JSON with "type" and "data" fields, optional "priority" (high/normal/low)
+ *          and "idempotency_key" (or an Idempotency-Key header)
+ * Response: JSON with "status" and "message" fields; a retried key gets the original
+ *           response with Idempotent-Replayed: true
+ *           429 with Retry-After when the ingest rate limit is exceeded
+ *           503 with Retry-After when the event queue is over its high watermark
+ * Endpoint: GET /api/state, GET /api/state/{type}
+ * Response: latest event per type (and key) with an ETag; 304 on If-None-Match
+ * Endpoint: GET /api/stream
+ * Response: text/event-stream carrying every broadcast frame (see SseSession)
+ *
+ * Requests are dispatched through a route table (HttpRouter) built once;
+ * adding an endpoint is one RouteTable::add in route_table().
  */
 class RestApiServer {
 public:
-    RestApiServer(boost::asio::io_context& io_context, unsigned short port);
+    RestApiServer(boost::asio::io_context& io_context, unsigned short port,
+                  const ListenerConfig& listener = ListenerConfig{});
     ~RestApiServer();
 
+    unsigned short local_port() const;  // Bound port (useful when constructed with port 0)
+    uint64_t accepted_connections() const;
+
+    /**
+     * Listening sockets, first acceptor first, for a hot restart handoff
+     */
+    std::vector<int> listening_handles();
+
+    /**
+     * Close the listening sockets without touching open sessions (any thread)
+     * Connections still in the kernel backlog stay there for whoever else
+     * holds the socket.
+     */
+    void stop_accepting();
+
 private:
+    // Each acceptor serves its sessions on its own io_context
+    struct Acceptor {
+        boost::asio::io_context& io_context;
+        tcp::acceptor acceptor;
+    };
+
     boost::asio::io_context& io_context_;
-    tcp::acceptor acceptor_;
+    IoThreadPool accept_threads_;  // Runs the additional SO_REUSEPORT acceptors
+    std::vector<std::unique_ptr<Acceptor>> acceptors_;
+    std::atomic<uint64_t> accepted_{0};
+
+    void start_accept(Acceptor& acceptor);
+
+    class HttpSession;
+
+    // Runs on the session's thread. Responds before returning, or keeps the
+    // session and calls respond() later (from any thread) for an async reply.
+    using RouteHandler = std::function<void(const std::shared_ptr<HttpSession>&, const HttpRequest&)>;
+
+    struct Route {
+        RouteHandler handler;
+        bool rate_limited = false;  // Admission control before the body is read
+    };
+
+    struct RouteTable {
+        HttpRouter router;
+        std::vector<Route> routes;  // By route id
 
-    void start_accept();
+        void add(HttpMethod method, std::string_view pattern, RouteHandler handler,
+                 bool rate_limited = false);
+    };
+
+    static const RouteTable& route_table();
 
     // HTTP Session to handle a single connection
     class HttpSession : public std::enable_shared_from_this<HttpSession> {
@@ -37,17 +173,31 @@ private:
         tcp::socket& socket();
         void start();
 
+        // Route handlers
+        void handle_post_event(const HttpRequest& request);
+        void handle_get_state(const HttpRequest& request);
+        void handle_stream();
+
+        /**
+         * Send the response and close (any thread; runs on the session's thread)
+         */
+        void respond(HttpResponse response, std::string content_type = "application/json");
+
+        void send_json_response(int status_code, const json& response_body);
+        void send_json_response(int status_code, const std::string& message);
+        void send_response(int status_code, const std::string& body,
+                          const std::string& content_type = "text/plain",
+                          const std::vector<std::pair<std::string, std::string>>& extra_headers = {});
+
     private:
         tcp::socket socket_;
+        BufferPool::Handle read_buffer_;
         std::vector<char> buffer_;
         bool request_handled = false;
+        bool admission_checked_ = false;
 
         void read_request_body();
         void handle_request();
-        void handle_post_event(const std::string& body);
-        void send_json_response(int status_code, const json& response_body);
-        void send_json_response(int status_code, const std::string& message);
-        void send_response(int status_code, const std::string& body,
-                          const std::string& content_type = "text/plain");
+        bool admit_request(std::string_view headers, std::string_view headers_lower);
     };
 };
@@ -0,0 +1,339 @@
+﻿#include "server_config.h"
+#include "memory_pool.h"
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+// Serializes reloads (signal handler and console command)
+std::mutex reload_mutex;
+
+template <typename T>
+void read_value(const json& section, const char* key, T& out) {
+    if (section.contains(key)) {
+        out = section.at(key).get<T>();
+    }
+}
+
+template <typename Rep, typename Period>
+void read_duration(const json& section, const char* key, std::chrono::duration<Rep, Period>& out) {
+    if (section.contains(key)) {
+        out = std::chrono::duration<Rep, Period>(section.at(key).get<Rep>());
+    }
+}
+
+void read_listener(const json& section, unsigned short& port, ListenerConfig& listener) {
+    read_value(section, "port", port);
+    read_value(section, "backlog", listener.backlog);
+    read_value(section, "acceptors", listener.acceptor_count);
+}
+
+void read_rate_limit(const json& section, RateLimitConfig& config) {
+    read_value(section, "enabled", config.enabled);
+    read_value(section, "global_rate", config.global_rate);
+    read_value(section, "global_burst", config.global_burst);
+    read_value(section, "per_client_rate", config.per_client_rate);
+    read_value(section, "per_client_burst", config.per_client_burst);
+    read_value(section, "max_tracked_clients", config.max_tracked_clients);
+}
+
+void read_idempotency(const json& section, IdempotencyConfig& config) {
+    read_value(section, "enabled", config.enabled);
+    read_duration(section, "ttl_s", config.ttl);
+    read_value(section, "memory_budget_bytes", config.memory_budget_bytes);
+    read_value(section, "max_key_length", config.max_key_length);
+}
+
+void read_connection_limits(const json& section, ConnectionLimitConfig& config) {
+    read_value(section, "max_connections", config.max_connections);
+    read_value(section, "max_connections_per_ip", config.max_connections_per_ip);
+    read_value(section, "max_pending_handshakes", config.max_pending_handshakes);
+    read_duration(section, "handshake_timeout_ms", config.handshake_timeout);
+    read_value(section, "fd_pause_ratio", config.fd_pause_ratio);
+    read_duration(section, "accept_pause_ms", config.accept_pause);
+}
+
+void read_event_queue(const json& section, EventQueueConfig& config) {
+    read_value(section, "memory_budget_bytes", config.memory_budget_bytes);
+    read_value(section, "high_watermark", config.high_watermark);
+    read_value(section, "low_watermark", config.low_watermark);
+    read_value(section, "spill_file", config.spill_file_path);
+
+    if (section.contains("overflow_policy")) {
+        auto policy = section.at("overflow_policy").get<std::string>();
+        if (policy == "reject") {
+            config.overflow_policy = OverflowPolicy::reject;
+        } else if (policy == "spill") {
+            config.overflow_policy = OverflowPolicy::spill;
+        } else {
+            throw std::invalid_argument("unknown overflow_policy: " + policy);
+        }
+    }
+    if (section.contains("lane_weights")) {
+        config.lane_weights = section.at("lane_weights").get<LaneScheduler::Weights>();
+    }
+    if (section.contains("type_priorities")) {
+        config.type_priorities.clear();
+        for (const auto& [type, name] : section.at("type_priorities").items()) {
+            EventPriority priority;
+            if (!parse_event_priority(name.get<std::string>(), priority)) {
+                throw std::invalid_argument("unknown priority for type " + type);
+            }
+            config.type_priorities[type] = priority;
+        }
+    }
+    if (section.contains("type_ttl_ms")) {
+        config.type_ttls.clear();
+        for (const auto& [type, ttl] : section.at("type_ttl_ms").items()) {
+            if (!ttl.is_number_unsigned()) {
+                throw std::invalid_argument("invalid TTL for type " + type);
+            }
+            config.type_ttls[type] = std::chrono::milliseconds(ttl.get<uint64_t>());
+        }
+    }
+}
+
+void read_delta(const json& section, DeltaConfig& config) {
+    read_value(section, "max_keys", config.max_keys);
+    if (section.contains("types")) {
+        config.type_keys.clear();
+        for (const auto& [type, pointer] : section.at("types").items()) {
+            // Parse now so a bad pointer fails the load rather than the broadcast
+            json::json_pointer parsed(pointer.get<std::string>());
+            config.type_keys[type] = parsed.to_string();
+        }
+    }
+}
+
+void read_state(const json& section, StateConfig& config) {
+    read_value(section, "enabled", config.enabled);
+    read_value(section, "max_entries", config.max_entries);
+    read_value(section, "snapshot_on_connect", config.snapshot_on_connect);
+    if (section.contains("keys")) {
+        config.type_keys.clear();
+        for (const auto& [type, pointer] : section.at("keys").items()) {
+            json::json_pointer parsed(pointer.get<std::string>());
+            config.type_keys[type] = parsed.to_string();
+        }
+    }
+}
+
+void read_hot_restart(const json& section, HotRestartConfig& config) {
+    read_value(section, "enabled", config.enabled);
+    read_value(section, "socket_path", config.socket_path);
+    read_duration(section, "handoff_timeout_ms", config.handoff_timeout);
+    read_duration(section, "drain_window_ms", config.drain_window);
+    read_duration(section, "reconnect_jitter_ms", config.reconnect_jitter);
+}
+
+void read_ingest_capture(const json& section, IngestCaptureConfig& config) {
+    read_value(section, "enabled", config.enabled);
+    read_value(section, "path", config.path);
+    read_value(section, "max_file_bytes", config.max_file_bytes);
+    read_value(section, "buffer_bytes", config.buffer_bytes);
+    read_duration(section, "flush_interval_ms", config.flush_interval);
+}
+
+void validate(const ServerConfig& config) {
+    if (config.read_buffer_size == 0) {
+        throw std::invalid_argument("read_buffer_size must be positive");
+    }
+    if (config.broadcast_interval.count() <= 0) {
+        throw std::invalid_argument("broadcast_interval_ms must be positive");
+    }
+    if (config.keepalive_ping_interval.count() <= 0 ||
+        config.keepalive_timeout <= config.keepalive_ping_interval) {
+        throw std::invalid_argument("keepalive_timeout_s must exceed keepalive_ping_interval_s");
+    }
+    if (config.log_summary_interval.count() < 0) {
+        throw std::invalid_argument("log_summary_interval_s must not be negative");
+    }
+    if (config.rest_api_listener.acceptor_count == 0 || config.websocket_listener.acceptor_count == 0) {
+        throw std::invalid_argument("acceptors must be at least 1");
+    }
+    const auto& limits = config.connection_limits;
+    if (limits.handshake_timeout.count() <= 0 || limits.accept_pause.count() <= 0) {
+        throw std::invalid_argument("handshake_timeout_ms and accept_pause_ms must be positive");
+    }
+    if (limits.fd_pause_ratio < 0.0 || limits.fd_pause_ratio > 1.0) {
+        throw std::invalid_argument("fd_pause_ratio must be between 0 and 1");
+    }
+    const auto& hot_restart = config.hot_restart;
+    if (hot_restart.handoff_timeout.count() <= 0 || hot_restart.drain_window.count() < 0 ||
+        hot_restart.reconnect_jitter.count() < 0) {
+        throw std::invalid_argument("handoff_timeout_ms must be positive, drain_window_ms and "
+                                    "reconnect_jitter_ms not negative");
+    }
+    const auto& queue = config.event_queue;
+    if (queue.low_watermark < 0.0 || queue.high_watermark > 1.0 ||
+        queue.low_watermark > queue.high_watermark) {
+        throw std::invalid_argument("watermarks must satisfy 0 <= low <= high <= 1");
+    }
+    const auto& capture = config.ingest_capture;
+    if (capture.path.empty() || capture.buffer_bytes == 0 || capture.flush_interval.count() <= 0) {
+        throw std::invalid_argument("ingest_capture needs a path, buffer_bytes and flush_interval_ms");
+    }
+}
+
+void warn_restart_only(const ServerConfig& current, const ServerConfig& loaded) {
+    auto listener_changed = [](const ListenerConfig& a, const ListenerConfig& b) {
+        return a.backlog != b.backlog || a.acceptor_count != b.acceptor_count;
+    };
+    if (current.rest_api_port != loaded.rest_api_port ||
+        listener_changed(current.rest_api_listener, loaded.rest_api_listener)) {
+        log_warn("Config reload: rest_api port/backlog/acceptors change requires a restart");
+    }
+    if (current.websocket_port != loaded.websocket_port ||
+        listener_changed(current.websocket_listener, loaded.websocket_listener)) {
+        log_warn("Config reload: websocket port/backlog/acceptors change requires a restart");
+    }
+    const auto& a = current.hot_restart;
+    const auto& b = loaded.hot_restart;
+    if (a.enabled != b.enabled || a.socket_path != b.socket_path || a.handoff_timeout != b.handoff_timeout ||
+        a.drain_window != b.drain_window || a.reconnect_jitter != b.reconnect_jitter) {
+        log_warn("Config reload: hot_restart changes require a restart");
+    }
+}
+
+}  // namespace
+
+// RuntimeTunables implementation
+
+std::chrono::milliseconds RuntimeTunables::broadcast_interval() const {
+    return std::chrono::milliseconds(broadcast_interval_ms_.load(std::memory_order_relaxed));
+}
+
+std::chrono::seconds RuntimeTunables::keepalive_ping_interval() const {
+    return std::chrono::seconds(keepalive_ping_seconds_.load(std::memory_order_relaxed));
+}
+
+std::chrono::seconds RuntimeTunables::keepalive_timeout() const {
+    return std::chrono::seconds(keepalive_timeout_seconds_.load(std::memory_order_relaxed));
+}
+
+std::chrono::seconds RuntimeTunables::log_summary_interval() const {
+    return std::chrono::seconds(log_summary_seconds_.load(std::memory_order_relaxed));
+}
+
+size_t RuntimeTunables::slow_consumer_max_bytes() const {
+    return slow_consumer_max_bytes_.load(std::memory_order_relaxed);
+}
+
+bool RuntimeTunables::compact_sessions() const {
+    return compact_sessions_.load(std::memory_order_relaxed);
+}
+
+void RuntimeTunables::set(const ServerConfig& config) {
+    broadcast_interval_ms_ = config.broadcast_interval.count();
+    keepalive_ping_seconds_ = config.keepalive_ping_interval.count();
+    keepalive_timeout_seconds_ = config.keepalive_timeout.count();
+    log_summary_seconds_ = config.log_summary_interval.count();
+    slow_consumer_max_bytes_ = config.slow_consumer_max_bytes;
+    compact_sessions_ = config.compact_sessions;
+}
+
+RuntimeTunables& get_runtime_tunables() {
+    static RuntimeTunables instance;
+    return instance;
+}
+
+// Loading and applying
+
+ServerConfig load_server_config(const std::string& path) {
+    ServerConfig config;
+    std::ifstream config_stream(path);
+    if (!config_stream.good()) {
+        log_warn("Server config " + path + " not found, using defaults");
+        return config;
+    }
+
+    json document;
+    config_stream >> document;
+
+    if (document.contains("server")) {
+        const auto& server = document.at("server");
+        if (server.contains("rest_api")) {
+            read_listener(server.at("rest_api"), config.rest_api_port, config.rest_api_listener);
+        }
+        if (server.contains("websocket")) {
+            read_listener(server.at("websocket"), config.websocket_port, config.websocket_listener);
+        }
+        read_value(server, "read_buffer_size", config.read_buffer_size);
+        read_duration(server, "broadcast_interval_ms", config.broadcast_interval);
+        read_duration(server, "keepalive_ping_interval_s", config.keepalive_ping_interval);
+        read_duration(server, "keepalive_timeout_s", config.keepalive_timeout);
+        read_duration(server, "log_summary_interval_s", config.log_summary_interval);
+        read_value(server, "slow_consumer_max_bytes", config.slow_consumer_max_bytes);
+        read_value(server, "compact_sessions", config.compact_sessions);
+        read_value(server, "log_level", config.log_level);
+    }
+    if (document.contains("rate_limit")) {
+        read_rate_limit(document.at("rate_limit"), config.rate_limit);
+    }
+    if (document.contains("idempotency")) {
+        read_idempotency(document.at("idempotency"), config.idempotency);
+    }
+    if (document.contains("connection_limits")) {
+        read_connection_limits(document.at("connection_limits"), config.connection_limits);
+    }
+    if (document.contains("event_queue")) {
+        read_event_queue(document.at("event_queue"), config.event_queue);
+    }
+    if (document.contains("delta")) {
+        read_delta(document.at("delta"), config.delta);
+    }
+    if (document.contains("state")) {
+        read_state(document.at("state"), config.state);
+    }
+    if (document.contains("hot_restart")) {
+        read_hot_restart(document.at("hot_restart"), config.hot_restart);
+    }
+    if (document.contains("ingest_capture")) {
+        read_ingest_capture(document.at("ingest_capture"), config.ingest_capture);
+    }
+
+    validate(config);
+    return config;
+}
+
+void apply_server_config(const ServerConfig& config) {
+    get_rate_limiter().configure(config.rate_limit);
+    get_idempotency_index().configure(config.idempotency);
+    get_connection_limiter().configure(config.connection_limits);
+    get_event_manager().configure(config.event_queue);
+    get_delta_encoder().configure(config.delta);
+    get_state_store().configure(config.state);
+    get_ingest_capture().configure(config.ingest_capture);
+    get_read_buffer_pool().set_buffer_size(config.read_buffer_size);
+    get_runtime_tunables().set(config);
+    if (!config.log_level.empty() && !set_log_level(config.log_level)) {
+        log_warn("Unknown log level ignored: " + config.log_level);
+    }
+}
+
+bool reload_server_config(const std::string& path, ServerConfig& current) {
+    std::lock_guard<std::mutex> lock(reload_mutex);
+    try {
+        auto loaded = load_server_config(path);
+        warn_restart_only(current, loaded);
+
+        // Keep the running listener settings so later reloads compare against them
+        loaded.rest_api_port = current.rest_api_port;
+        loaded.rest_api_listener = current.rest_api_listener;
+        loaded.websocket_port = current.websocket_port;
+        loaded.websocket_listener = current.websocket_listener;
+        loaded.hot_restart = current.hot_restart;
+
+        apply_server_config(loaded);
+        current = loaded;
+        log_info("Server config reloaded from " + path +
+                 " (broadcast_interval_ms=" + std::to_string(loaded.broadcast_interval.count()) +
+                 ", read_buffer_size=" + std::to_string(loaded.read_buffer_size) +
+                 ", global_rate=" + std::to_string(loaded.rate_limit.global_rate) + ")");
+        return true;
+    } catch (const std::exception& e) {
+        log_error("Server config reload failed, keeping running config: " + std::string(e.what()));
+        return false;
+    }
+}
@@ -0,0 +1,95 @@
+﻿#pragma once
+
+#include "connection_limiter.h"
+#include "delta_encoder.h"
+#include "event_manager.h"
+#include "hot_restart.h"
+#include "idempotency.h"
+#include "ingest_capture.h"
+#include "listener.h"
+#include "rate_limiter.h"
+#include "state_store.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+
+/**
+ * Server settings read from server_config.json
+ * Every field is optional in the file; missing fields keep these defaults.
+ * Ports, listener and hot restart settings need a restart, everything else is applied
+ * again on reload (SIGHUP or the 'r' console command).
+ */
+struct ServerConfig {
+    // Restart only
+    unsigned short rest_api_port = 8080;
+    unsigned short websocket_port = 8081;
+    ListenerConfig rest_api_listener{.backlog = 4096, .acceptor_count = 1};
+    ListenerConfig websocket_listener{.backlog = 4096, .acceptor_count = 1};
+    HotRestartConfig hot_restart;
+
+    // Reloadable
+    size_t read_buffer_size = 8192;
+    std::chrono::milliseconds broadcast_interval{50};
+    std::chrono::seconds keepalive_ping_interval{10};
+    std::chrono::seconds keepalive_timeout{30};
+    std::chrono::seconds log_summary_interval{10};  // 0 disables the summary line
+    size_t slow_consumer_max_bytes = 8 * 1024 * 1024;  // Per subscriber backlog; 0 is unlimited
+    bool compact_sessions = false;  // Minimal idle WebSocket sessions; applies to new connections
+    std::string log_level;  // Empty keeps the level from logging_config.json
+    RateLimitConfig rate_limit;
+    IdempotencyConfig idempotency;
+    ConnectionLimitConfig connection_limits;
+    EventQueueConfig event_queue{.overflow_policy = OverflowPolicy::spill};
+    DeltaConfig delta;
+    StateConfig state;
+    IngestCaptureConfig ingest_capture;  // Starts, stops or switches files on reload
+};
+
+/**
+ * Intervals read on the hot path, updated atomically by apply_server_config
+ */
+class RuntimeTunables {
+public:
+    std::chrono::milliseconds broadcast_interval() const;
+    std::chrono::seconds keepalive_ping_interval() const;
+    std::chrono::seconds keepalive_timeout() const;
+    std::chrono::seconds log_summary_interval() const;
+    size_t slow_consumer_max_bytes() const;
+    bool compact_sessions() const;
+
+    void set(const ServerConfig& config);
+
+private:
+    std::atomic<int64_t> broadcast_interval_ms_{50};
+    std::atomic<int64_t> keepalive_ping_seconds_{10};
+    std::atomic<int64_t> keepalive_timeout_seconds_{30};
+    std::atomic<int64_t> log_summary_seconds_{10};
+    std::atomic<size_t> slow_consumer_max_bytes_{8 * 1024 * 1024};
+    std::atomic<bool> compact_sessions_{false};
+};
+
+// Global tunables instance
+RuntimeTunables& get_runtime_tunables();
+
+/**
+ * Load settings from a JSON file
+ * A missing file yields the defaults; a malformed file or invalid value throws.
+ * @param path Path to server_config.json
+ */
+ServerConfig load_server_config(const std::string& path);
+
+/**
+ * Apply the reloadable settings: rate and connection limits, idempotency index, queue budget, buffer size,
+ * intervals, delta-encoded types, latest-state view, ingest capture and log level. Open connections are left untouched.
+ */
+void apply_server_config(const ServerConfig& config);
+
+/**
+ * Re-read the file and apply it on top of the running configuration
+ * Restart-only changes are logged and ignored. On error the running
+ * configuration stays in place.
+ * @param path Path to server_config.json
+ * @param current Running configuration, updated on success
+ * @return true if the file was loaded and applied
+ */
+bool reload_server_config(const std::string& path, ServerConfig& current);
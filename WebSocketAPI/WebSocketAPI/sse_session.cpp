@@ -0,0 +1,237 @@
+﻿#include "sse_session.h"
+#include "event_manager.h"
+#include "flight_recorder.h"
+#include "memory_pool.h"
+#include "server_config.h"
+#include <algorithm>
+#include <string>
+
+namespace {
+
+LogCounter sse_streams("sse_streams");
+LogCounter sse_sent("sse_sent");
+LogCounter sse_slow_consumers("sse_slow_consumers");
+
+LogRateLimiter sse_log(10);
+
+const std::string SSE_RESPONSE_HEAD =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: keep-alive\r\n"
+    "X-Accel-Buffering: no\r\n"
+    "\r\n";
+const std::string SSE_DATA_PREFIX = "data: ";
+const std::string SSE_EVENT_END = "\n\n";
+const std::string SSE_KEEPALIVE = ":\n\n";
+
+}  // namespace
+
+SseSession::SseSession(tcp::socket socket)
+    : socket_(std::move(socket)),
+      keepalive_timer_(socket_.get_executor()) {}
+
+void SseSession::start() {
+    auto self(shared_from_this());
+    write_in_progress_ = true;
+    boost::asio::async_write(
+        socket_,
+        boost::asio::buffer(SSE_RESPONSE_HEAD),
+        [this, self](const boost::system::error_code& ec, std::size_t) {
+            write_in_progress_ = false;
+            if (ec) {
+                close();
+                return;
+            }
+            sse_streams.add();
+            // Frames start flowing once the broadcaster has sent the snapshots
+            get_subscriber_hub().join(self);
+            watch_disconnect();
+            schedule_keepalive();
+        });
+}
+
+void SseSession::deliver(const SharedFrame& frame, EventPriority priority,
+                         std::chrono::steady_clock::time_point published_at,
+                         std::chrono::steady_clock::time_point expires_at) {
+    bool post_flush = false;
+    bool overflowed = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) {
+            return;
+        }
+        size_t limit = get_runtime_tunables().slow_consumer_max_bytes();
+        if (limit > 0 && queued_bytes_ + frame->size() > limit + snapshot_allowance_) {
+            closed_ = true;
+            pending_.clear();
+            overflowed = true;
+        } else {
+            pending_.push_back(QueuedFrame{frame, priority, published_at, expires_at});
+            queued_bytes_ += frame->size();
+            post_flush = !flush_posted_;
+            flush_posted_ = true;
+        }
+    }
+
+    if (overflowed) {
+        sse_slow_consumers.add();
+        if (sse_log.allow()) {
+            log_warn("SSE stream closed: backlog over slow_consumer_max_bytes" +
+                     sse_log.suppressed_suffix());
+        }
+        boost::asio::post(socket_.get_executor(), [self = shared_from_this()]() { self->close(); });
+    } else if (post_flush) {
+        boost::asio::post(socket_.get_executor(), [self = shared_from_this()]() { self->flush(); });
+    }
+}
+
+void SseSession::deliver_snapshot(const std::vector<SharedFrame>& frames) {
+    if (frames.empty()) {
+        return;
+    }
+    bool post_flush = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) {
+            return;
+        }
+        for (const auto& frame : frames) {
+            pending_.push_back(QueuedFrame{frame, EventPriority::high, {}, {}});
+            queued_bytes_ += frame->size();
+            snapshot_allowance_ += frame->size();
+        }
+        post_flush = !flush_posted_;
+        flush_posted_ = true;
+    }
+    if (post_flush) {
+        boost::asio::post(socket_.get_executor(), [self = shared_from_this()]() { self->flush(); });
+    }
+}
+
+void SseSession::flush() {
+    if (write_in_progress_) {
+        return;  // The running write flushes again when it completes
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flush_posted_ = false;
+        if (closed_ || pending_.empty()) {
+            return;
+        }
+        writing_.swap(pending_);
+
+        // Frames that went stale while the previous write was in flight
+        auto now = std::chrono::steady_clock::now();
+        auto stale = std::remove_if(writing_.begin(), writing_.end(), [&](const QueuedFrame& queued) {
+            if (queued.expires_at == std::chrono::steady_clock::time_point{} || now < queued.expires_at) {
+                return false;
+            }
+            queued_bytes_ -= queued.data->size();
+            get_event_manager().record_expired_delivery(queued.data->size());
+            return true;
+        });
+        writing_.erase(stale, writing_.end());
+        if (writing_.empty()) {
+            return;
+        }
+    }
+
+    // Reference the shared frames in place: "data: " frame "\n\n" for each
+    write_buffers_.clear();
+    for (const auto& queued : writing_) {
+        write_buffers_.push_back(boost::asio::buffer(SSE_DATA_PREFIX));
+        write_buffers_.push_back(boost::asio::buffer(*queued.data));
+        write_buffers_.push_back(boost::asio::buffer(SSE_EVENT_END));
+    }
+
+    auto self(shared_from_this());
+    write_in_progress_ = true;
+    boost::asio::async_write(
+        socket_,
+        write_buffers_,
+        make_recycling_handler(
+        [this, self](const boost::system::error_code& ec, std::size_t bytes_transferred) {
+            write_in_progress_ = false;
+            if (ec) {
+                sse_sent.add_error();
+                flight_record(FlightEvent::error, 0, ec.value(),
+                              static_cast<uint16_t>(FlightErrorSource::write));
+                close();
+                return;
+            }
+            sse_sent.add(bytes_transferred);
+
+            size_t frame_bytes = 0;
+            auto now = std::chrono::steady_clock::now();
+            for (const auto& queued : writing_) {
+                frame_bytes += queued.data->size();
+                if (queued.published_at != std::chrono::steady_clock::time_point{}) {
+                    get_event_manager().record_delivery_latency(queued.priority,
+                                                                now - queued.published_at);
+                }
+            }
+            writing_.clear();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                queued_bytes_ -= frame_bytes;
+                if (queued_bytes_ == 0) {
+                    snapshot_allowance_ = 0;
+                }
+            }
+            wrote_since_keepalive_ = true;
+            flush();
+        }));
+}
+
+void SseSession::watch_disconnect() {
+    // Clients never send on an event stream; a read only ends with the connection
+    auto self(shared_from_this());
+    socket_.async_read_some(
+        boost::asio::buffer(discard_buffer_),
+        [this, self](const boost::system::error_code& ec, std::size_t) {
+            if (ec) {
+                close();
+                return;
+            }
+            watch_disconnect();
+        });
+}
+
+void SseSession::schedule_keepalive() {
+    auto self(shared_from_this());
+    keepalive_timer_.expires_after(get_runtime_tunables().keepalive_ping_interval());
+    keepalive_timer_.async_wait([this, self](const boost::system::error_code& ec) {
+        if (ec) {
+            return;
+        }
+        if (!wrote_since_keepalive_ && !write_in_progress_) {
+            write_in_progress_ = true;
+            boost::asio::async_write(
+                socket_,
+                boost::asio::buffer(SSE_KEEPALIVE),
+                [this, self](const boost::system::error_code& write_ec, std::size_t) {
+                    write_in_progress_ = false;
+                    if (write_ec) {
+                        close();
+                        return;
+                    }
+                    flush();
+                });
+        }
+        wrote_since_keepalive_ = false;
+        schedule_keepalive();
+    });
+}
+
+void SseSession::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        pending_.clear();
+    }
+    get_subscriber_hub().leave(this);
+    keepalive_timer_.cancel();
+    boost::system::error_code ec;
+    socket_.close(ec);
+}
@@ -0,0 +1,71 @@
+﻿#pragma once
+
+#include "asio_config.h"
+#include "subscriber_hub.h"
+#include <boost/asio.hpp>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using boost::asio::ip::tcp;
+
+/**
+ * Server-Sent Events stream for GET /api/stream
+ *
+ * Receives the same frames as the WebSocket clients, through the broadcaster's
+ * fan-out (SubscriberHub), and writes each one as "data: <frame>\n\n" with a
+ * gathered write that references the shared frame instead of copying it.
+ * Frames are queued under a small mutex by the broadcaster thread and
+ * written on the session's own io_context, one async_write per batch.
+ * A stream whose backlog exceeds slow_consumer_max_bytes is closed, like a
+ * WebSocket client. A comment line every keepalive_ping_interval keeps
+ * proxies from timing the stream out.
+ */
+class SseSession : public BroadcastSubscriber, public std::enable_shared_from_this<SseSession> {
+public:
+    explicit SseSession(tcp::socket socket);
+
+    /**
+     * Send the response head and subscribe
+     */
+    void start();
+
+    void deliver(const SharedFrame& frame, EventPriority priority,
+                 std::chrono::steady_clock::time_point published_at,
+                 std::chrono::steady_clock::time_point expires_at) override;
+    void deliver_snapshot(const std::vector<SharedFrame>& frames) override;
+
+private:
+    struct QueuedFrame {
+        SharedFrame data;
+        EventPriority priority;
+        std::chrono::steady_clock::time_point published_at;
+        std::chrono::steady_clock::time_point expires_at;
+    };
+
+    tcp::socket socket_;
+    boost::asio::steady_timer keepalive_timer_;
+    std::array<char, 64> discard_buffer_;
+
+    // Shared with the broadcaster thread
+    std::mutex mutex_;
+    std::vector<QueuedFrame> pending_;
+    size_t queued_bytes_ = 0;
+    size_t snapshot_allowance_ = 0;  // Initial snapshot bytes, on top of slow_consumer_max_bytes
+    bool flush_posted_ = false;
+    bool closed_ = false;
+
+    // Session thread only
+    std::vector<QueuedFrame> writing_;
+    std::vector<boost::asio::const_buffer> write_buffers_;
+    bool write_in_progress_ = false;
+    bool wrote_since_keepalive_ = false;
+
+    void flush();
+    void watch_disconnect();
+    void schedule_keepalive();
+    void close();
+};
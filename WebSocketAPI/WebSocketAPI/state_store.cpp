@@ -0,0 +1,218 @@
+﻿#include "state_store.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+
+namespace {
+
+// Random per process. Versions start again from 0 in every process, a hot
+// restart successor included, so the ETag carries this to stay unique.
+uint64_t process_epoch() {
+    static const uint64_t epoch = [] {
+        std::random_device device;
+        uint64_t value = (static_cast<uint64_t>(device()) << 32) ^ device();
+        return value ^ static_cast<uint64_t>(
+            std::chrono::system_clock::now().time_since_epoch().count());
+    }();
+    return epoch;
+}
+
+// Object keys are strings as-is; other key values use their JSON text
+std::string key_text(const json& value) {
+    return value.is_string() ? value.get<std::string>() : value.dump();
+}
+
+void append_frames(std::string& body, const StateStore::TypeState& state, bool& first) {
+    state.for_each_frame([&](const SharedFrame& frame) {
+        if (!first) {
+            body += ',';
+        }
+        first = false;
+        body += *frame;
+    });
+}
+
+}  // namespace
+
+StateStore::StateStore() {
+    published_.store(std::make_shared<const Snapshot>());
+}
+
+void StateStore::configure(const StateConfig& config) {
+    std::unordered_map<std::string, json::json_pointer> pointers;
+    for (const auto& [type, pointer] : config.type_keys) {
+        pointers.emplace(type, json::json_pointer(pointer));
+    }
+
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    for (auto it = staged_.begin(); it != staged_.end();) {
+        auto old_key = config_.type_keys.find(it->first);
+        auto new_key = config.type_keys.find(it->first);
+        bool old_keyed = old_key != config_.type_keys.end();
+        bool new_keyed = new_key != config.type_keys.end();
+        if (!config.enabled || old_keyed != new_keyed ||
+            (old_keyed && old_key->second != new_key->second)) {
+            entries_ -= it->second.size;
+            dirty_.insert(it->first);
+            it = staged_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    config_ = config;
+    pointers_ = std::move(pointers);
+    enabled_ = config.enabled;
+    snapshot_on_connect_ = config.snapshot_on_connect;
+}
+
+bool StateStore::enabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+}
+
+bool StateStore::snapshot_on_connect() const {
+    return snapshot_on_connect_.load(std::memory_order_relaxed);
+}
+
+void StateStore::update(const Event& event, SharedFrame frame) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    if (!config_.enabled) {
+        return;
+    }
+
+    std::string key;
+    auto pointer = pointers_.find(event.type);
+    if (pointer != pointers_.end()) {
+        if (!event.payload.contains(pointer->second)) {
+            return;  // Keyed type without its key: nothing to index it by
+        }
+        key = key_text(event.payload.at(pointer->second));
+    }
+
+    auto& staged = staged_[event.type];
+    if (staged.buckets.empty()) {
+        size_t count = pointer != pointers_.end() ? KEY_BUCKETS : 1;
+        staged.buckets.resize(count);
+        staged.cloned.assign(count, false);
+    }
+    size_t index = std::hash<std::string>{}(key) % staged.buckets.size();
+    auto& bucket = staged.buckets[index];
+    bool present = bucket && bucket->count(key) != 0;
+    if (!present && entries_ >= config_.max_entries) {
+        dropped_++;
+        if (staged.size == 0) {
+            staged_.erase(event.type);
+        }
+        return;
+    }
+
+    // The published snapshot may share this bucket: write to a copy
+    if (!staged.cloned[index]) {
+        bucket = bucket ? std::make_shared<TypeState::Bucket>(*bucket)
+                        : std::make_shared<TypeState::Bucket>();
+        staged.cloned[index] = true;
+    }
+    (*bucket)[std::move(key)] = std::move(frame);
+    if (!present) {
+        staged.size++;
+        entries_++;
+    }
+    dirty_.insert(event.type);
+    updates_++;
+}
+
+void StateStore::commit() {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    if (dirty_.empty()) {
+        return;
+    }
+
+    // Unchanged types, and unchanged buckets of changed types, are shared
+    // with the previous snapshot
+    auto current = published_.load();
+    auto next = std::make_shared<Snapshot>(*current);
+    next->version = current->version + 1;
+    for (const auto& type : dirty_) {
+        auto staged = staged_.find(type);
+        if (staged == staged_.end()) {
+            next->types.erase(type);
+            continue;
+        }
+        auto state = std::make_shared<TypeState>();
+        state->version = next->version;
+        state->size = staged->second.size;
+        state->buckets.assign(staged->second.buckets.begin(), staged->second.buckets.end());
+        std::fill(staged->second.cloned.begin(), staged->second.cloned.end(), false);
+        next->types[type] = std::move(state);
+    }
+    dirty_.clear();
+    published_.store(std::move(next));
+}
+
+std::shared_ptr<const StateStore::Snapshot> StateStore::snapshot() const {
+    return published_.load();
+}
+
+StateStore::Stats StateStore::get_stats() const {
+    auto current = snapshot();
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    return Stats{current->version, current->types.size(), entries_, updates_, dropped_};
+}
+
+StateStore& get_state_store() {
+    static StateStore instance;
+    return instance;
+}
+
+std::string state_etag(uint64_t version) {
+    char buffer[48];
+    std::snprintf(buffer, sizeof(buffer), "\"%016llx-%llu\"",
+                  static_cast<unsigned long long>(process_epoch()),
+                  static_cast<unsigned long long>(version));
+    return buffer;
+}
+
+bool etag_matches(std::string_view if_none_match, const std::string& etag) {
+    // Comma-separated list; weak comparison, as If-None-Match requires
+    size_t pos = 0;
+    while (pos < if_none_match.size()) {
+        size_t end = if_none_match.find(',', pos);
+        if (end == std::string_view::npos) {
+            end = if_none_match.size();
+        }
+        std::string_view candidate = if_none_match.substr(pos, end - pos);
+        size_t first = candidate.find_first_not_of(" \t");
+        size_t last = candidate.find_last_not_of(" \t");
+        if (first != std::string_view::npos) {
+            candidate = candidate.substr(first, last - first + 1);
+            if (candidate.substr(0, 2) == "W/") {
+                candidate.remove_prefix(2);
+            }
+            if (candidate == "*" || candidate == etag) {
+                return true;
+            }
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+std::string render_state(const StateStore::Snapshot& snapshot) {
+    std::string body = "{\"version\":" + std::to_string(snapshot.version) + ",\"events\":[";
+    bool first = true;
+    for (const auto& [type, state] : snapshot.types) {
+        append_frames(body, *state, first);
+    }
+    body += "]}";
+    return body;
+}
+
+std::string render_type_state(const std::string& type, const StateStore::TypeState& state) {
+    std::string body = "{\"type\":" + json(type).dump() +
+                       ",\"version\":" + std::to_string(state.version) + ",\"events\":[";
+    bool first = true;
+    append_frames(body, state, first);
+    body += "]}";
+    return body;
+}
@@ -0,0 +1,156 @@
+﻿#pragma once
+
+#include "common.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Which events the latest-state view keeps
+ * Every type keeps its latest event; type_keys lists types that keep the
+ * latest event per key instead, with the JSON pointer (into "data") that
+ * identifies the key, e.g. {"device_state": "/device_id"}.
+ */
+struct StateConfig {
+    bool enabled = true;
+    std::unordered_map<std::string, std::string> type_keys;
+    size_t max_entries = 65536;       // Entries kept at once; further keys are not stored
+    bool snapshot_on_connect = false; // Send the view to every new WebSocket client
+};
+
+/**
+ * Materialized view of the latest event per type (or per type and key)
+ *
+ * Entries are the serialized broadcast frames, shared with the broadcast
+ * itself. The broadcaster stages updates and publishes them once per batch
+ * as a new immutable Snapshot, swapped in atomically, so readers (REST
+ * threads, new subscribers) never take a lock the broadcaster holds and a
+ * reader keeps a consistent view for as long as it holds the snapshot.
+ * Keyed types are split into KEY_BUCKETS buckets by key hash; a commit
+ * copies only the buckets that changed in the batch and shares the rest
+ * with the previous snapshot.
+ */
+class StateStore {
+public:
+    static constexpr size_t KEY_BUCKETS = 256;  // Types kept per type use one
+
+    struct TypeState {
+        using Bucket = std::map<std::string, SharedFrame>;  // By key; "" for types kept per type
+
+        uint64_t version = 0;  // Snapshot version that last changed this type
+        size_t size = 0;
+        std::vector<std::shared_ptr<const Bucket>> buckets;  // Null until a key lands in it
+
+        template <typename Fn>
+        void for_each_frame(Fn&& fn) const {
+            for (const auto& bucket : buckets) {
+                if (bucket) {
+                    for (const auto& [key, frame] : *bucket) {
+                        fn(frame);
+                    }
+                }
+            }
+        }
+    };
+
+    struct Snapshot {
+        uint64_t version = 0;
+        std::map<std::string, std::shared_ptr<const TypeState>> types;
+    };
+
+    struct Stats {
+        uint64_t version;
+        size_t types;
+        size_t entries;
+        uint64_t updates;
+        uint64_t dropped;   // Events whose key did not fit max_entries
+    };
+
+    StateStore();
+
+    StateStore(const StateStore&) = delete;
+    StateStore& operator=(const StateStore&) = delete;
+
+    /**
+     * Apply settings; types whose key pointer changed start over
+     */
+    void configure(const StateConfig& config);
+
+    bool enabled() const;
+    bool snapshot_on_connect() const;
+
+    /**
+     * Stage the frame of a broadcast event; visible after the next commit
+     * @param frame Serialized event as broadcast (Event::to_string)
+     */
+    void update(const Event& event, SharedFrame frame);
+
+    /**
+     * Publish staged updates as a new snapshot (no-op when nothing changed)
+     */
+    void commit();
+
+    /**
+     * Current snapshot; never null
+     */
+    std::shared_ptr<const Snapshot> snapshot() const;
+
+    Stats get_stats() const;
+
+private:
+    // Buckets are shared with the published snapshot until the first update
+    // of a batch clones them; only cloned buckets are written
+    struct StagedType {
+        std::vector<std::shared_ptr<TypeState::Bucket>> buckets;
+        std::vector<bool> cloned;
+        size_t size = 0;
+    };
+
+    // Writer side: staging area, touched only under writer_mutex_
+    mutable std::mutex writer_mutex_;
+    StateConfig config_;
+    std::unordered_map<std::string, json::json_pointer> pointers_;
+    std::map<std::string, StagedType> staged_;
+    std::set<std::string> dirty_;
+    size_t entries_ = 0;
+    uint64_t updates_ = 0;
+    uint64_t dropped_ = 0;
+
+    std::atomic<bool> enabled_{true};
+    std::atomic<bool> snapshot_on_connect_{false};
+    std::atomic<std::shared_ptr<const Snapshot>> published_;
+};
+
+/**
+ * Get global state store instance
+ */
+StateStore& get_state_store();
+
+/**
+ * Strong ETag for a snapshot or type version, e.g. "\"3f0c9a6e51d27b84-42\""
+ * The first part identifies the process, so tags never repeat across restarts.
+ */
+std::string state_etag(uint64_t version);
+
+/**
+ * True if an If-None-Match header value matches the ETag
+ * Handles lists, weak validators and "*".
+ */
+bool etag_matches(std::string_view if_none_match, const std::string& etag);
+
+/**
+ * JSON body for GET /api/state: {"version": N, "events": [frames...]}
+ */
+std::string render_state(const StateStore::Snapshot& snapshot);
+
+/**
+ * JSON body for GET /api/state/{type}: {"type": ..., "version": N, "events": [frames...]}
+ */
+std::string render_type_state(const std::string& type, const StateStore::TypeState& state);
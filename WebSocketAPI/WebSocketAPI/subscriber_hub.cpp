@@ -0,0 +1,61 @@
+﻿#include "subscriber_hub.h"
+#include <algorithm>
+
+namespace {
+
+void remove_subscriber(std::vector<SubscriberHub::SubscriberPtr>& list,
+                       const BroadcastSubscriber* subscriber) {
+    list.erase(std::remove_if(list.begin(), list.end(),
+                   [subscriber](const SubscriberHub::SubscriberPtr& s) { return s.get() == subscriber; }),
+               list.end());
+}
+
+}  // namespace
+
+void SubscriberHub::join(SubscriberPtr subscriber) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    joining_.push_back(std::move(subscriber));
+}
+
+void SubscriberHub::leave(const BroadcastSubscriber* subscriber) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    remove_subscriber(joining_, subscriber);
+    remove_subscriber(taken_, subscriber);
+    remove_subscriber(active_, subscriber);
+}
+
+std::vector<SubscriberHub::SubscriberPtr> SubscriberHub::take_joining() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (joining_.empty()) {
+        return {};
+    }
+    std::vector<SubscriberPtr> joining;
+    joining.swap(joining_);
+    taken_.insert(taken_.end(), joining.begin(), joining.end());
+    return joining;
+}
+
+void SubscriberHub::activate(const SubscriberPtr& subscriber) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find(taken_.begin(), taken_.end(), subscriber);
+    if (it == taken_.end()) {
+        return;  // Left while its snapshots were being sent
+    }
+    taken_.erase(it);
+    active_.push_back(subscriber);
+}
+
+void SubscriberHub::snapshot(std::pmr::vector<SubscriberPtr>& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out.insert(out.end(), active_.begin(), active_.end());
+}
+
+size_t SubscriberHub::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return active_.size();
+}
+
+SubscriberHub& get_subscriber_hub() {
+    static SubscriberHub instance;
+    return instance;
+}
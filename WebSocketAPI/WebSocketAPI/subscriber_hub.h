@@ -0,0 +1,89 @@
+﻿#pragma once
+
+#include "common.h"
+#include <chrono>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+/**
+ * A broadcast receiver that lives outside the WebSocket server's io_context
+ * (Server-Sent Events streams on the REST threads)
+ * deliver() is called on the broadcaster thread with the frame every
+ * WebSocket client gets; implementations hand it to their own thread, and
+ * drop it if it is still queued at expires_at (unless zero).
+ */
+class BroadcastSubscriber {
+public:
+    virtual ~BroadcastSubscriber() = default;
+
+    virtual void deliver(const SharedFrame& frame, EventPriority priority,
+                         std::chrono::steady_clock::time_point published_at,
+                         std::chrono::steady_clock::time_point expires_at) = 0;
+
+    /**
+     * The initial snapshot, before any deliver(); a large snapshot must not
+     * get a new subscriber closed as a slow consumer, so the backlog limit
+     * is raised by its size until the queue first drains
+     */
+    virtual void deliver_snapshot(const std::vector<SharedFrame>& frames) = 0;
+};
+
+/**
+ * Subscribers that join the WebSocket server's fan-out from other threads
+ *
+ * Joining is two-step: join() queues the subscriber, and the broadcaster
+ * takes the queue at the start of its next batch, sends the initial delta
+ * and state snapshots, then activates it. A subscriber therefore sees its
+ * snapshots and every later frame in broadcast order, exactly like a
+ * WebSocket client registered on the broadcaster thread.
+ */
+class SubscriberHub {
+public:
+    using SubscriberPtr = std::shared_ptr<BroadcastSubscriber>;
+
+    SubscriberHub() = default;
+
+    SubscriberHub(const SubscriberHub&) = delete;
+    SubscriberHub& operator=(const SubscriberHub&) = delete;
+
+    /**
+     * Queue a subscriber for the next broadcast batch (any thread)
+     */
+    void join(SubscriberPtr subscriber);
+
+    /**
+     * Remove a subscriber, queued or active (any thread)
+     */
+    void leave(const BroadcastSubscriber* subscriber);
+
+    /**
+     * Broadcaster thread: subscribers queued since the last call
+     */
+    std::vector<SubscriberPtr> take_joining();
+
+    /**
+     * Broadcaster thread: start delivering to a subscriber from take_joining
+     * Ignored when it left in the meantime.
+     */
+    void activate(const SubscriberPtr& subscriber);
+
+    /**
+     * Broadcaster thread: active subscribers, appended to out
+     */
+    void snapshot(std::pmr::vector<SubscriberPtr>& out) const;
+
+    size_t size() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<SubscriberPtr> joining_;
+    std::vector<SubscriberPtr> active_;
+    std::vector<SubscriberPtr> taken_;  // Handed to the broadcaster, not active yet
+};
+
+/**
+ * Get global subscriber hub instance
+ */
+SubscriberHub& get_subscriber_hub();
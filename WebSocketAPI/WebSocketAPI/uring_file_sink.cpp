@@ -0,0 +1,108 @@
+﻿#include "uring_file_sink.h"
+
+#if defined(WEBSOCKETAPI_IO_URING)
+
+#include <spdlog/sinks/rotating_file_sink.h>
+#include <cstdio>
+#include <filesystem>
+
+UringFileSink::UringFileSink(std::string base_filename, size_t max_size, size_t max_files)
+    : base_filename_(std::move(base_filename)),
+      max_size_(max_size),
+      max_files_(max_files),
+      io_context_(1),
+      work_guard_(boost::asio::make_work_guard(io_context_)),
+      file_(io_context_) {
+    std::error_code ec;
+    auto directory = std::filesystem::path(base_filename_).parent_path();
+    if (!directory.empty()) {
+        std::filesystem::create_directories(directory, ec);
+    }
+    open_file(false);
+    io_thread_ = std::thread([this]() { io_context_.run(); });
+}
+
+UringFileSink::~UringFileSink() {
+    wait_drained();
+    work_guard_.reset();
+    io_thread_.join();
+    boost::system::error_code ec;
+    file_.close(ec);
+}
+
+void UringFileSink::sink_it_(const spdlog::details::log_msg& msg) {
+    spdlog::memory_buf_t formatted;
+    formatter_->format(msg, formatted);
+
+    if (current_size_ + formatted.size() > max_size_) {
+        rotate();
+    }
+    current_size_ += formatted.size();
+
+    std::lock_guard<std::mutex> lock(buffer_mutex_);
+    pending_.append(formatted.data(), formatted.size());
+    if (!write_in_flight_) {
+        write_in_flight_ = true;
+        boost::asio::post(io_context_, [this]() { write_next(); });
+    }
+}
+
+void UringFileSink::flush_() {
+    wait_drained();
+}
+
+void UringFileSink::open_file(bool truncate) {
+    auto flags = boost::asio::file_base::write_only | boost::asio::file_base::create |
+                 (truncate ? boost::asio::file_base::truncate : boost::asio::file_base::append);
+    file_.open(base_filename_, flags);
+    current_size_ = truncate ? 0 : static_cast<size_t>(file_.size());
+}
+
+// Runs on the I/O thread
+void UringFileSink::write_next() {
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        if (pending_.empty()) {
+            write_in_flight_ = false;
+            drained_.notify_all();
+            return;
+        }
+        writing_.clear();
+        writing_.swap(pending_);
+    }
+
+    boost::asio::async_write(file_, boost::asio::buffer(writing_),
+        [this](const boost::system::error_code& ec, std::size_t) {
+            if (ec) {
+                // The logger cannot log its own failure; report once per failed write
+                std::fprintf(stderr, "Log file write failed: %s\n", ec.message().c_str());
+            }
+            write_next();
+        });
+}
+
+void UringFileSink::wait_drained() {
+    std::unique_lock<std::mutex> lock(buffer_mutex_);
+    drained_.wait(lock, [this]() { return !write_in_flight_; });
+}
+
+// Called with the sink mutex held, so no new lines arrive while files move
+void UringFileSink::rotate() {
+    wait_drained();
+    boost::system::error_code close_ec;
+    file_.close(close_ec);
+
+    std::error_code ec;
+    for (size_t i = max_files_; i > 0; i--) {
+        auto source = spdlog::sinks::rotating_file_sink_mt::calc_filename(base_filename_, i - 1);
+        if (!std::filesystem::exists(source, ec)) {
+            continue;
+        }
+        auto target = spdlog::sinks::rotating_file_sink_mt::calc_filename(base_filename_, i);
+        std::filesystem::remove(target, ec);
+        std::filesystem::rename(source, target, ec);
+    }
+    open_file(true);
+}
+
+#endif
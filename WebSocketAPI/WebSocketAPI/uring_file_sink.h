@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include "asio_config.h"
+
+#if defined(WEBSOCKETAPI_IO_URING)
+
+#include <boost/asio.hpp>
+#include <boost/asio/stream_file.hpp>
+#include <spdlog/sinks/base_sink.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * Size-rotating log file sink that writes through io_uring
+ * Formatted lines collect in a buffer that a dedicated I/O thread drains with
+ * one async write at a time, so logging threads never block on the disk.
+ * Rotated files use the same names as spdlog's rotating_file_sink.
+ */
+class UringFileSink : public spdlog::sinks::base_sink<std::mutex> {
+public:
+    UringFileSink(std::string base_filename, size_t max_size, size_t max_files);
+    ~UringFileSink() override;
+
+protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override;
+    void flush_() override;
+
+private:
+    std::string base_filename_;
+    size_t max_size_;
+    size_t max_files_;
+    size_t current_size_ = 0;
+
+    boost::asio::io_context io_context_;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_guard_;
+    boost::asio::stream_file file_;
+    std::thread io_thread_;
+
+    // pending_ collects new lines; writing_ is owned by the write in flight
+    std::mutex buffer_mutex_;
+    std::condition_variable drained_;
+    std::string pending_;
+    std::string writing_;
+    bool write_in_flight_ = false;
+
+    void open_file(bool truncate);
+    void write_next();
+    void wait_drained();
+    void rotate();
+};
+
+#endif
@@ -1,5 +1,81 @@
 ﻿#include "websocket_server.h"
+#include "connection_limiter.h"
+#include "delta_encoder.h"
+#include "flight_recorder.h"
+#include "idempotency.h"
+#include "rate_limiter.h"
+#include "server_config.h"
+#include "state_store.h"
+#include "subscriber_hub.h"
 #include <algorithm>
+#include <array>
+#include <memory_resource>
+#include <random>
+
+namespace {
+
+// Reported by the periodic summary line instead of per-message log lines
+LogCounter ws_connections("ws_connections");
+LogCounter ws_closed("ws_closed");
+LogCounter ws_sent("ws_sent");
+LogCounter ws_received("ws_received");
+LogCounter ws_pings("ws_pings");
+LogCounter ws_published("ws_published");
+LogCounter ws_broadcasts("ws_broadcast_events");
+LogCounter ws_rejected("ws_rejected");
+LogCounter ws_slow_consumers("ws_slow_consumers");
+
+// Session memory gauges, see get_session_memory_stats()
+std::atomic<size_t> live_sessions{0};
+std::atomic<size_t> read_buffer_bytes{0};
+std::atomic<size_t> idle_reads{0};
+std::atomic<size_t> outbound_queues{0};
+std::atomic<size_t> queued_frame_bytes{0};
+
+// Target of the zero-byte idle reads. Never written, but it must be a real
+// address: Beast's UTF-8 check does pointer arithmetic on it.
+char idle_read_target;
+
+const char* admission_reason(AdmissionResult result) {
+    switch (result) {
+        case AdmissionResult::total_limited: return "max_connections";
+        case AdmissionResult::per_ip_limited: return "max_connections_per_ip";
+        case AdmissionResult::handshake_limited: return "max_pending_handshakes";
+        default: return "admitted";
+    }
+}
+
+// Count a freshly accepted socket against the connection limits, closing it
+// if it does not fit. Runs on the accepting thread.
+bool admit_connection(tcp::socket& socket, std::string& out_address) {
+    boost::system::error_code ec;
+    auto remote = socket.remote_endpoint(ec);
+    if (ec) {
+        // Already reset by the peer
+        socket.close(ec);
+        return false;
+    }
+    out_address = remote.address().to_string();
+    auto result = get_connection_limiter().admit(out_address);
+    if (result == AdmissionResult::admitted) {
+        return true;
+    }
+    ws_rejected.add();
+    static LogRateLimiter reject_log(5);
+    if (reject_log.allow()) {
+        log_warn("WebSocket connection from " + out_address + " rejected (" +
+                 admission_reason(result) + ")" + reject_log.suppressed_suffix());
+    }
+    socket.close(ec);
+    return false;
+}
+
+bool descriptors_exhausted(const boost::system::error_code& ec) {
+    return ec == boost::asio::error::no_descriptors ||
+           ec == boost::system::errc::too_many_files_open_in_system;
+}
+
+}  // namespace
 
 // WsSession implementation
 
@@ -8,9 +84,12 @@ WsSession::WsSession(boost::asio::io_context& io_context,
     : socket_(io_context),
       ws_(socket_),
       server_(server),
+      outbound_scheduler_(get_event_manager().lane_weights()),
       last_activity_(std::chrono::steady_clock::now()),
-      session_id_(next_session_id_++) {
-    
+      session_id_(next_session_id_++),
+      compact_(get_runtime_tunables().compact_sessions()) {
+    live_sessions.fetch_add(1, std::memory_order_relaxed);
+
     ws_.set_option(
         websocket::stream_base::decorator(
             [](websocket::request_type& req) {
@@ -20,20 +99,62 @@ WsSession::WsSession(boost::asio::io_context& io_context,
             }));
 }
 
+WsSession::~WsSession() {
+    live_sessions.fetch_sub(1, std::memory_order_relaxed);
+    read_buffer_bytes.fetch_sub(read_capacity_, std::memory_order_relaxed);
+    queued_frame_bytes.fetch_sub(queued_bytes_, std::memory_order_relaxed);
+    if (outbound_) {
+        outbound_queues.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (!admitted_) {
+        return;
+    }
+    auto& limiter = get_connection_limiter();
+    if (handshake_pending_) {
+        limiter.handshake_finished(false);
+    }
+    limiter.release(admitted_address_);
+}
+
 tcp::socket& WsSession::socket() {
     return socket_;
 }
 
 void WsSession::start() {
     auto self(shared_from_this());
+    flight_record(FlightEvent::accept, session_id_);
+    // Bound the upgrade; afterwards check_keepalive_timeout() takes over, with
+    // intervals that follow configuration reloads
+    auto timeouts = websocket::stream_base::timeout::suggested(beast::role_type::server);
+    timeouts.handshake_timeout = get_connection_limiter().handshake_timeout();
+    timeouts.idle_timeout = websocket::stream_base::none();
+    timeouts.keep_alive_pings = false;
+    ws_.set_option(timeouts);
+    handshake_pending_ = admitted_;
     ws_.async_accept(
         [this, self](const boost::system::error_code& ec) {
+            if (handshake_pending_) {
+                handshake_pending_ = false;
+                get_connection_limiter().handshake_finished(ec == beast::error::timeout);
+            }
             if (!ec) {
+                // Pings and pongs from the client count as activity
+                ws_.control_callback([this](websocket::frame_type, beast::string_view) {
+                    last_activity_ = std::chrono::steady_clock::now();
+                    ping_sent_ = false;
+                });
                 server_->register_client(self);
                 last_activity_ = std::chrono::steady_clock::now();
                 start_read();
             } else {
-                log_error("WebSocket handshake error: " + ec.message());
+                ws_connections.add_error();
+                flight_record(FlightEvent::error, session_id_, ec.value(),
+                              static_cast<uint16_t>(FlightErrorSource::handshake));
+                static LogRateLimiter handshake_error_log(20);
+                if (handshake_error_log.allow()) {
+                    log_error("WebSocket handshake error: " + ec.message() +
+                              handshake_error_log.suppressed_suffix());
+                }
             }
         });
 }
@@ -41,50 +162,175 @@ void WsSession::start() {
 void WsSession::send_message(const std::string& message) {
     try {
         ws_.write(boost::asio::buffer(message));
+        ws_sent.add(message.size());
+        flight_record(FlightEvent::send, session_id_, message.size());
     } catch (const std::exception& e) {
-        log_error("WebSocket send error: " + std::string(e.what()));
+        ws_sent.add_error();
+        flight_record(FlightEvent::error, session_id_, 0,
+                      static_cast<uint16_t>(FlightErrorSource::write));
+        static LogRateLimiter send_error_log(20);
+        if (send_error_log.allow()) {
+            log_error("WebSocket send error: " + std::string(e.what()) +
+                      send_error_log.suppressed_suffix());
+        }
         close_connection();
     }
 }
 
-void WsSession::send_message_async(const std::string& message) {
+void WsSession::send_message_async(const std::string& message,
+                                   EventPriority priority,
+                                   std::chrono::steady_clock::time_point published_at) {
+    send_message_async(std::make_shared<const std::string>(message), priority, published_at);
+}
+
+void WsSession::send_message_async(SharedFrame frame,
+                                   EventPriority priority,
+                                   std::chrono::steady_clock::time_point published_at,
+                                   std::chrono::steady_clock::time_point expires_at) {
+    if (!socket_.is_open()) {
+        return;
+    }
+    size_t limit = get_runtime_tunables().slow_consumer_max_bytes();
+    if (limit > 0 && queued_bytes_ + frame->size() > limit + snapshot_allowance_) {
+        drop_slow_consumer();
+        return;
+    }
+    queued_bytes_ += frame->size();
+    queued_frame_bytes.fetch_add(frame->size(), std::memory_order_relaxed);
+    if (!outbound_) {
+        outbound_ = std::make_unique<OutboundLanes>();
+        outbound_queues.fetch_add(1, std::memory_order_relaxed);
+    }
+    (*outbound_)[static_cast<size_t>(priority)].push_back(
+        OutboundMessage{std::move(frame), priority, published_at, expires_at});
+    if (!writing_) {
+        write_next();
+    }
+}
+
+void WsSession::write_next() {
+    int lane;
+    std::chrono::steady_clock::time_point now{};
+    for (;;) {
+        std::array<bool, EVENT_PRIORITY_COUNT> non_empty{};
+        if (outbound_) {
+            for (size_t i = 0; i < EVENT_PRIORITY_COUNT; i++) {
+                non_empty[i] = !(*outbound_)[i].empty();
+            }
+        }
+        lane = outbound_scheduler_.next(non_empty);
+        if (lane < 0) {
+            break;
+        }
+        auto& front = (*outbound_)[lane].front();
+        if (front.expires_at == std::chrono::steady_clock::time_point{}) {
+            break;
+        }
+        if (now == std::chrono::steady_clock::time_point{}) {
+            now = std::chrono::steady_clock::now();
+        }
+        if (now < front.expires_at) {
+            break;
+        }
+        // Went stale behind a slow socket: skip it rather than send it late
+        size_t size = front.data->size();
+        queued_bytes_ -= size;
+        queued_frame_bytes.fetch_sub(size, std::memory_order_relaxed);
+        get_event_manager().record_expired_delivery(size);
+        (*outbound_)[lane].pop_front();
+    }
+    if (lane < 0) {
+        writing_ = false;
+        snapshot_allowance_ = 0;
+        if (compact_ && outbound_) {
+            // Drained: an idle subscriber keeps no queue storage
+            outbound_.reset();
+            outbound_queues.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    writing_ = true;
+    auto& queue = (*outbound_)[lane];
+    writing_message_ = std::move(queue.front());
+    queue.pop_front();
+
     auto self(shared_from_this());
-    auto buffer = std::make_shared<std::string>(message);
-    
     ws_.async_write(
-        boost::asio::buffer(*buffer),
-        [this, self, buffer](const boost::system::error_code& ec, std::size_t bytes_transferred) {
+        boost::asio::buffer(*writing_message_.data),
+        make_recycling_handler(
+        [this, self](const boost::system::error_code& ec, std::size_t bytes_transferred) {
             if (ec) {
-                log_error("WebSocket async send error: " + ec.message());
+                ws_sent.add_error();
+                flight_record(FlightEvent::error, session_id_, ec.value(),
+                              static_cast<uint16_t>(FlightErrorSource::write));
+                static LogRateLimiter async_send_error_log(20);
+                if (async_send_error_log.allow()) {
+                    log_error("WebSocket async send error: " + ec.message() +
+                              async_send_error_log.suppressed_suffix());
+                }
+                writing_ = false;
                 close_connection();
-            } else {
-                log_info("WebSocket message sent to client " + std::to_string(session_id_) + 
+                return;
+            }
+            ws_sent.add(bytes_transferred);
+            flight_record(FlightEvent::send, session_id_, bytes_transferred);
+            if (log_debug_enabled()) {
+                log_debug("WebSocket message sent to client " + std::to_string(session_id_) + 
                         " (" + std::to_string(bytes_transferred) + " bytes)");
             }
-        });
+            queued_bytes_ -= writing_message_.data->size();
+            queued_frame_bytes.fetch_sub(writing_message_.data->size(), std::memory_order_relaxed);
+            writing_message_.data.reset();
+            if (writing_message_.published_at != std::chrono::steady_clock::time_point{}) {
+                get_event_manager().record_delivery_latency(
+                    writing_message_.priority,
+                    std::chrono::steady_clock::now() - writing_message_.published_at);
+            }
+            write_next();
+        }));
 }
 
 bool WsSession::check_keepalive_timeout() {
     auto now = std::chrono::steady_clock::now();
     auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
         now - last_activity_);
+    const auto& tunables = get_runtime_tunables();
 
-    // Timeout threshold: 30 seconds
-    if (elapsed.count() > 30) {
-        log_warn("WebSocket client " + std::to_string(session_id_) +
-                " timeout (inactive for " + std::to_string(elapsed.count()) + "s)");
+    // Timeout threshold (keepalive_timeout_s, default 30 seconds)
+    if (elapsed >= tunables.keepalive_timeout()) {
+        static LogRateLimiter timeout_log(20);
+        if (timeout_log.allow()) {
+            log_warn("WebSocket client " + std::to_string(session_id_) +
+                    " timeout (inactive for " + std::to_string(elapsed.count()) + "s)" +
+                    timeout_log.suppressed_suffix());
+        }
         return true;
     }
 
-    // Send ping every 10 seconds
-    if (elapsed.count() >= 10) {
-        try {
-            ws_.ping(websocket::ping_data());
-            last_activity_ = now;
-            log_info("WebSocket ping sent to client " + std::to_string(session_id_));
-        } catch (const std::exception& e) {
-            log_error("WebSocket ping error: " + std::string(e.what()));
-            return true;
+    // Ping after keepalive_ping_interval_s (default 10 seconds) of silence; the
+    // pong, not the ping, resets last_activity_
+    if (elapsed >= tunables.keepalive_ping_interval() && !ping_sent_) {
+        ping_sent_ = true;
+        ws_pings.add();
+        auto self(shared_from_this());
+        ws_.async_ping(websocket::ping_data(), make_recycling_handler(
+            [this, self](const boost::system::error_code& ec) {
+                if (!ec) {
+                    return;
+                }
+                // The pending read reports the broken connection and closes it
+                ws_pings.add_error();
+                flight_record(FlightEvent::error, session_id_, ec.value(),
+                              static_cast<uint16_t>(FlightErrorSource::ping));
+                static LogRateLimiter ping_error_log(20);
+                if (ping_error_log.allow()) {
+                    log_error("WebSocket ping error: " + ec.message() +
+                              ping_error_log.suppressed_suffix());
+                }
+            }));
+        if (log_debug_enabled()) {
+            log_debug("WebSocket ping sent to client " + std::to_string(session_id_));
         }
     }
 
@@ -92,28 +338,304 @@ bool WsSession::check_keepalive_timeout() {
 }
 
 void WsSession::start_read() {
+    if (!compact_) {
+        read_message();
+        return;
+    }
+    // Zero-byte read: Beast reads the next frame header into its own buffer
+    // (control frames are handled there) and completes once a data frame
+    // arrives, so no message buffer is held while the client is idle
+    auto self(shared_from_this());
+    idle_reads.fetch_add(1, std::memory_order_relaxed);
+    ws_.async_read_some(
+        boost::asio::mutable_buffer(&idle_read_target, 0),
+        make_recycling_handler(
+        [this, self](const boost::system::error_code& ec, std::size_t) {
+            idle_reads.fetch_sub(1, std::memory_order_relaxed);
+            if (ec) {
+                read_failed(ec);
+                return;
+            }
+            read_message();
+        }));
+}
+
+void WsSession::read_message() {
     auto self(shared_from_this());
     ws_.async_read(
         buffer_,
+        make_recycling_handler(
         [this, self](const boost::system::error_code& ec,
                      std::size_t bytes_transferred) {
-            if (!ec) {
-                last_activity_ = std::chrono::steady_clock::now();
+            if (ec) {
+                update_read_capacity();
+                read_failed(ec);
+                return;
+            }
+            last_activity_ = std::chrono::steady_clock::now();
+            ping_sent_ = false;
+            ws_received.add(bytes_transferred);
 
-                if (ws_.got_text()) {
-                    std::string message = beast::buffers_to_string(
-                        buffer_.data());
-                    buffer_.consume(bytes_transferred);
-                    log_info("WebSocket message from client " +
-                            std::to_string(session_id_) + ": " +
-                            message.substr(0, 50));
+            if (ws_.got_text()) {
+                auto data = buffer_.data();
+                handle_text_message(std::string_view(
+                    static_cast<const char*>(data.data()), data.size()));
+            }
+            buffer_.consume(buffer_.size());
+            if (compact_) {
+                buffer_.shrink_to_fit();
+            }
+            update_read_capacity();
+            start_read();
+        }));
+    // Beast prepares the buffer for the first frame before the read is pending
+    update_read_capacity();
+}
+
+void WsSession::read_failed(const boost::system::error_code& ec) {
+    if (ec == websocket::error::closed) {
+        return;
+    }
+    ws_received.add_error();
+    flight_record(FlightEvent::error, session_id_, ec.value(),
+                  static_cast<uint16_t>(FlightErrorSource::read));
+    static LogRateLimiter read_error_log(20);
+    if (read_error_log.allow()) {
+        log_error("WebSocket read error: " + ec.message() +
+                  read_error_log.suppressed_suffix());
+    }
+    close_connection();
+}
+
+void WsSession::update_read_capacity() {
+    size_t capacity = buffer_.capacity();
+    if (capacity != read_capacity_) {
+        read_buffer_bytes.fetch_add(capacity - read_capacity_, std::memory_order_relaxed);
+        read_capacity_ = capacity;
+    }
+}
+
+void WsSession::handle_text_message(std::string_view message) {
+    json request = json::parse(message, nullptr, false);
+    if (request.is_discarded() || !request.is_object() || !request.contains("op")) {
+        // Not a protocol frame; kept as a plain client message
+        static LogRateLimiter message_log(10);
+        if (message_log.allow()) {
+            log_info("WebSocket message from client " + std::to_string(session_id_) + ": " +
+                     std::string(message.substr(0, 50)) + message_log.suppressed_suffix());
+        }
+        return;
+    }
+
+    json id = request.contains("id") ? request["id"] : json();
+    try {
+        if (request["op"] == "snapshot") {
+            // Resync delta-encoded state: one key, one type, or everything
+            std::string key = request.value("key", std::string());
+            if (key.empty()) {
+                // Can be every base; a client cannot ask for that in a loop
+                auto now = std::chrono::steady_clock::now();
+                if (now < next_snapshot_) {
+                    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_snapshot_ - now);
+                    send_publish_error(id, 429, "Snapshot requested too often; retry in " +
+                                       std::to_string(wait.count() + 1) + " ms");
+                    return;
                 }
-                start_read();
-            } else if (ec != websocket::error::closed) {
-                log_error("WebSocket read error: " + ec.message());
-                close_connection();
+                next_snapshot_ = now + SNAPSHOT_INTERVAL;
+            }
+            send_snapshot(get_delta_encoder().snapshot_frames(request.value("type", std::string()), key));
+            return;
+        }
+        if (request["op"] == "state") {
+            // Latest event per type (and key) from the state store
+            send_state(request.value("type", std::string()));
+            return;
+        }
+        bool want_ack = request.value("ack", false);
+        if (request["op"] != "publish") {
+            send_publish_error(id, 400, "Unknown 'op' (expected publish, snapshot or state)");
+            return;
+        }
+        handle_publish(request, id, want_ack);
+    } catch (const std::exception& e) {
+        send_publish_error(id, 400, std::string("Invalid publish frame: ") + e.what());
+    }
+}
+
+void WsSession::handle_publish(json& request, const json& id, bool want_ack) {
+    // Same admission and validation as POST /api/event
+    std::string client_key;
+    if (!admitted_address_.empty()) {
+        client_key = "addr:" + admitted_address_;
+    } else {
+        boost::system::error_code ec;
+        auto remote = socket_.remote_endpoint(ec);
+        client_key = ec ? std::string("addr:unknown") : "addr:" + remote.address().to_string();
+    }
+    auto decision = get_rate_limiter().check(client_key);
+    if (!decision.allowed()) {
+        auto retry_after = std::chrono::ceil<std::chrono::seconds>(decision.retry_after);
+        json reply = {
+            {"op", "ack"}, {"id", id}, {"status", "error"}, {"code", 429},
+            {"message", decision.result == RateLimitResult::global_limited
+                            ? "Server is over its event rate limit"
+                            : "Client is over its event rate limit"},
+            {"retry_after", std::max<int64_t>(1, retry_after.count())}
+        };
+        send_message_async(reply.dump(), EventPriority::high);
+        return;
+    }
+
+    // Same deduplication as POST /api/event, by the "idempotency_key" field
+    IdempotencyReservation reservation;
+    auto& idempotency = get_idempotency_index();
+    if (idempotency.enabled() && request.contains("idempotency_key") &&
+        request["idempotency_key"].is_string() &&
+        !request["idempotency_key"].get_ref<const std::string&>().empty()) {
+        auto key = request["idempotency_key"].get<std::string>();
+        if (key.size() > idempotency.max_key_length()) {
+            send_publish_error(id, 400, "Idempotency key is longer than " +
+                                        std::to_string(idempotency.max_key_length()) + " bytes");
+            return;
+        }
+        IdempotentResponse original;
+        auto result = reservation.begin(std::move(key), original);
+        if (result == IdempotencyResult::duplicate) {
+            if (want_ack) {
+                send_publish_ack(id, original, true);
             }
+            return;
+        }
+        if (result == IdempotencyResult::in_progress) {
+            send_publish_error(id, 409, "A request with this idempotency key is in progress");
+            return;
+        }
+    }
+
+    Event event;
+    auto invalid = event_from_request(request, event);
+    if (!invalid.empty()) {
+        send_publish_error(id, 400, invalid);
+        return;
+    }
+
+    IdempotentResponse accepted{event.type, event.priority, event.timestamp, 0};
+    auto& manager = get_event_manager();
+    EventManager::ForwardCallback on_forwarded;
+    std::shared_ptr<IdempotencyReservation> forwarded_reservation;
+    if (manager.forwarding()) {
+        // Handed over to a hot restart successor: acked from its reply, back on
+        // this session's thread, so the server thread never waits for it
+        forwarded_reservation = std::make_shared<IdempotencyReservation>(std::move(reservation));
+        on_forwarded = [self = shared_from_this(), reservation = forwarded_reservation,
+                        accepted, id, want_ack](PublishResult result, uint64_t sequence) mutable {
+            accepted.sequence = sequence;
+            boost::asio::post(self->ws_.get_executor(),
+                [self, reservation, accepted = std::move(accepted), id, want_ack, result]() mutable {
+                    self->finish_publish(id, want_ack, result, std::move(accepted), *reservation);
+                });
+        };
+    }
+    auto result = manager.publish_event(std::move(event), &accepted.sequence,
+                                        std::move(on_forwarded));
+    if (result != PublishResult::forwarded) {
+        // Forwarding may have ended in between, leaving the event queued here
+        finish_publish(id, want_ack, result, std::move(accepted),
+                       forwarded_reservation ? *forwarded_reservation : reservation);
+    }
+}
+
+void WsSession::finish_publish(const json& id, bool want_ack, PublishResult result,
+                               IdempotentResponse accepted, IdempotencyReservation& reservation) {
+    if (result == PublishResult::rejected) {
+        send_publish_error(id, 503, "Event queue is full, retry later");
+        return;
+    }
+    ws_published.add();
+
+    if (want_ack) {
+        send_publish_ack(id, accepted, false);
+    }
+    reservation.complete(std::move(accepted));
+}
+
+void WsSession::send_publish_ack(const json& id, const IdempotentResponse& accepted, bool replayed) {
+    json reply = {
+        {"op", "ack"}, {"id", id}, {"status", "success"},
+        {"sequence", accepted.sequence},
+        {"priority", event_priority_name(accepted.priority)},
+        {"timestamp", accepted.timestamp}
+    };
+    if (replayed) {
+        reply["replayed"] = true;
+    }
+    send_message_async(reply.dump(), EventPriority::high);
+}
+
+void WsSession::send_state(const std::string& type) {
+    auto snapshot = get_state_store().snapshot();
+    for (const auto& [state_type, state] : snapshot->types) {
+        if (!type.empty() && state_type != type) {
+            continue;
+        }
+        state->for_each_frame([&](const SharedFrame& frame) {
+            send_message_async(frame, EventPriority::high, {});
         });
+    }
+}
+
+void WsSession::send_snapshot(const std::vector<SharedFrame>& frames) {
+    // Exempt from slow_consumer_max_bytes: a large snapshot would otherwise
+    // drop a new client before it had a chance to read
+    for (const auto& frame : frames) {
+        snapshot_allowance_ += frame->size();
+        send_message_async(frame, EventPriority::high, {});
+    }
+}
+
+void WsSession::send_publish_error(const json& id, int code, const std::string& message) {
+    // Errors are always reported, acknowledged or not
+    json reply = {
+        {"op", "ack"}, {"id", id}, {"status", "error"}, {"code", code}, {"message", message}
+    };
+    send_message_async(reply.dump(), EventPriority::high);
+}
+
+void WsSession::drop_slow_consumer() {
+    // No close handshake: it would queue behind the backlog we are giving up on
+    ws_slow_consumers.add();
+    static LogRateLimiter slow_consumer_log(20);
+    if (slow_consumer_log.allow()) {
+        log_warn("WebSocket client " + std::to_string(session_id_) +
+                 " closed: backlog over slow_consumer_max_bytes" +
+                 slow_consumer_log.suppressed_suffix());
+    }
+    boost::system::error_code ec;
+    socket_.close(ec);
+    server_->unregister_client(shared_from_this());
+}
+
+void WsSession::drop_unresponsive() {
+    // No close handshake: the client has stopped answering
+    boost::system::error_code ec;
+    socket_.close(ec);
+    server_->unregister_client(shared_from_this());
+    ws_closed.add();
+    flight_record(FlightEvent::close, session_id_);
+}
+
+void WsSession::close_for_restart(std::chrono::milliseconds retry_after) {
+    // 1012 Service Restart; the reason carries this client's share of the reconnect jitter
+    std::string hint = "retry_after_ms=" + std::to_string(retry_after.count());
+    websocket::close_reason reason(websocket::close_code::service_restart, hint);
+    auto self(shared_from_this());
+    ws_.async_close(reason, [this, self](const boost::system::error_code&) {
+        boost::system::error_code ec;
+        socket_.close(ec);
+    });
+    server_->unregister_client(self);
+    ws_closed.add();
+    flight_record(FlightEvent::close, session_id_);
 }
 
 void WsSession::close_connection() {
@@ -126,65 +648,286 @@ void WsSession::close_connection() {
     } catch (...) {
     }
     server_->unregister_client(shared_from_this());
-    log_info("WebSocket client " + std::to_string(session_id_) + " closed");
+    ws_closed.add();
+    flight_record(FlightEvent::close, session_id_);
+    if (log_debug_enabled()) {
+        log_debug("WebSocket client " + std::to_string(session_id_) + " closed");
+    }
 }
 
 // WebSocketServer implementation
 
-WebSocketServer::WebSocketServer(boost::asio::io_context& io_context, unsigned short port)
+WebSocketServer::WebSocketServer(boost::asio::io_context& io_context, unsigned short port,
+                                 const ListenerConfig& listener)
     : io_context_(io_context),
-      acceptor_(io_context, tcp::endpoint(tcp::v4(), port)) {
-    log_info("WebSocket Server initialized on port " + std::to_string(port));
+      accept_threads_(effective_acceptor_count(listener) - 1),
+      acceptor_(open_listener_acceptor(io_context, tcp::endpoint(tcp::v4(), port), listener, 0,
+                                       accept_threads_.size() > 0)) {
+    // Siblings bind the port actually chosen, so port 0 works as well
+    tcp::endpoint bound(tcp::v4(), local_port());
+    for (size_t i = 0; i < accept_threads_.size(); i++) {
+        extra_acceptors_.push_back(
+            open_listener_acceptor(accept_threads_.context(i), bound, listener, i + 1, true));
+    }
+    log_info("WebSocket Server initialized on port " + std::to_string(local_port()) +
+             " (acceptors=" + std::to_string(extra_acceptors_.size() + 1) +
+             ", backlog=" + std::to_string(listener.backlog) + ")");
 }
 
 WebSocketServer::~WebSocketServer() {
+    stop();
+}
+
+void WebSocketServer::stop() {
+    accept_threads_.stop();
+    for (auto& acceptor : extra_acceptors_) {
+        try {
+            acceptor.close();
+        } catch (...) {
+        }
+    }
     try {
         acceptor_.close();
     } catch (...) {
     }
 }
 
+unsigned short WebSocketServer::local_port() const {
+    return acceptor_.local_endpoint().port();
+}
+
 size_t WebSocketServer::client_count() const {
     std::lock_guard<std::mutex> lock(clients_mutex_);
     return clients_.size();
 }
 
+void WebSocketServer::check_keepalives() {
+    // Closing unregisters, so the expired sessions are closed after the scan
+    std::vector<std::shared_ptr<WsSession>> expired;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (auto& client : clients_) {
+            if (client->check_keepalive_timeout()) {
+                expired.push_back(client);
+            }
+        }
+    }
+    for (auto& client : expired) {
+        client->drop_unresponsive();
+    }
+}
+
+uint64_t WebSocketServer::accepted_connections() const {
+    return accepted_.load(std::memory_order_relaxed);
+}
+
+std::vector<int> WebSocketServer::listening_handles() {
+    std::vector<int> handles{static_cast<int>(acceptor_.native_handle())};
+    for (auto& acceptor : extra_acceptors_) {
+        handles.push_back(static_cast<int>(acceptor.native_handle()));
+    }
+    return handles;
+}
+
+void WebSocketServer::stop_accepting() {
+    boost::asio::post(io_context_, [self = shared_from_this()]() { self->stop(); });
+}
+
+void WebSocketServer::post_between_batches(std::function<void()> task) {
+    boost::asio::post(io_context_, std::move(task));
+}
+
+struct WebSocketServer::Drain {
+    boost::asio::steady_timer timer;
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::milliseconds reconnect_jitter;
+    std::mt19937 random;
+    std::function<void()> on_drained;
+    bool closing_done = false;
+};
+
+void WebSocketServer::drain_for_restart(std::chrono::milliseconds window,
+                                        std::chrono::milliseconds reconnect_jitter,
+                                        std::function<void()> on_drained) {
+    boost::asio::post(io_context_, [self = shared_from_this(), window, reconnect_jitter,
+                                    on_drained = std::move(on_drained)]() mutable {
+        auto drain = std::make_shared<Drain>(Drain{
+            boost::asio::steady_timer(self->io_context_),
+            std::chrono::steady_clock::now() + window,
+            reconnect_jitter,
+            std::mt19937(std::random_device{}()),
+            std::move(on_drained)});
+        log_info("Draining " + std::to_string(self->client_count()) +
+                 " WebSocket clients over " + std::to_string(window.count()) + " ms");
+        self->drain_step(drain);
+    });
+}
+
+void WebSocketServer::drain_step(std::shared_ptr<Drain> drain) {
+    if (drain->closing_done) {
+        // The close handshakes had their grace period
+        drain->on_drained();
+        return;
+    }
+
+    std::vector<std::shared_ptr<WsSession>> clients;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        clients = clients_;
+    }
+    // Close an even share of the remaining clients per tick, the rest at the deadline
+    auto now = std::chrono::steady_clock::now();
+    size_t to_close = clients.size();
+    if (now + DRAIN_TICK < drain->deadline) {
+        auto ticks_left = static_cast<size_t>((drain->deadline - now) / DRAIN_TICK);
+        to_close = (clients.size() + ticks_left - 1) / ticks_left;
+    }
+    std::uniform_int_distribution<int64_t> retry_after(0, drain->reconnect_jitter.count());
+    for (size_t i = 0; i < to_close; i++) {
+        clients[i]->close_for_restart(std::chrono::milliseconds(retry_after(drain->random)));
+    }
+
+    if (to_close == clients.size()) {
+        drain->closing_done = true;
+        drain->timer.expires_after(DRAIN_CLOSE_GRACE);
+    } else {
+        drain->timer.expires_after(DRAIN_TICK);
+    }
+    drain->timer.async_wait([self = shared_from_this(), drain](const boost::system::error_code&) {
+        self->drain_step(drain);
+    });
+}
+
 void WebSocketServer::start() {
     start_accept();
+    for (auto& acceptor : extra_acceptors_) {
+        start_accept_on(acceptor);
+    }
+    accept_threads_.start();
 }
 
 void WebSocketServer::broadcast_pending_events() {
+    // Subscribers from other threads get their snapshots between batches, as
+    // WebSocket clients do in register_client
+    admit_hub_subscribers();
+
     Event event;
-    int event_count = 0;
-    while (get_event_manager().get_next_event(event)) {
-        event_count++;
-        std::string event_json = event.to_string();
-        log_info("Broadcasting event to WebSocket clients: " + event.type);
+    if (!get_event_manager().get_next_event(event)) {
+        // No events to broadcast - this is normal
+        return;
+    }
 
+    // Scratch arena for this broadcast batch, released when the batch ends
+    std::array<std::byte, 16 * 1024> arena_storage;
+    std::pmr::monotonic_buffer_resource arena(arena_storage.data(), arena_storage.size());
+
+    // Snapshot the client list once per batch; sessions register and close on this thread
+    std::pmr::vector<std::shared_ptr<WsSession>> targets(&arena);
+    {
         std::lock_guard<std::mutex> lock(clients_mutex_);
-        int client_count = clients_.size();
-        log_info("Current WebSocket client count: " + std::to_string(client_count));
-        
-        if (client_count == 0) {
-            log_warn("No WebSocket clients connected to receive event!");
+        targets.assign(clients_.begin(), clients_.end());
+    }
+    std::pmr::vector<SubscriberHub::SubscriberPtr> hub_targets(&arena);
+    get_subscriber_hub().snapshot(hub_targets);
+
+    auto& state_store = get_state_store();
+    int event_count = 0;
+    do {
+        event_count++;
+        // Serialize once; every client queues the same immutable frame, and the
+        // state store keeps it as the latest event of its type.
+        // Delta-encoded types may get a patch against the shared per-key base.
+        SharedFrame full_frame;
+        if (state_store.enabled()) {
+            full_frame = std::allocate_shared<std::string>(RecyclingAllocator<std::string>(), event.to_string());
+            state_store.update(event, full_frame);
         }
-        
-        for (auto client : clients_) {
-            log_info("Sending message to client...");
-            client->send_message_async(event_json);  // Use async version
+        SharedFrame delta_frame;
+        bool delta = get_delta_encoder().encode(event, delta_frame);
+        SharedFrame frame = delta ? std::move(delta_frame)
+            : full_frame ? std::move(full_frame)
+            : std::allocate_shared<std::string>(RecyclingAllocator<std::string>(), event.to_string());
+        // A dropped patch would leave the client's copy behind the shared base,
+        // so delta-encoded frames never expire once they are fanned out
+        auto expires_at = delta ? std::chrono::steady_clock::time_point{} : event.expires_at;
+        ws_broadcasts.add(frame->size());
+        if (log_debug_enabled()) {
+            log_debug("Broadcasting event to " + std::to_string(targets.size()) +
+                      " WebSocket clients: " + event.type +
+                      " (priority=" + event_priority_name(event.priority) + ")");
         }
+        for (auto& client : targets) {
+            client->send_message_async(frame, event.priority, event.published_at, expires_at);
+        }
+        for (auto& subscriber : hub_targets) {
+            subscriber->deliver(frame, event.priority, event.published_at, expires_at);
+        }
+    } while (get_event_manager().get_next_event(event));
+    state_store.commit();
+
+    static LogRateLimiter idle_broadcast_log(1);
+    if (targets.empty() && hub_targets.empty() && idle_broadcast_log.allow()) {
+        log_warn("No WebSocket clients connected to receive " +
+                 std::to_string(event_count) + " event(s)!" +
+                 idle_broadcast_log.suppressed_suffix());
     }
-    
-    if (event_count == 0) {
-        // No events to broadcast - this is normal, just debug info
-        // log_info("No pending events to broadcast");
+}
+
+SessionMemoryStats get_session_memory_stats() {
+    return SessionMemoryStats{
+        live_sessions.load(std::memory_order_relaxed),
+        sizeof(WsSession),
+        read_buffer_bytes.load(std::memory_order_relaxed),
+        idle_reads.load(std::memory_order_relaxed),
+        outbound_queues.load(std::memory_order_relaxed),
+        queued_frame_bytes.load(std::memory_order_relaxed)};
+}
+
+std::vector<SharedFrame> WebSocketServer::initial_snapshot() const {
+    std::vector<SharedFrame> initial = get_delta_encoder().snapshot_frames();
+    if (get_state_store().snapshot_on_connect()) {
+        auto snapshot = get_state_store().snapshot();
+        auto& delta = get_delta_encoder();
+        for (const auto& [type, state] : snapshot->types) {
+            if (delta.encodes(type)) {
+                continue;
+            }
+            state->for_each_frame([&](const SharedFrame& frame) {
+                initial.push_back(frame);
+            });
+        }
+    }
+    return initial;
+}
+
+void WebSocketServer::admit_hub_subscribers() {
+    auto& hub = get_subscriber_hub();
+    auto joining = hub.take_joining();
+    if (joining.empty()) {
+        return;
+    }
+
+    auto initial = initial_snapshot();
+    for (auto& subscriber : joining) {
+        subscriber->deliver_snapshot(initial);
+        hub.activate(subscriber);
     }
 }
 
 void WebSocketServer::register_client(std::shared_ptr<WsSession> client) {
+    // New subscribers start from the same delta bases as everyone else. Both
+    // this and broadcasting run on io_context_, so no patch can slip in between;
+    // state is committed at the end of each broadcast batch on this thread, so
+    // it is current here as well
+    client->send_snapshot(initial_snapshot());
+
     std::lock_guard<std::mutex> lock(clients_mutex_);
     clients_.push_back(client);
-    log_info("Client registered. Total clients: " + std::to_string(clients_.size()));
+    static LogRateLimiter register_log(20);
+    if (register_log.allow()) {
+        log_info("Client registered. Total clients: " + std::to_string(clients_.size()) +
+                 register_log.suppressed_suffix());
+    }
 }
 
 void WebSocketServer::unregister_client(std::shared_ptr<WsSession> client) {
@@ -193,20 +936,101 @@ void WebSocketServer::unregister_client(std::shared_ptr<WsSession> client) {
         std::remove_if(clients_.begin(), clients_.end(),
             [client](const std::shared_ptr<WsSession>& c) { return c == client; }),
         clients_.end());
-    log_info("Client unregistered. Total clients: " + std::to_string(clients_.size()));
+    static LogRateLimiter unregister_log(20);
+    if (unregister_log.allow()) {
+        log_info("Client unregistered. Total clients: " + std::to_string(clients_.size()) +
+                 unregister_log.suppressed_suffix());
+    }
+}
+
+void WebSocketServer::accept_next(tcp::acceptor& acceptor, const boost::system::error_code& ec,
+                                  std::function<void()> rearm) {
+    auto& limiter = get_connection_limiter();
+    auto delay = descriptors_exhausted(ec) ? limiter.descriptors_exhausted() : limiter.accept_delay();
+    if (delay.count() <= 0) {
+        rearm();
+        return;
+    }
+    // Leave new connections in the listen backlog until descriptors free up
+    static LogRateLimiter accept_pause_log(5);
+    if (accept_pause_log.allow()) {
+        log_warn("WebSocket accept paused for " + std::to_string(delay.count()) +
+                 "ms: close to the open file limit" + accept_pause_log.suppressed_suffix());
+    }
+    auto timer = std::make_shared<boost::asio::steady_timer>(acceptor.get_executor(), delay);
+    timer->async_wait([timer, rearm = std::move(rearm)](const boost::system::error_code& wait_ec) {
+        if (!wait_ec) {
+            rearm();
+        }
+    });
 }
 
 void WebSocketServer::start_accept() {
-    auto new_session = std::make_shared<WsSession>(io_context_, shared_from_this());
+    auto new_session = make_pooled_session<WsSession>(io_context_, shared_from_this());
     acceptor_.async_accept(
         new_session->socket(),
         [this, new_session](const boost::system::error_code& ec) {
+            if (ec == boost::asio::error::operation_aborted) {
+                return;
+            }
             if (!ec) {
-                new_session->start();
-                log_info("WebSocket: New connection accepted");
+                accepted_.fetch_add(1, std::memory_order_relaxed);
+                if (admit_connection(new_session->socket(), new_session->admitted_address_)) {
+                    new_session->admitted_ = true;
+                    ws_connections.add();
+                    new_session->start();
+                    if (log_debug_enabled()) {
+                        log_debug("WebSocket: New connection accepted");
+                    }
+                }
+            } else {
+                flight_record(FlightEvent::error, 0, ec.value(),
+                              static_cast<uint16_t>(FlightErrorSource::accept));
+                static LogRateLimiter accept_error_log(20);
+                if (accept_error_log.allow()) {
+                    log_error("WebSocket accept error: " + ec.message() +
+                              accept_error_log.suppressed_suffix());
+                }
+            }
+            accept_next(acceptor_, ec, [this]() { start_accept(); });
+        });
+}
+
+void WebSocketServer::start_accept_on(tcp::acceptor& acceptor) {
+    // The accepted socket is created on io_context_ and the session is handed over there
+    acceptor.async_accept(
+        io_context_,
+        [this, &acceptor](const boost::system::error_code& ec, tcp::socket socket) {
+            if (ec == boost::asio::error::operation_aborted) {
+                return;
+            }
+            std::string address;
+            if (!ec && admit_connection(socket, address)) {
+                accepted_.fetch_add(1, std::memory_order_relaxed);
+                boost::asio::post(io_context_,
+                    [this, self = shared_from_this(), socket = std::move(socket),
+                     address = std::move(address)]() mutable {
+                        auto new_session = make_pooled_session<WsSession>(io_context_, self);
+                        new_session->socket() = std::move(socket);
+                        new_session->admitted_address_ = std::move(address);
+                        new_session->admitted_ = true;
+                        ws_connections.add();
+                        new_session->start();
+                        if (log_debug_enabled()) {
+                            log_debug("WebSocket: New connection accepted");
+                        }
+                    });
+            } else if (ec) {
+                flight_record(FlightEvent::error, 0, ec.value(),
+                              static_cast<uint16_t>(FlightErrorSource::accept));
+                static LogRateLimiter accept_error_log(20);
+                if (accept_error_log.allow()) {
+                    log_error("WebSocket accept error: " + ec.message() +
+                              accept_error_log.suppressed_suffix());
+                }
             } else {
-                log_error("WebSocket accept error: " + ec.message());
+                accepted_.fetch_add(1, std::memory_order_relaxed);
             }
-            start_accept();
+            accept_next(acceptor, ec, [this, &acceptor]() { start_accept_on(acceptor); });
         });
 }
@@ -1,16 +1,21 @@
 ﻿#pragma once
 
-#ifndef _WIN32_WINNT
-#define _WIN32_WINNT 0x0601
-#endif
-
+#include "asio_config.h"
 #include "common.h"
+#include "connection_limiter.h"
 #include "event_manager.h"
+#include "idempotency.h"
+#include "listener.h"
+#include "memory_pool.h"
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
+#include <boost/container/deque.hpp>
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <mutex>
+#include <string_view>
+#include <functional>
 
 namespace beast = boost::beast;
 namespace http = beast::http;
@@ -22,54 +27,205 @@ class WebSocketServer;
 
 /**
  * Represents a single WebSocket client session
+ *
+ * Besides receiving broadcasts, a client can publish over the same connection
+ * with a text frame such as
+ *   {"op": "publish", "id": 7, "ack": true, "type": "chat", "data": {...}, "priority": "high"}
+ * The event goes through the same rate limit, validation and "idempotency_key"
+ * deduplication as POST /api/event. With "ack": true the session replies
+ *   {"op": "ack", "id": 7, "status": "success", "sequence": 42, "priority": "high", "timestamp": "..."}
+ * and a duplicate gets the original ack with "replayed": true.
+ * Failures are always answered with "status": "error", an HTTP-style "code"
+ * (400, 409, 429 or 503) and a "message". {"op": "snapshot", "type", "key"} resends
+ * full frames for delta-encoded state (see DeltaEncoder); type and key are
+ * optional, and a request without a key is answered at most once per
+ * SNAPSHOT_INTERVAL (429 otherwise). {"op": "state", "type"} sends the latest event of the type, or of
+ * every type, from the StateStore. Text frames without "op" are ignored.
+ *
+ * With compact_sessions on, an idle session holds no read buffer: it waits
+ * with a zero-byte read, which parks in Beast's own frame buffer, and only
+ * reads into the (recycled) message buffer once a data frame arrives. The
+ * buffer is released after every message, and the outbound lanes are freed
+ * whenever the queue drains. See get_session_memory_stats().
  */
 class WsSession : public std::enable_shared_from_this<WsSession> {
 public:
     explicit WsSession(boost::asio::io_context& io_context,
                       std::shared_ptr<WebSocketServer> server);
+    ~WsSession();
 
     tcp::socket& socket();
     void start();
     void send_message(const std::string& message);
-    void send_message_async(const std::string& message);
+    void send_message_async(const std::string& message,
+                            EventPriority priority = EventPriority::normal,
+                            std::chrono::steady_clock::time_point published_at = {});
+    /**
+     * Queue a frame; one still queued at expires_at (unless zero) is dropped
+     * instead of written
+     */
+    void send_message_async(SharedFrame frame,
+                            EventPriority priority,
+                            std::chrono::steady_clock::time_point published_at,
+                            std::chrono::steady_clock::time_point expires_at = {});
+    /**
+     * Ping once keepalive_ping_interval_s passes without traffic from the
+     * client (a pong counts)
+     * @return true once keepalive_timeout_s has passed; the caller closes it
+     */
     bool check_keepalive_timeout();
 
+    /**
+     * Hot restart: close with 1012 (Service Restart) and the reason
+     * "retry_after_ms=N", the delay this client should wait before reconnecting
+     */
+    void close_for_restart(std::chrono::milliseconds retry_after);
+
 private:
+    // Outbound queue: one lane per priority, one async_write in flight at a time
+    struct OutboundMessage {
+        SharedFrame data;
+        EventPriority priority;
+        std::chrono::steady_clock::time_point published_at;
+        std::chrono::steady_clock::time_point expires_at;
+    };
+    // Lanes allocate nothing while empty; the whole set is created on demand
+    using OutboundLane = boost::container::deque<OutboundMessage, RecyclingAllocator<OutboundMessage>>;
+    using OutboundLanes = std::array<OutboundLane, EVENT_PRIORITY_COUNT>;
+
+    static constexpr auto SNAPSHOT_INTERVAL = std::chrono::seconds(1);
     static inline int next_session_id_ = 1;
-    int session_id_;
+    // Members ordered by size to keep the object compact
     tcp::socket socket_;
     websocket::stream<tcp::socket&> ws_;
     std::shared_ptr<WebSocketServer> server_;
-    beast::flat_buffer buffer_;
+    beast::basic_flat_buffer<RecyclingAllocator<char>> buffer_;
+    std::string admitted_address_;  // Source address counted by the connection limiter
+    std::unique_ptr<OutboundLanes> outbound_;
+    OutboundMessage writing_message_;
+    LaneScheduler outbound_scheduler_;
     std::chrono::steady_clock::time_point last_activity_;
+    std::chrono::steady_clock::time_point next_snapshot_;  // Earliest answered type-wide snapshot op
+    size_t queued_bytes_ = 0;  // Outbound backlog, checked against slow_consumer_max_bytes
+    size_t snapshot_allowance_ = 0;  // Snapshot bytes on top of that limit until the queue drains
+    size_t read_capacity_ = 0; // buffer_ capacity last counted in the memory stats
+    int session_id_;
+    bool compact_ = false;     // compact_sessions when the session started
+    bool admitted_ = false;
+    bool handshake_pending_ = false;
+    bool writing_ = false;
+    bool ping_sent_ = false;   // Pinged since the client was last heard from
 
+    void write_next();
     void start_read();
+    void read_message();
+    void read_failed(const boost::system::error_code& ec);
+    void update_read_capacity();
+    void handle_text_message(std::string_view message);
+    void handle_publish(json& request, const json& id, bool want_ack);
+    void finish_publish(const json& id, bool want_ack, PublishResult result,
+                        IdempotentResponse accepted, IdempotencyReservation& reservation);
+    void send_publish_ack(const json& id, const IdempotentResponse& accepted, bool replayed);
+    void send_publish_error(const json& id, int code, const std::string& message);
+    void send_state(const std::string& type);
+    void send_snapshot(const std::vector<SharedFrame>& frames);
     void close_connection();
+    void drop_slow_consumer();
+    void drop_unresponsive();
 
     friend class WebSocketServer;
 };
 
+/**
+ * Memory held by WebSocket sessions, for sizing large idle fan-outs
+ * Kernel socket buffers are not included.
+ */
+struct SessionMemoryStats {
+    size_t sessions;             // Live WsSession objects
+    size_t session_bytes;        // sizeof(WsSession); Beast's stream state is allocated separately
+    size_t read_buffer_bytes;    // Message buffer capacity held across sessions
+    size_t idle_reads;           // Sessions parked in a zero-byte read (compact_sessions)
+    size_t outbound_queues;      // Sessions with outbound lanes allocated
+    size_t queued_frame_bytes;   // Frames referenced by outbound queues (shared frames count once per session)
+};
+
+SessionMemoryStats get_session_memory_stats();
+
 /**
  * WebSocket Server with KeepAlive mechanism
+ * Every accepted connection goes through the ConnectionLimiter before its
+ * handshake starts; rejected sockets are closed without a reply.
+ * Broadcasts also reach the SubscriberHub (Server-Sent Events streams) with
+ * the same frames.
  */
 class WebSocketServer : public std::enable_shared_from_this<WebSocketServer> {
 public:
-    WebSocketServer(boost::asio::io_context& io_context, unsigned short port);
+    WebSocketServer(boost::asio::io_context& io_context, unsigned short port,
+                    const ListenerConfig& listener = ListenerConfig{});
     ~WebSocketServer();
 
     void start();  // Must be called after construction
+    void stop();   // Stop accepting; call before io_context is destroyed
+    unsigned short local_port() const;  // Bound port (useful when constructed with port 0)
     size_t client_count() const;
+    uint64_t accepted_connections() const;
     void broadcast_pending_events();
+    void check_keepalives();  // Ping idle clients and close unresponsive ones
     void register_client(std::shared_ptr<WsSession> client);
     void unregister_client(std::shared_ptr<WsSession> client);
 
+    /**
+     * Listening sockets, main acceptor first, for a hot restart handoff
+     */
+    std::vector<int> listening_handles();
+
+    /**
+     * Close the listening sockets on the server thread (any thread)
+     */
+    void stop_accepting();
+
+    /**
+     * Run task on the server thread between broadcast batches, when every
+     * event dequeued so far has reached the StateStore and the delta bases
+     */
+    void post_between_batches(std::function<void()> task);
+
+    /**
+     * Hot restart: close every client with close_for_restart, an even share
+     * per tick across window so that reconnects arrive spread out, each with a
+     * random retry_after_ms up to reconnect_jitter. on_drained runs on the
+     * server thread once all are closed and the close handshakes had a moment
+     * to finish.
+     */
+    void drain_for_restart(std::chrono::milliseconds window,
+                           std::chrono::milliseconds reconnect_jitter,
+                           std::function<void()> on_drained);
+
 private:
+    struct Drain;
+    static constexpr auto DRAIN_TICK = std::chrono::milliseconds(50);
+    static constexpr auto DRAIN_CLOSE_GRACE = std::chrono::seconds(1);
+
     boost::asio::io_context& io_context_;
+    IoThreadPool accept_threads_;  // Runs the additional SO_REUSEPORT acceptors
     tcp::acceptor acceptor_;
+    // Accept on their own threads; sessions are still created on io_context_,
+    // which owns every session's outbound queue
+    std::vector<tcp::acceptor> extra_acceptors_;
+    std::atomic<uint64_t> accepted_{0};
     std::vector<std::shared_ptr<WsSession>> clients_;
     mutable std::mutex clients_mutex_;
 
     void start_accept();
+    void start_accept_on(tcp::acceptor& acceptor);
+    void drain_step(std::shared_ptr<Drain> drain);
+    // Delta bases, plus the latest event of every other type with snapshot_on_connect
+    std::vector<SharedFrame> initial_snapshot() const;
+    // Send snapshots to SubscriberHub joiners and start delivering to them
+    void admit_hub_subscribers();
+    // Re-arm an acceptor, after a pause when descriptors are running out
+    void accept_next(tcp::acceptor& acceptor, const boost::system::error_code& ec,
+                     std::function<void()> rearm);
 
     friend class WsSession;
 };
@@ -0,0 +1,46 @@
+﻿#include "alloc_counter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> g_allocation_count{0};
+std::atomic<uint64_t> g_allocation_bytes{0};
+
+thread_local uint64_t t_allocation_count = 0;
+thread_local uint64_t t_allocation_bytes = 0;
+
+}  // namespace
+
+AllocationSnapshot allocation_snapshot() {
+    return AllocationSnapshot{
+        g_allocation_count.load(std::memory_order_relaxed),
+        g_allocation_bytes.load(std::memory_order_relaxed)
+    };
+}
+
+AllocationSnapshot thread_allocation_snapshot() {
+    return AllocationSnapshot{t_allocation_count, t_allocation_bytes};
+}
+
+// Replacement global allocation functions (array and nothrow forms forward here)
+
+void* operator new(std::size_t size) {
+    g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    g_allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    t_allocation_count++;
+    t_allocation_bytes += size;
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
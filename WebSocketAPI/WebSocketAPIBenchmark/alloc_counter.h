@@ -0,0 +1,23 @@
+﻿#pragma once
+
+#include <cstdint>
+
+/**
+ * Process-wide heap allocation counters
+ * alloc_counter.cpp replaces global operator new/delete to maintain them.
+ */
+struct AllocationSnapshot {
+    uint64_t count;
+    uint64_t bytes;
+};
+
+/**
+ * Allocations made so far by operator new (all threads)
+ */
+AllocationSnapshot allocation_snapshot();
+
+/**
+ * Allocations made so far by operator new on the calling thread
+ * Use this in multi-threaded benchmarks so each thread reports its own work.
+ */
+AllocationSnapshot thread_allocation_snapshot();
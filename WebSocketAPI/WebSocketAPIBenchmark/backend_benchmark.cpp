@@ -0,0 +1,134 @@
+﻿/**
+ * Ingest + fan-out on the compiled-in Asio backend (epoll or io_uring)
+ * An op is one POST /api/event over a fresh loopback connection, followed by
+ * the broadcast of that event to every WebSocket client (the Arg).
+ * Build the benchmark twice, with and without WEBSOCKETAPI_IO_URING, and
+ * compare items_per_second (events/s), syscalls_per_event and
+ * ctx_switches_per_event. The label names the backend.
+ */
+#include "benchmark_fixtures.h"
+#include "syscall_counter.h"
+#include "../WebSocketAPI/rate_limiter.h"
+#include "../WebSocketAPI/rest_api_server.h"
+#include "../WebSocketAPI/websocket_server.h"
+#include <benchmark/benchmark.h>
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+const std::string INGEST_BODY =
+    R"({"type":"user_action","data":{"action":"login","user_id":123,"username":"john_doe"}})";
+
+/**
+ * One REST ingest: connect, send, read until the server closes
+ */
+struct IngestRequest : std::enable_shared_from_this<IngestRequest> {
+    tcp::socket socket;
+    std::string request;
+    std::string response;
+    bool& done;
+
+    IngestRequest(boost::asio::io_context& io_context, const std::string& request_text, bool& done_flag)
+        : socket(io_context), request(request_text), done(done_flag) {}
+
+    void start(const tcp::endpoint& endpoint) {
+        auto self = shared_from_this();
+        socket.async_connect(endpoint, [self](const boost::system::error_code& ec) {
+            if (ec) {
+                self->done = true;
+                return;
+            }
+            boost::asio::async_write(self->socket, boost::asio::buffer(self->request),
+                [self](const boost::system::error_code& ec, std::size_t) {
+                    if (ec) {
+                        self->done = true;
+                        return;
+                    }
+                    boost::asio::async_read(self->socket, boost::asio::dynamic_buffer(self->response),
+                        [self](const boost::system::error_code&, std::size_t) {
+                            self->done = true;
+                        });
+                });
+        });
+    }
+};
+
+void BM_IngestFanout(benchmark::State& state) {
+    const size_t client_total = static_cast<size_t>(state.range(0));
+
+    RateLimitConfig no_limits;
+    no_limits.enabled = false;
+    get_rate_limiter().configure(no_limits);
+    auto& event_manager = get_event_manager();
+    event_manager.clear_events();
+
+    boost::asio::io_context io_context;
+    RestApiServer rest_server(io_context, 0);
+    auto ws_server = std::make_shared<WebSocketServer>(io_context, 0);
+    ws_server->start();
+
+    tcp::endpoint rest_endpoint(boost::asio::ip::address_v4::loopback(), rest_server.local_port());
+    tcp::endpoint ws_endpoint(boost::asio::ip::address_v4::loopback(), ws_server->local_port());
+
+    auto clients = connect_clients(io_context, *ws_server, ws_endpoint, client_total);
+
+    size_t received = 0;
+    for (auto& client : clients) {
+        read_loop(*client, received);
+    }
+
+    const std::string request_text =
+        "POST /api/event HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: " + std::to_string(INGEST_BODY.size()) + "\r\n"
+        "\r\n" + INGEST_BODY;
+
+    SyscallCounter syscalls;
+    uint64_t syscalls_before = syscalls.read();
+    uint64_t switches_before = context_switches();
+    for (auto _ : state) {
+        bool ingested = false;
+        std::make_shared<IngestRequest>(io_context, request_text, ingested)->start(rest_endpoint);
+        while (!ingested) {
+            io_context.run_one();
+        }
+        if (!event_manager.has_events()) {
+            state.SkipWithError("POST /api/event did not queue an event");
+            break;
+        }
+
+        size_t target = received + client_total;
+        ws_server->broadcast_pending_events();
+        while (received < target) {
+            io_context.run_one();
+        }
+    }
+    uint64_t syscall_total = syscalls.read() - syscalls_before;
+    uint64_t switch_total = context_switches() - switches_before;
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    state.SetLabel(asio_backend_name());
+    state.counters["clients"] = static_cast<double>(client_total);
+    if (syscalls.available()) {
+        state.counters["syscalls_per_event"] = benchmark::Counter(
+            static_cast<double>(syscall_total), benchmark::Counter::kAvgIterations);
+    }
+    state.counters["ctx_switches_per_event"] = benchmark::Counter(
+        static_cast<double>(switch_total), benchmark::Counter::kAvgIterations);
+
+    for (auto& client : clients) {
+        boost::system::error_code ec;
+        client->ws.next_layer().close(ec);
+    }
+    ws_server->stop();
+    io_context.stop();
+    get_rate_limiter().configure(RateLimitConfig{});
+}
+BENCHMARK(BM_IngestFanout)->Arg(1)->Arg(16)->Arg(128)->UseRealTime();
+
+}  // namespace
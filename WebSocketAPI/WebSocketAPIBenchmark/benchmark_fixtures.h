@@ -0,0 +1,99 @@
+﻿#pragma once
+
+#include "alloc_counter.h"
+#include "../WebSocketAPI/common.h"
+#include "../WebSocketAPI/memory_pool.h"
+#include "../WebSocketAPI/websocket_server.h"
+#include <benchmark/benchmark.h>
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <memory>
+#include <vector>
+
+/**
+ * Fixtures shared by the benchmark files
+ */
+
+inline json make_payload() {
+    return json{
+        {"action", "login"},
+        {"user_id", 123},
+        {"username", "john_doe"},
+        {"tags", {"mobile", "ios"}}
+    };
+}
+
+/**
+ * A typical user_action event; publish_event replaces the sequence
+ */
+inline Event make_event(const json& payload) {
+    Event event;
+    event.type = "user_action";
+    event.timestamp = "2026-01-25T10:30:00.000Z";
+    event.payload = payload;
+    event.sequence = 42;
+    return event;
+}
+
+inline void report_allocations(benchmark::State& state, uint64_t allocations) {
+    state.counters["allocs_per_op"] = benchmark::Counter(
+        static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+}
+
+/**
+ * In-process WebSocket client on a loopback connection
+ */
+struct BenchmarkClient {
+    websocket::stream<tcp::socket> ws;
+    beast::flat_buffer buffer;
+
+    explicit BenchmarkClient(boost::asio::io_context& io_context) : ws(io_context) {}
+};
+
+/**
+ * Connect and handshake client_total clients, running io_context until the
+ * server has registered all of them
+ */
+inline std::vector<std::unique_ptr<BenchmarkClient>> connect_clients(
+    boost::asio::io_context& io_context, WebSocketServer& server, const tcp::endpoint& endpoint,
+    size_t client_total) {
+    std::vector<std::unique_ptr<BenchmarkClient>> clients;
+    size_t handshakes = 0;
+    for (size_t i = 0; i < client_total; i++) {
+        clients.push_back(std::make_unique<BenchmarkClient>(io_context));
+        auto& client = *clients.back();
+        client.ws.next_layer().async_connect(endpoint,
+            [&client, &handshakes](const boost::system::error_code& ec) {
+                if (ec) {
+                    return;
+                }
+                client.ws.async_handshake("localhost", "/",
+                    [&handshakes](const boost::system::error_code& ec) {
+                        if (!ec) {
+                            handshakes++;
+                        }
+                    });
+            });
+    }
+    while (handshakes < client_total || server.client_count() < client_total) {
+        io_context.run_one();
+    }
+    return clients;
+}
+
+/**
+ * Count every message the client receives until the connection closes
+ * Reads with the same recycling handlers as the server so the clients add no
+ * allocations of their own.
+ */
+inline void read_loop(BenchmarkClient& client, size_t& received) {
+    client.ws.async_read(client.buffer, make_recycling_handler(
+        [&client, &received](const boost::system::error_code& ec, std::size_t bytes) {
+            if (ec) {
+                return;
+            }
+            client.buffer.consume(bytes);
+            received++;
+            read_loop(client, received);
+        }));
+}
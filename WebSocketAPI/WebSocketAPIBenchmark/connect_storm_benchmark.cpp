@@ -0,0 +1,136 @@
+﻿/**
+ * Connect storm: accepted connections per second, single acceptor vs.
+ * several SO_REUSEPORT acceptors (the Arg is the acceptor count)
+ * Client threads open a batch of connections as fast as they can, hold them
+ * until the server has accepted all of them, then reset them (no TIME_WAIT).
+ * items_per_second is accepted connections per second. Connection limits are
+ * lifted for the WebSocket storm, which comes from a single address.
+ */
+#include "../WebSocketAPI/connection_limiter.h"
+#include "../WebSocketAPI/listener.h"
+#include "../WebSocketAPI/rest_api_server.h"
+#include "../WebSocketAPI/websocket_server.h"
+#include <benchmark/benchmark.h>
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t STORM_CONNECTIONS = 1000;
+constexpr size_t STORM_CLIENT_THREADS = 8;
+constexpr int STORM_BACKLOG = 4096;
+constexpr auto STORM_TIMEOUT = std::chrono::seconds(10);
+
+ListenerConfig make_listener(const benchmark::State& state) {
+    ListenerConfig listener;
+    listener.backlog = STORM_BACKLOG;
+    listener.acceptor_count = static_cast<size_t>(state.range(0));
+    return listener;
+}
+
+/**
+ * One storm: connect, wait until the server accepted everything, reset
+ * @return false when the server did not accept the whole batch in time
+ */
+template <typename Server>
+bool run_storm(const Server& server, unsigned short port) {
+    const uint64_t target = server.accepted_connections() + STORM_CONNECTIONS;
+    const tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), port);
+
+    boost::asio::io_context client_context;
+    std::vector<std::vector<tcp::socket>> sockets(STORM_CLIENT_THREADS);
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < STORM_CLIENT_THREADS; t++) {
+        workers.emplace_back([&, t]() {
+            while (next.fetch_add(1, std::memory_order_relaxed) < STORM_CONNECTIONS) {
+                tcp::socket socket(client_context);
+                boost::system::error_code ec;
+                socket.connect(endpoint, ec);
+                if (!ec) {
+                    sockets[t].push_back(std::move(socket));
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + STORM_TIMEOUT;
+    while (server.accepted_connections() < target) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+
+    for (auto& batch : sockets) {
+        for (auto& socket : batch) {
+            boost::system::error_code ec;
+            socket.set_option(boost::asio::socket_base::linger(true, 0), ec);
+            socket.close(ec);
+        }
+    }
+    return true;
+}
+
+void report(benchmark::State& state) {
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * STORM_CONNECTIONS));
+    state.counters["acceptors"] = static_cast<double>(state.range(0));
+}
+
+void BM_ConnectStorm_Rest(benchmark::State& state) {
+    boost::asio::io_context io_context;
+    RestApiServer server(io_context, 0, make_listener(state));
+    auto work_guard = boost::asio::make_work_guard(io_context);
+    std::thread io_thread([&io_context]() { io_context.run(); });
+
+    for (auto _ : state) {
+        if (!run_storm(server, server.local_port())) {
+            state.SkipWithError("server did not accept the whole batch");
+            break;
+        }
+    }
+    report(state);
+
+    work_guard.reset();
+    io_context.stop();
+    io_thread.join();
+}
+BENCHMARK(BM_ConnectStorm_Rest)->Arg(1)->Arg(4)->UseRealTime();
+
+void BM_ConnectStorm_WebSocket(benchmark::State& state) {
+    ConnectionLimitConfig no_limits;
+    no_limits.max_connections = 0;
+    no_limits.max_connections_per_ip = 0;
+    no_limits.max_pending_handshakes = 0;
+    get_connection_limiter().configure(no_limits);
+
+    boost::asio::io_context io_context;
+    auto server = std::make_shared<WebSocketServer>(io_context, 0, make_listener(state));
+    server->start();
+    auto work_guard = boost::asio::make_work_guard(io_context);
+    std::thread io_thread([&io_context]() { io_context.run(); });
+
+    for (auto _ : state) {
+        if (!run_storm(*server, server->local_port())) {
+            state.SkipWithError("server did not accept the whole batch");
+            break;
+        }
+    }
+    report(state);
+
+    server->stop();
+    work_guard.reset();
+    io_context.stop();
+    io_thread.join();
+    get_connection_limiter().configure(ConnectionLimitConfig{});
+}
+BENCHMARK(BM_ConnectStorm_WebSocket)->Arg(1)->Arg(4)->UseRealTime();
+
+}  // namespace
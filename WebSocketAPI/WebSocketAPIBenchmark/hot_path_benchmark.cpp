@@ -0,0 +1,398 @@
+﻿/**
+ * Per-request and per-event hot functions in isolation
+ * Every benchmark reports allocs_per_op next to time, where an op is one
+ * request, one event or one timestamp. The multi-threaded EventManager
+ * benchmarks count allocations per thread.
+ *
+ * Also builds on Linux with the CMakeLists.txt next to WebSocketAPI.slnx.
+ */
+#include "benchmark_fixtures.h"
+#include "../WebSocketAPI/event_manager.h"
+#include "../WebSocketAPI/http_router.h"
+#include "../WebSocketAPI/ingest_capture.h"
+#include "../WebSocketAPI/rate_limiter.h"
+#include "../WebSocketAPI/rest_api_server.h"
+#include "../WebSocketAPI/state_store.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace {
+
+const std::string EVENT_BODY =
+    R"({"type":"user_action","data":{"action":"login","user_id":123,"username":"john_doe",)"
+    R"("tags":["mobile","ios"]}})";
+
+// What a typical producer (curl, an HTTP client library) sends
+std::string make_request(const std::string& body) {
+    return "POST /api/event HTTP/1.1\r\n"
+           "Host: localhost:8081\r\n"
+           "User-Agent: curl/8.5.0\r\n"
+           "Accept: */*\r\n"
+           "X-API-Key: producer-1\r\n"
+           "Content-Type: application/json\r\n"
+           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+           "\r\n" + body;
+}
+
+// Same steps as HttpSession::handle_request: find the header block, then
+// wait until Content-Length bytes of body are buffered
+bool parse_buffered(std::string_view buffer, HttpRequestHead& head) {
+    std::array<char, 2048> arena_storage;
+    std::pmr::monotonic_buffer_resource arena(arena_storage.data(), arena_storage.size());
+    std::pmr::string headers_lower(&arena);
+    if (!parse_request_head(buffer, headers_lower, head)) {
+        return false;
+    }
+    return buffer.size() >= head.header_bytes + head.content_length;
+}
+
+// Request parsing: whole request in one read vs. the Arg bytes per read
+
+void BM_ParseRequest_Whole(benchmark::State& state) {
+    const std::string request = make_request(EVENT_BODY);
+    std::vector<char> buffer;
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        auto before = thread_allocation_snapshot();
+        buffer.assign(request.begin(), request.end());
+        HttpRequestHead head;
+        bool complete = parse_buffered(std::string_view(buffer.data(), buffer.size()), head);
+        benchmark::DoNotOptimize(complete);
+        benchmark::DoNotOptimize(head);
+        allocations += thread_allocation_snapshot().count - before.count;
+    }
+    report_allocations(state, allocations);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * request.size()));
+}
+BENCHMARK(BM_ParseRequest_Whole);
+
+void BM_ParseRequest_Fragmented(benchmark::State& state) {
+    const std::string request = make_request(EVENT_BODY);
+    const size_t fragment = static_cast<size_t>(state.range(0));
+    std::vector<char> buffer;
+    buffer.reserve(request.size());
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        auto before = thread_allocation_snapshot();
+        buffer.clear();
+        bool complete = false;
+        HttpRequestHead head;
+        for (size_t offset = 0; !complete && offset < request.size(); offset += fragment) {
+            size_t length = std::min(fragment, request.size() - offset);
+            buffer.insert(buffer.end(), request.begin() + offset, request.begin() + offset + length);
+            complete = parse_buffered(std::string_view(buffer.data(), buffer.size()), head);
+        }
+        benchmark::DoNotOptimize(complete);
+        allocations += thread_allocation_snapshot().count - before.count;
+    }
+    report_allocations(state, allocations);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * request.size()));
+}
+BENCHMARK(BM_ParseRequest_Fragmented)->Arg(16)->Arg(64)->Arg(256);
+
+// POST /api/event: validate, build the event, queue it and build the reply
+
+void BM_HandlePostEvent(benchmark::State& state) {
+    auto& manager = get_event_manager();
+    manager.clear_events();
+    Event drained;
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        auto before = thread_allocation_snapshot();
+        auto response = handle_post_event(EVENT_BODY);
+        benchmark::DoNotOptimize(response->body.data());
+        allocations += thread_allocation_snapshot().count - before.count;
+
+        // Keep the queue from filling up; not part of the measurement
+        state.PauseTiming();
+        manager.get_next_event(drained);
+        state.ResumeTiming();
+    }
+    report_allocations(state, allocations);
+}
+BENCHMARK(BM_HandlePostEvent);
+
+void BM_HandlePostEvent_InvalidJson(benchmark::State& state) {
+    const std::string body = R"({"type":"user_action","data":{"action":)";
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        auto before = thread_allocation_snapshot();
+        auto response = handle_post_event(body);
+        benchmark::DoNotOptimize(response->body.data());
+        allocations += thread_allocation_snapshot().count - before.count;
+    }
+    report_allocations(state, allocations);
+}
+BENCHMARK(BM_HandlePostEvent_InvalidJson);
+
+// A producer retry answered from the idempotency index, before its body is parsed
+void BM_HandlePostEvent_DuplicateKey(benchmark::State& state) {
+    auto& manager = get_event_manager();
+    manager.clear_events();
+    const std::string key = "bm-duplicate-key";
+    auto first = handle_post_event(EVENT_BODY, key);
+    benchmark::DoNotOptimize(first->body.data());
+    manager.clear_events();
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        auto before = thread_allocation_snapshot();
+        auto response = handle_post_event(EVENT_BODY, key);
+        benchmark::DoNotOptimize(response->body.data());
+        allocations += thread_allocation_snapshot().count - before.count;
+    }
+    report_allocations(state, allocations);
+}
+BENCHMARK(BM_HandlePostEvent_DuplicateKey);
+
+// The same with ingest capture on: the request thread only appends to the
+// capture buffer, the file is written by the capture's own thread
+void BM_HandlePostEvent_Capture(benchmark::State& state) {
+    auto& manager = get_event_manager();
+    manager.clear_events();
+    IngestCaptureConfig config;
+    config.enabled = true;
+    config.path = "bm_ingest_capture.bin";
+    auto& capture = get_ingest_capture();
+    capture.configure(config);
+    Event drained;
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        auto before = thread_allocation_snapshot();
+        auto response = handle_post_event(EVENT_BODY);
+        benchmark::DoNotOptimize(response->body.data());
+        allocations += thread_allocation_snapshot().count - before.count;
+
+        state.PauseTiming();
+        manager.get_next_event(drained);
+        state.ResumeTiming();
+    }
+    report_allocations(state, allocations);
+    state.counters["dropped"] = static_cast<double>(capture.get_stats().dropped);
+    capture.configure(IngestCaptureConfig{});
+    std::remove(config.path.c_str());
+}
+BENCHMARK(BM_HandlePostEvent_Capture);
+
+// Routing: one lookup with a path and a query parameter, among the Arg
+// routes of a table shaped like a growing REST API
+
+void BM_Router_Find(benchmark::State& state) {
+    const size_t route_count = static_cast<size_t>(state.range(0));
+    HttpRouter router;
+    router.add(HttpMethod::get, "/api/state/{type}");
+    for (size_t i = 1; i < route_count; i++) {
+        std::string resource = "/api/resource" + std::to_string(i);
+        router.add(i % 2 ? HttpMethod::get : HttpMethod::post, resource + "/{id}/items");
+    }
+    const std::string target = "/api/state/device_state?limit=50";
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        auto before = thread_allocation_snapshot();
+        RouteParams params;
+        size_t route = router.find(HttpMethod::get, target, params);
+        auto limit = params.query_as<int>("limit");
+        benchmark::DoNotOptimize(route);
+        benchmark::DoNotOptimize(params.path("type"));
+        benchmark::DoNotOptimize(limit);
+        allocations += thread_allocation_snapshot().count - before.count;
+    }
+    report_allocations(state, allocations);
+}
+BENCHMARK(BM_Router_Find)->Arg(4)->Arg(64)->Arg(1024);
+
+// Rate limiting a client never seen before, with max_tracked_clients (the Arg)
+// buckets all in use: the cost should not grow with the table
+
+void BM_RateLimiter_NewClient(benchmark::State& state) {
+    RateLimitConfig config;
+    config.per_client_rate = 0.01;  // A used bucket stays in use for 100 s
+    config.global_rate = 0.0;
+    config.max_tracked_clients = static_cast<size_t>(state.range(0));
+    RateLimiter limiter;
+    limiter.configure(config);
+    for (size_t i = 0; i < config.max_tracked_clients * 2; i++) {
+        limiter.check("10.0." + std::to_string(i));
+    }
+
+    std::vector<std::string> new_clients;
+    for (size_t i = 0; i < 1024 * 1024; i++) {
+        new_clients.push_back("172.16." + std::to_string(i));
+    }
+    size_t next_client = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(limiter.check(new_clients[next_client++ % new_clients.size()]));
+    }
+    state.counters["untracked"] = static_cast<double>(limiter.get_stats().untracked);
+}
+BENCHMARK(BM_RateLimiter_NewClient)->Arg(1024)->Arg(65536);
+
+// Event serialization
+
+void BM_Event_ToJson(benchmark::State& state) {
+    const Event event = make_event(make_payload());
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        auto before = thread_allocation_snapshot();
+        json value = event.to_json();
+        benchmark::DoNotOptimize(value);
+        allocations += thread_allocation_snapshot().count - before.count;
+    }
+    report_allocations(state, allocations);
+}
+BENCHMARK(BM_Event_ToJson);
+
+void BM_Event_ToJsonDump(benchmark::State& state) {
+    const Event event = make_event(make_payload());
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        auto before = thread_allocation_snapshot();
+        std::string frame = event.to_json().dump();
+        benchmark::DoNotOptimize(frame.data());
+        allocations += thread_allocation_snapshot().count - before.count;
+    }
+    report_allocations(state, allocations);
+}
+BENCHMARK(BM_Event_ToJsonDump);
+
+void BM_Event_ToString(benchmark::State& state) {
+    const Event event = make_event(make_payload());
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        auto before = thread_allocation_snapshot();
+        std::string frame = event.to_string();
+        benchmark::DoNotOptimize(frame.data());
+        allocations += thread_allocation_snapshot().count - before.count;
+    }
+    report_allocations(state, allocations);
+}
+BENCHMARK(BM_Event_ToString);
+
+// Timestamping, once per published event
+
+void BM_Iso8601Timestamp(benchmark::State& state) {
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        auto before = thread_allocation_snapshot();
+        std::string timestamp = get_iso8601_timestamp();
+        benchmark::DoNotOptimize(timestamp.data());
+        allocations += thread_allocation_snapshot().count - before.count;
+    }
+    report_allocations(state, allocations);
+}
+BENCHMARK(BM_Iso8601Timestamp);
+
+// EventManager under contention: every thread publishes one event and
+// dequeues one, so the queue stays short while the lock is contended
+
+std::unique_ptr<EventManager> contended_manager;
+
+void BM_EventManager_PublishDequeue(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        contended_manager = std::make_unique<EventManager>();
+    }
+    const json payload = make_payload();
+    Event drained;
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        auto before = thread_allocation_snapshot();
+        contended_manager->publish_event(make_event(payload));
+        benchmark::DoNotOptimize(contended_manager->get_next_event(drained));
+        allocations += thread_allocation_snapshot().count - before.count;
+    }
+    report_allocations(state, allocations);
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        contended_manager.reset();
+    }
+}
+BENCHMARK(BM_EventManager_PublishDequeue)->ThreadRange(1, 8)->UseRealTime();
+
+// Producers only, with one consumer thread draining: the REST threads vs. the
+// broadcast loop
+
+void BM_EventManager_ProducersOneConsumer(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        contended_manager = std::make_unique<EventManager>();
+    }
+    const json payload = make_payload();
+    Event drained;
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        auto before = thread_allocation_snapshot();
+        if (state.thread_index() == 0) {
+            while (contended_manager->get_next_event(drained)) {
+            }
+        } else {
+            contended_manager->publish_event(make_event(payload));
+        }
+        allocations += thread_allocation_snapshot().count - before.count;
+    }
+    report_allocations(state, allocations);
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        contended_manager.reset();
+    }
+}
+BENCHMARK(BM_EventManager_ProducersOneConsumer)->ThreadRange(2, 8)->UseRealTime();
+
+// Draining a backlog of 1000 events, live (arg 0) or all past their TTL (arg 1):
+// stale events should cost no more than a pop
+
+void BM_EventManager_DrainExpired(benchmark::State& state) {
+    constexpr int BACKLOG = 1000;
+    EventManager manager;
+    const json payload = make_payload();
+    Event drained;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (int i = 0; i < BACKLOG; i++) {
+            Event event = make_event(payload);
+            if (state.range(0)) {
+                event.expires_at = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(1));
+            }
+            manager.publish_event(std::move(event));
+        }
+        state.ResumeTiming();
+        while (manager.get_next_event(drained)) {
+            benchmark::DoNotOptimize(drained.sequence);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * BACKLOG);
+}
+BENCHMARK(BM_EventManager_DrainExpired)->Arg(0)->Arg(1);
+
+// One keyed update and commit per batch, with a type already holding Arg keys:
+// the commit should not copy the whole type
+
+void BM_StateStore_UpdateCommit(benchmark::State& state) {
+    StateConfig config;
+    config.type_keys = {{"device_state", "/device_id"}};
+    config.max_entries = static_cast<size_t>(state.range(0)) + 1;
+    StateStore store;
+    store.configure(config);
+    Event event;
+    event.type = "device_state";
+    auto frame = std::make_shared<const std::string>("{}");
+    for (int64_t i = 0; i < state.range(0); i++) {
+        event.payload = json{{"device_id", i}};
+        store.update(event, frame);
+    }
+    store.commit();
+
+    int64_t next_key = 0;
+    for (auto _ : state) {
+        event.payload = json{{"device_id", next_key++ % state.range(0)}};
+        store.update(event, frame);
+        store.commit();
+    }
+    state.counters["version"] = static_cast<double>(store.get_stats().version);
+}
+BENCHMARK(BM_StateStore_UpdateCommit)->Arg(1024)->Arg(65536);
+
+}  // namespace
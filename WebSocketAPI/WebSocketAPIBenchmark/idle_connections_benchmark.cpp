@@ -0,0 +1,226 @@
+﻿/**
+ * Idle subscribers: resident memory per open WebSocket connection
+ * Opens Arg(0) upgraded connections that then stay silent and reports how
+ * far process RSS and the live heap grew per connection, with
+ * compact_sessions off (Arg(1) = 0) and on (Arg(1) = 1). Clients are plain
+ * sockets outside Asio, so their only user-space cost is a descriptor number;
+ * kernel socket buffers are not part of RSS on either side. Clients bind to
+ * 127.0.0.2 and up, CLIENTS_PER_ADDRESS each, to stay clear of ephemeral
+ * port exhaustion. Each connection needs two descriptors; the benchmark
+ * raises the soft open file limit and skips sizes that do not fit.
+ * Linux only (RSS from /proc/self/statm).
+ */
+#include "../WebSocketAPI/connection_limiter.h"
+#include "../WebSocketAPI/server_config.h"
+#include "../WebSocketAPI/websocket_server.h"
+#include <benchmark/benchmark.h>
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <fstream>
+#include <malloc.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t CLIENTS_PER_ADDRESS = 20000;
+constexpr size_t HANDSHAKE_BATCH = 512;
+constexpr auto SETTLE_TIMEOUT = std::chrono::seconds(60);
+
+const std::string UPGRADE_REQUEST =
+    "GET / HTTP/1.1\r\n"
+    "Host: 127.0.0.1\r\n"
+    "Upgrade: websocket\r\n"
+    "Connection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+    "Sec-WebSocket-Version: 13\r\n"
+    "\r\n";
+
+size_t raise_open_file_limit() {
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return 0;
+    }
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    return static_cast<size_t>(limit.rlim_cur);
+}
+
+size_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    statm >> total_pages >> resident_pages;
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+size_t heap_in_use() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+int connect_client(unsigned short port, size_t index) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    sockaddr_in source{};
+    source.sin_family = AF_INET;
+    source.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1 + static_cast<uint32_t>(index / CLIENTS_PER_ADDRESS));
+    sockaddr_in server{};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(port);
+    server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&source), sizeof(source)) != 0 ||
+        ::connect(fd, reinterpret_cast<sockaddr*>(&server), sizeof(server)) != 0 ||
+        ::send(fd, UPGRADE_REQUEST.data(), UPGRADE_REQUEST.size(), MSG_NOSIGNAL) !=
+            static_cast<ssize_t>(UPGRADE_REQUEST.size())) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool read_upgrade_response(int fd) {
+    std::string response;
+    char chunk[512];
+    while (response.find("\r\n\r\n") == std::string::npos) {
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        response.append(chunk, static_cast<size_t>(n));
+    }
+    return response.compare(0, 12, "HTTP/1.1 101") == 0;
+}
+
+/**
+ * Open and upgrade count connections, a batch of handshakes at a time
+ * @return false when a connection could not be opened or was refused
+ */
+bool open_clients(unsigned short port, size_t count, std::vector<int>& fds) {
+    while (fds.size() < count) {
+        size_t batch_start = fds.size();
+        size_t batch_end = std::min(count, batch_start + HANDSHAKE_BATCH);
+        for (size_t i = batch_start; i < batch_end; i++) {
+            int fd = connect_client(port, i);
+            if (fd < 0) {
+                return false;
+            }
+            fds.push_back(fd);
+        }
+        for (size_t i = batch_start; i < batch_end; i++) {
+            if (!read_upgrade_response(fds[i])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void close_clients(std::vector<int>& fds) {
+    for (int fd : fds) {
+        linger reset{1, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        ::close(fd);
+    }
+    fds.clear();
+}
+
+template <typename Condition>
+bool wait_for(Condition condition) {
+    auto deadline = std::chrono::steady_clock::now() + SETTLE_TIMEOUT;
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+void BM_IdleConnections(benchmark::State& state) {
+    const size_t connections = static_cast<size_t>(state.range(0));
+    const bool compact = state.range(1) != 0;
+    if (raise_open_file_limit() < connections * 2 + 256) {
+        state.SkipWithError("open file limit too low for this many connections");
+        return;
+    }
+
+    ConnectionLimitConfig no_limits;
+    no_limits.max_connections = 0;
+    no_limits.max_connections_per_ip = 0;
+    no_limits.max_pending_handshakes = 0;
+    get_connection_limiter().configure(no_limits);
+    ServerConfig config;
+    config.compact_sessions = compact;
+    get_runtime_tunables().set(config);
+
+    boost::asio::io_context io_context;
+    auto server = std::make_shared<WebSocketServer>(io_context, 0);
+    server->start();
+    auto work_guard = boost::asio::make_work_guard(io_context);
+    std::thread io_thread([&io_context]() { io_context.run(); });
+
+    std::vector<int> fds;
+    fds.reserve(connections);
+    for (auto _ : state) {
+        malloc_trim(0);
+        size_t rss_before = resident_bytes();
+        size_t heap_before = heap_in_use();
+
+        if (!open_clients(server->local_port(), connections, fds) ||
+            !wait_for([&]() { return server->client_count() >= connections; })) {
+            state.SkipWithError("could not open and upgrade every connection");
+            break;
+        }
+        // Let every session reach its idle read
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        auto memory = get_session_memory_stats();
+        double per_connection = 1.0 / static_cast<double>(connections);
+        state.counters["rss_per_conn"] =
+            (static_cast<double>(resident_bytes()) - static_cast<double>(rss_before)) * per_connection;
+        state.counters["heap_per_conn"] =
+            (static_cast<double>(heap_in_use()) - static_cast<double>(heap_before)) * per_connection;
+        state.counters["read_buffer_per_conn"] =
+            static_cast<double>(memory.read_buffer_bytes) * per_connection;
+        state.counters["session_bytes"] = static_cast<double>(memory.session_bytes);
+        state.counters["idle_reads"] = static_cast<double>(memory.idle_reads);
+
+        close_clients(fds);
+        if (!wait_for([&]() { return server->client_count() == 0; })) {
+            state.SkipWithError("server did not drop the closed connections");
+            break;
+        }
+    }
+
+    server->stop();
+    work_guard.reset();
+    io_context.stop();
+    io_thread.join();
+    get_runtime_tunables().set(ServerConfig{});
+    get_connection_limiter().configure(ConnectionLimitConfig{});
+}
+BENCHMARK(BM_IdleConnections)
+    ->ArgNames({"connections", "compact"})
+    ->Args({10000, 0})->Args({10000, 1})
+    ->Args({200000, 0})->Args({200000, 1})
+    ->Iterations(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}  // namespace
+#endif
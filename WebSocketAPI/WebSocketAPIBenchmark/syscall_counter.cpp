@@ -0,0 +1,72 @@
+﻿#include "syscall_counter.h"
+
+#if defined(__linux__)
+#include <fstream>
+#include <string>
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+long tracepoint_id(const char* event) {
+    for (const char* root : {"/sys/kernel/tracing/events/", "/sys/kernel/debug/tracing/events/"}) {
+        std::ifstream file(std::string(root) + event + "/id");
+        long id = -1;
+        if (file >> id) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+}  // namespace
+
+SyscallCounter::SyscallCounter() {
+    long id = tracepoint_id("raw_syscalls/sys_enter");
+    if (id < 0) {
+        return;
+    }
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_TRACEPOINT;
+    attr.size = sizeof(attr);
+    attr.config = static_cast<uint64_t>(id);
+    attr.inherit = 1;
+    fd_ = static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+SyscallCounter::~SyscallCounter() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+uint64_t SyscallCounter::read() const {
+    uint64_t count = 0;
+    if (fd_ < 0 || ::read(fd_, &count, sizeof(count)) != sizeof(count)) {
+        return 0;
+    }
+    return count;
+}
+
+uint64_t context_switches() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_nvcsw + usage.ru_nivcsw);
+}
+
+#else
+
+SyscallCounter::SyscallCounter() {}
+SyscallCounter::~SyscallCounter() {}
+
+uint64_t SyscallCounter::read() const {
+    return 0;
+}
+
+uint64_t context_switches() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,29 @@
+﻿#pragma once
+
+#include <cstdint>
+
+/**
+ * Counts system calls made by the calling thread (and threads it starts later)
+ * Linux only, through the raw_syscalls:sys_enter tracepoint; needs tracefs and
+ * perf_event access. available() is false elsewhere, and the benchmarks then
+ * leave the syscall counter out.
+ */
+class SyscallCounter {
+public:
+    SyscallCounter();
+    ~SyscallCounter();
+
+    SyscallCounter(const SyscallCounter&) = delete;
+    SyscallCounter& operator=(const SyscallCounter&) = delete;
+
+    bool available() const { return fd_ >= 0; }
+    uint64_t read() const;
+
+private:
+    int fd_ = -1;
+};
+
+/**
+ * Voluntary + involuntary context switches of the process so far
+ */
+uint64_t context_switches();